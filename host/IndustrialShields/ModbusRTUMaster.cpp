@@ -0,0 +1,132 @@
+#include "ModbusRTUMaster.h"
+
+// Compute the Modbus RTU CRC of a frame, sent low byte first
+uint16_t ModbusCRC(const uint8_t *frame, uint16_t length) {
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < length; i++) {
+        crc ^= frame[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            if (crc & 0x0001) crc = (crc >> 1) ^ 0xA001;
+            else crc >>= 1;
+        }
+    }
+    return crc;
+}
+
+bool ModbusRTUMaster::readHoldingRegisters(uint8_t slave, uint16_t address, uint16_t quantity) {
+    uint8_t frame[8] = {slave, 0x03, static_cast<uint8_t>(address >> 8), static_cast<uint8_t>(address),
+                        static_cast<uint8_t>(quantity >> 8), static_cast<uint8_t>(quantity)};
+    return SendRequest(frame, 6);
+}
+
+bool ModbusRTUMaster::readInputRegisters(uint8_t slave, uint16_t address, uint16_t quantity) {
+    uint8_t frame[8] = {slave, 0x04, static_cast<uint8_t>(address >> 8), static_cast<uint8_t>(address),
+                        static_cast<uint8_t>(quantity >> 8), static_cast<uint8_t>(quantity)};
+    return SendRequest(frame, 6);
+}
+
+bool ModbusRTUMaster::writeSingleRegister(uint8_t slave, uint16_t address, uint16_t value) {
+    uint8_t frame[8] = {slave, 0x06, static_cast<uint8_t>(address >> 8), static_cast<uint8_t>(address),
+                        static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value)};
+    return SendRequest(frame, 6);
+}
+
+bool ModbusRTUMaster::writeMultipleRegisters(uint8_t slave, uint16_t address, const uint16_t *values, uint16_t quantity) {
+    uint8_t frame[MODBUS_RTU_MAX_FRAME_SIZE];
+    if (quantity == 0 || 9 + 2 * quantity > MODBUS_RTU_MAX_FRAME_SIZE) return false;
+
+    frame[0] = slave;
+    frame[1] = 0x10;
+    frame[2] = address >> 8;
+    frame[3] = address;
+    frame[4] = quantity >> 8;
+    frame[5] = quantity;
+    frame[6] = 2 * quantity;
+    for (uint16_t i = 0; i < quantity; i++) {
+        frame[7 + 2 * i] = values[i] >> 8;
+        frame[8 + 2 * i] = values[i];
+    }
+    return SendRequest(frame, 7 + 2 * quantity);
+}
+
+thread_local uint16_t ModbusRTUMaster::_refusedRequests = 0;
+
+// Append the CRC and send the frame, frame must have room for the 2 CRC bytes
+bool ModbusRTUMaster::SendRequest(uint8_t *frame, uint16_t length) {
+    if (_waitingResponse) return false;
+    if (_refusedRequests > 0) {
+        _refusedRequests--;
+        return false;
+    }
+
+    uint16_t crc = ModbusCRC(frame, length);
+    frame[length] = crc & 0xFF;
+    frame[length + 1] = crc >> 8;
+
+    // Drop leftovers of previous responses
+    while (_serial.available() > 0) _serial.read();
+
+    _serial.write(frame, length + 2);
+
+    _requestSlave = frame[0];
+    _requestFC = frame[1];
+    _lastActivityMillis = millis();
+    _response._length = 0;
+    // Broadcast requests have no response
+    _waitingResponse = _requestSlave != 0;
+    return true;
+}
+
+// Length of the response in the buffer, known once its header is received, 0 until then
+uint16_t ModbusRTUMaster::ExpectedLength() const {
+    if (_response._length < 2) return 0;
+    // Exception responses: slave, function code | 0x80, exception code, CRC
+    if (_response._frame[1] & 0x80) return 5;
+
+    switch (_response._frame[1]) {
+        case 0x03:
+        case 0x04:
+            // Slave, function code, byte count, data, CRC
+            if (_response._length < 3) return 0;
+            return 5 + _response._frame[2];
+        default:
+            // Write responses echo the address and value or quantity
+            return 8;
+    }
+}
+
+// Read the response of the current request, returns an empty response while it's incomplete
+// Stops waiting when nothing was received for the timeout
+ModbusResponse ModbusRTUMaster::available() {
+    ModbusResponse empty;
+    if (!_waitingResponse) return empty;
+
+    while (_serial.available() > 0) {
+        if (_response._length >= MODBUS_RTU_MAX_FRAME_SIZE) _response._length = 0;
+        _response._frame[_response._length++] = _serial.read();
+        _lastActivityMillis = millis();
+
+        uint16_t expected = ExpectedLength();
+        if (expected == 0 || _response._length < expected) continue;
+
+        // Complete frame, drop it if it's corrupted or isn't the response to the request
+        uint16_t crc = ModbusCRC(_response._frame, expected - 2);
+        bool valid = _response._frame[expected - 2] == (crc & 0xFF) && _response._frame[expected - 1] == (crc >> 8)
+                     && _response.getSlave() == _requestSlave && _response.getFC() == (_requestFC & 0x7F);
+        if (!valid) {
+            _response._length = 0;
+            continue;
+        }
+
+        _waitingResponse = false;
+        ModbusResponse response = _response;
+        _response._length = 0;
+        return response;
+    }
+
+    if (millis() - _lastActivityMillis >= _timeoutMillis) {
+        _waitingResponse = false;
+        _response._length = 0;
+    }
+    return empty;
+}
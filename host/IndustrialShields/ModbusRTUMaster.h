@@ -0,0 +1,80 @@
+#ifndef __HostModbusRTUMaster_H__
+#define __HostModbusRTUMaster_H__
+
+// Host implementation of the Industrial Shields ModbusRTUMaster interface used by the library
+// Frames are sent and received through a Stream, with CRC checking and a response timeout
+
+#include <Arduino.h>
+
+#define MODBUS_RTU_MAX_FRAME_SIZE 256
+// Default time to wait for a response, or for the rest of it, before giving up
+#define MODBUS_RTU_RESPONSE_TIMEOUT_MS 1000
+
+// Compute the Modbus RTU CRC of a frame, sent low byte first
+uint16_t ModbusCRC(const uint8_t *frame, uint16_t length);
+
+class ModbusResponse {
+    public:
+        ModbusResponse() {}
+
+        explicit operator bool() const { return _length > 0; }
+        uint8_t getSlave() const { return _frame[0]; }
+        uint8_t getFC() const { return _frame[1] & 0x7F; }
+        bool isException() const { return (_frame[1] & 0x80) != 0; }
+        bool hasError() const { return isException(); }
+        uint8_t getErrorCode() const { return isException() ? _frame[2] : 0; }
+        // Registers of a Read Holding/Input Registers response
+        uint16_t getRegister(uint16_t index) const {
+            return (static_cast<uint16_t>(_frame[3 + 2 * index]) << 8) | _frame[4 + 2 * index];
+        }
+
+    private:
+        friend class ModbusRTUMaster;
+        uint8_t _frame[MODBUS_RTU_MAX_FRAME_SIZE];
+        uint16_t _length = 0;
+};
+
+class ModbusRTUMaster {
+    public:
+        explicit ModbusRTUMaster(Stream &serial) : _serial(serial) {}
+
+        void begin(unsigned long baudrate) { _baudrate = baudrate; }
+        // Applies from the next request on
+        void setTimeout(uint32_t timeoutMillis) { _timeoutMillis = timeoutMillis; }
+
+        // Send a request, return false if another request is waiting for its response
+        bool readHoldingRegisters(uint8_t slave, uint16_t address, uint16_t quantity);
+        bool readInputRegisters(uint8_t slave, uint16_t address, uint16_t quantity);
+        bool writeSingleRegister(uint8_t slave, uint16_t address, uint16_t value);
+        bool writeMultipleRegisters(uint8_t slave, uint16_t address, const uint16_t *values, uint16_t quantity);
+
+        bool isWaitingResponse() const { return _waitingResponse; }
+
+        // Host only, refuse the next count requests of the calling thread as if the master were busy,
+        // to exercise the busy paths of the library
+        static void RefuseRequests(uint16_t count) { _refusedRequests = count; }
+        // Read the response of the current request, returns an empty response while it's incomplete
+        // Stops waiting when nothing was received for the timeout
+        ModbusResponse available();
+
+    private:
+        Stream &_serial;
+        unsigned long _baudrate = 9600;
+        uint32_t _timeoutMillis = MODBUS_RTU_RESPONSE_TIMEOUT_MS;
+
+        bool _waitingResponse = false;
+        static thread_local uint16_t _refusedRequests;
+        uint8_t _requestSlave = 0;
+        uint8_t _requestFC = 0;
+        // Time of the request or of the last received byte
+        unsigned long _lastActivityMillis = 0;
+
+        // Response being received
+        ModbusResponse _response;
+
+        bool SendRequest(uint8_t *frame, uint16_t length);
+        // Length of the response in the buffer, known once its header is received, 0 until then
+        uint16_t ExpectedLength() const;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include "Arduino.h"
+#include <thread>
+
+/****** Virtual clock ******/
+static thread_local uint64_t nowMicros = 0;
+
+uint64_t HostClock::NowMicros() {
+    return nowMicros;
+}
+
+void HostClock::AdvanceTo(uint64_t micros) {
+    if (micros > nowMicros) nowMicros = micros;
+}
+
+void HostClock::Advance(uint64_t micros) {
+    nowMicros += micros;
+}
+
+void HostClock::Reset() {
+    nowMicros = 0;
+}
+
+unsigned long millis() {
+    return static_cast<unsigned long>(HostClock::NowMicros() / 1000);
+}
+
+unsigned long micros() {
+    return static_cast<unsigned long>(HostClock::NowMicros());
+}
+
+void delay(unsigned long ms) {
+    HostClock::Advance(static_cast<uint64_t>(ms) * 1000);
+    // Let other threads run, as delay() does with the FreeRTOS tasks on the ESP32
+    std::this_thread::yield();
+}
+
+void delayMicroseconds(unsigned int us) {
+    HostClock::Advance(us);
+}
+
+HardwareSerial Serial(0);
@@ -0,0 +1,41 @@
+#ifndef __HostArduino_H__
+#define __HostArduino_H__
+
+// Minimal Arduino core used to build the library on a host (Linux) machine
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <cmath>
+#include <string>
+
+#include "HostClock.h"
+
+#define PROGMEM
+#define F(string) (string)
+
+#define DEC 10
+#define HEX 16
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Arduino String, only what the library and the host programs use
+class String : public std::string {
+    public:
+        String() {}
+        String(const char *value) : std::string(value) {}
+        String(const std::string &value) : std::string(value) {}
+};
+
+#include "HardwareSerial.h"
+
+// Console port, prints to stdout
+extern HardwareSerial Serial;
+
+#endif
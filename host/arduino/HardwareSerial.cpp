@@ -0,0 +1,125 @@
+#include "Arduino.h"
+
+// Time the virtual clock moves forward when a port with nothing to read is polled
+#define IDLE_POLL_MICROS 100
+
+/****** Print ******/
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while (size--) written += write(*buffer++);
+    return written;
+}
+
+size_t Print::write(const char *str) {
+    return write(reinterpret_cast<const uint8_t *>(str), strlen(str));
+}
+
+size_t Print::print(const char *value) { return write(value); }
+size_t Print::print(const std::string &value) { return write(value.c_str()); }
+size_t Print::print(char value) { return write(static_cast<uint8_t>(value)); }
+size_t Print::print(unsigned char value, int base) { return print(static_cast<unsigned long long>(value), base); }
+size_t Print::print(int value, int base) { return print(static_cast<long long>(value), base); }
+size_t Print::print(unsigned int value, int base) { return print(static_cast<unsigned long long>(value), base); }
+size_t Print::print(long value, int base) { return print(static_cast<long long>(value), base); }
+size_t Print::print(unsigned long value, int base) { return print(static_cast<unsigned long long>(value), base); }
+
+size_t Print::print(long long value, int base) {
+    // Only decimal numbers are signed, like in the Arduino core
+    if (value < 0 && base == 10) return write('-') + print(0ULL - static_cast<unsigned long long>(value), base);
+    return print(static_cast<unsigned long long>(value), base);
+}
+
+size_t Print::print(unsigned long long value, int base) {
+    char buffer[65];
+    char *digit = &buffer[sizeof(buffer) - 1];
+    *digit = '\0';
+    if (base < 2) base = 10;
+    do {
+        uint8_t remainder = value % base;
+        *--digit = remainder < 10 ? '0' + remainder : 'A' + remainder - 10;
+        value /= base;
+    } while (value != 0);
+    return write(digit);
+}
+
+size_t Print::print(double value, int digits) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+    return write(buffer);
+}
+
+size_t Print::println() {
+    return write("\r\n");
+}
+
+
+/****** HardwareSerial ******/
+HardwareSerial::HardwareSerial(int uartNumber) : _uartNumber(uartNumber) {}
+
+void HardwareSerial::begin(unsigned long baudrate, uint32_t config) {
+    _baudrate = baudrate;
+    _config = config;
+    _rxQueue.clear();
+}
+
+// Line time of one character, including start, parity and stop bits
+uint32_t HardwareSerial::CharMicros() const {
+    uint32_t bitsPerChar = _config == SERIAL_8N1 ? 10 : 11;
+    return (bitsPerChar * 1000000UL + _baudrate - 1) / _baudrate;
+}
+
+int HardwareSerial::available() {
+    // A console never receives anything
+    if (_device == nullptr) return 0;
+
+    // If the next byte is still on the line, wait for it, otherwise let time pass while idle
+    if (_rxQueue.empty()) HostClock::Advance(IDLE_POLL_MICROS);
+    else HostClock::AdvanceTo(_rxQueue.front().readyMicros);
+
+    uint64_t now = HostClock::NowMicros();
+    int count = 0;
+    for (const TimedByte &entry : _rxQueue) {
+        if (entry.readyMicros > now) break;
+        count++;
+    }
+    return count;
+}
+
+int HardwareSerial::read() {
+    if (_rxQueue.empty() || _rxQueue.front().readyMicros > HostClock::NowMicros()) return -1;
+    uint8_t value = _rxQueue.front().value;
+    _rxQueue.pop_front();
+    _bytesRead++;
+    return value;
+}
+
+int HardwareSerial::peek() {
+    if (_rxQueue.empty() || _rxQueue.front().readyMicros > HostClock::NowMicros()) return -1;
+    return _rxQueue.front().value;
+}
+
+size_t HardwareSerial::write(uint8_t byte) {
+    // Consoles print to stdout
+    if (_device == nullptr) {
+        fputc(byte, stdout);
+        return 1;
+    }
+
+    // Bytes are sent back to back, after the previous one leaves the line
+    uint64_t now = HostClock::NowMicros();
+    if (_txFreeMicros < now) _txFreeMicros = now;
+    _txFreeMicros += CharMicros();
+    _bytesWritten++;
+
+    _device->OnByteReceived(*this, byte, _txFreeMicros);
+    return 1;
+}
+
+// Queue bytes sent by the device, the i-th byte becomes readable at startMicros + (i + 1) character times
+void HardwareSerial::Deliver(const uint8_t *bytes, size_t size, uint64_t startMicros) {
+    uint32_t charMicros = CharMicros();
+    for (size_t i = 0; i < size; i++) {
+        TimedByte entry = {startMicros + (i + 1) * charMicros, bytes[i]};
+        _rxQueue.push_back(entry);
+    }
+}
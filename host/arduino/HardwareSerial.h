@@ -0,0 +1,108 @@
+#ifndef __HostHardwareSerial_H__
+#define __HostHardwareSerial_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <string>
+
+// Line settings, the values only need to be distinct on the host
+#define SERIAL_8N1 0x01
+#define SERIAL_8N2 0x02
+#define SERIAL_8E1 0x03
+#define SERIAL_8O1 0x04
+
+// Arduino Print, formats numbers and strings into write() calls
+class Print {
+    public:
+        virtual ~Print() {}
+        virtual size_t write(uint8_t byte) = 0;
+        size_t write(const uint8_t *buffer, size_t size);
+        size_t write(const char *str);
+
+        size_t print(const char *value);
+        size_t print(const std::string &value);
+        size_t print(char value);
+        size_t print(unsigned char value, int base = 10);
+        size_t print(int value, int base = 10);
+        size_t print(unsigned int value, int base = 10);
+        size_t print(long value, int base = 10);
+        size_t print(unsigned long value, int base = 10);
+        size_t print(long long value, int base = 10);
+        size_t print(unsigned long long value, int base = 10);
+        size_t print(double value, int digits = 2);
+
+        template <typename T>
+        size_t println(const T &value) { return print(value) + println(); }
+        template <typename T>
+        size_t println(const T &value, int format) { return print(value, format) + println(); }
+        size_t println();
+};
+
+// Arduino Stream, a Print that can also be read
+class Stream : public Print {
+    public:
+        virtual int available() = 0;
+        virtual int read() = 0;
+        virtual int peek() = 0;
+        virtual void flush() {}
+};
+
+class HardwareSerial;
+
+// Other end of a host serial line, i.e. a simulated Modbus slave
+class SerialDevice {
+    public:
+        virtual ~SerialDevice() {}
+        // Called for every byte written to the port, endMicros is when its last bit leaves the line
+        virtual void OnByteReceived(HardwareSerial &port, uint8_t byte, uint64_t endMicros) = 0;
+};
+
+// Host UART, either a console printing to stdout or a line attached to a SerialDevice
+// Both directions are timed with the configured baud rate using the HostClock
+class HardwareSerial : public Stream {
+    public:
+        explicit HardwareSerial(int uartNumber);
+
+        void begin(unsigned long baudrate, uint32_t config = SERIAL_8N1);
+        void end() {}
+        void updateBaudRate(unsigned long baudrate) { _baudrate = baudrate; }
+        unsigned long baudRate() const { return _baudrate; }
+        uint32_t config() const { return _config; }
+
+        int available() override;
+        int read() override;
+        int peek() override;
+        size_t write(uint8_t byte) override;
+        using Print::write;
+        operator bool() const { return true; }
+
+        /****** Host only ******/
+        // Connect the other end of the line
+        void Attach(SerialDevice *device) { _device = device; }
+        // Queue bytes sent by the device, the i-th byte becomes readable at startMicros + (i + 1) character times
+        void Deliver(const uint8_t *bytes, size_t size, uint64_t startMicros);
+        // Line time of one character, including start, parity and stop bits
+        uint32_t CharMicros() const;
+        // Total bytes sent and received on the line
+        uint64_t BytesWritten() const { return _bytesWritten; }
+        uint64_t BytesRead() const { return _bytesRead; }
+
+    private:
+        int _uartNumber;
+        unsigned long _baudrate = 9600;
+        uint32_t _config = SERIAL_8N1;
+        SerialDevice *_device = nullptr;
+
+        struct TimedByte {
+            uint64_t readyMicros;
+            uint8_t value;
+        };
+        std::deque<TimedByte> _rxQueue;
+        // Time when the transmitter finishes the last written byte
+        uint64_t _txFreeMicros = 0;
+        uint64_t _bytesWritten = 0;
+        uint64_t _bytesRead = 0;
+};
+
+#endif
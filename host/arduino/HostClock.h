@@ -0,0 +1,18 @@
+#ifndef __HostClock_H__
+#define __HostClock_H__
+
+#include <stdint.h>
+
+// Virtual clock behind millis() and micros() in the host build
+// Time only moves forward when the code waits, i.e. in delay() or while polling a serial port
+// with nothing to read, so simulated bus time is independent of the host's speed
+// Each thread has its own clock, so independent buses can run in parallel
+namespace HostClock {
+    uint64_t NowMicros();
+    // Move the clock forward, never backwards
+    void AdvanceTo(uint64_t micros);
+    void Advance(uint64_t micros);
+    void Reset();
+}
+
+#endif
@@ -0,0 +1,141 @@
+#include "WiFi.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static void SetNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    // Modbus frames are small, send them right away like the ESP32's lwIP does
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+/****** WiFiClient ******/
+WiFiClient::Socket::~Socket() {
+    close(fd);
+}
+
+WiFiClient::WiFiClient(int fd) : _socket(new Socket(fd)) {
+    SetNonBlocking(fd);
+}
+
+int WiFiClient::connect(const char *host, uint16_t port) {
+    stop();
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses;
+    if (getaddrinfo(host, nullptr, &hints, &addresses) != 0) return 0;
+
+    sockaddr_in address = *reinterpret_cast<sockaddr_in *>(addresses->ai_addr);
+    freeaddrinfo(addresses);
+    address.sin_port = htons(port);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return 0;
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return 0;
+    }
+    _socket.reset(new Socket(fd));
+    SetNonBlocking(fd);
+    _peerClosed = false;
+    return 1;
+}
+
+uint8_t WiFiClient::connected() {
+    if (!_socket) return 0;
+    // Connected while the peer is open or unread bytes are left
+    if (!_peerClosed) {
+        uint8_t byte;
+        ssize_t result = recv(_socket->fd, &byte, 1, MSG_PEEK);
+        if (result == 0 || (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) _peerClosed = true;
+    }
+    return !_peerClosed || available() > 0;
+}
+
+void WiFiClient::stop() {
+    _socket.reset();
+    _peerClosed = false;
+}
+
+int WiFiClient::available() {
+    if (!_socket) return 0;
+    int bytes = 0;
+    if (ioctl(_socket->fd, FIONREAD, &bytes) != 0) return 0;
+    return bytes;
+}
+
+int WiFiClient::read() {
+    uint8_t byte;
+    return read(&byte, 1) == 1 ? byte : -1;
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size) {
+    if (!_socket) return -1;
+    ssize_t result = recv(_socket->fd, buffer, size, 0);
+    if (result == 0) _peerClosed = true;
+    return result > 0 ? static_cast<int>(result) : -1;
+}
+
+int WiFiClient::peek() {
+    if (!_socket) return -1;
+    uint8_t byte;
+    return recv(_socket->fd, &byte, 1, MSG_PEEK) == 1 ? byte : -1;
+}
+
+size_t WiFiClient::write(uint8_t byte) {
+    return write(&byte, 1);
+}
+
+// Blocks until every byte is sent or the connection fails, like the ESP32's write()
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+    if (!_socket) return 0;
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result = send(_socket->fd, buffer + written, size - written, MSG_NOSIGNAL);
+        if (result > 0) written += result;
+        else if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK) break;
+    }
+    return written;
+}
+
+/****** WiFiServer ******/
+void WiFiServer::begin(uint16_t port) {
+    end();
+    if (port != 0) _port = port;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(_port);
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(fd, _maxClients) != 0) {
+        close(fd);
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    _fd = fd;
+}
+
+void WiFiServer::end() {
+    if (_fd >= 0) close(_fd);
+    _fd = -1;
+}
+
+WiFiClient WiFiServer::available() {
+    if (_fd < 0) return WiFiClient();
+    int fd = ::accept(_fd, nullptr, nullptr);
+    if (fd < 0) return WiFiClient();
+    return WiFiClient(fd);
+}
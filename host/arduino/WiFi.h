@@ -0,0 +1,62 @@
+#ifndef __HostWiFi_H__
+#define __HostWiFi_H__
+
+// TCP client and server of the ESP32 WiFi library, over host sockets, so servers can be tested on loopback
+// Sockets are non-blocking, like the ESP32's. The network is never brought up, the host's interfaces are used
+
+#include <memory>
+#include "HardwareSerial.h"
+
+// Connection with a TCP peer, copies share the socket, which is closed by stop() or with the last copy
+class WiFiClient : public Stream {
+    public:
+        WiFiClient() {}
+        explicit WiFiClient(int fd);
+
+        // Connect to a host name or address, blocking, returns 1 on success
+        int connect(const char *host, uint16_t port);
+        uint8_t connected();
+        void stop();
+        explicit operator bool() { return connected(); }
+
+        int available() override;
+        int read() override;
+        int read(uint8_t *buffer, size_t size);
+        int peek() override;
+        size_t write(uint8_t byte) override;
+        size_t write(const uint8_t *buffer, size_t size);
+
+    private:
+        // Closes the socket with the last copy
+        struct Socket {
+            int fd;
+            explicit Socket(int fd) : fd(fd) {}
+            ~Socket();
+        };
+        std::shared_ptr<Socket> _socket;
+        // Set once the peer closed the connection, the bytes already received can still be read
+        bool _peerClosed = false;
+};
+
+// Listening TCP socket, accepts the connections of any local address
+class WiFiServer {
+    public:
+        explicit WiFiServer(uint16_t port = 80, uint8_t maxClients = 4) : _port(port), _maxClients(maxClients) {}
+        ~WiFiServer() { end(); }
+
+        // Listen on port, or on the port given to the constructor if it is 0
+        void begin(uint16_t port = 0);
+        void end();
+        explicit operator bool() const { return _fd >= 0; }
+
+        // Next pending connection, or a client that isn't connected
+        WiFiClient available();
+        WiFiClient accept() { return available(); }
+
+    private:
+        uint16_t _port;
+        uint8_t _maxClients;
+        int _fd = -1;
+};
+
+#endif
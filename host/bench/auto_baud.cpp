@@ -0,0 +1,90 @@
+// AutoBaud() against meters configured with each probed rate and parity, with the wrapper started at 2400 baud:
+// probes sent and time to find the settings, in simulated bus time, and the migration report for 115200 baud
+// Then the snapshot throughput of a meter before and after it is moved from 2400 to 115200 baud
+
+#include <Arduino.h>
+#include "OctaveModbusWrapper.h"
+#include "../sim/OctaveSlaveSimulator.h"
+
+#define TARGET_BAUDRATE 115200
+#define MEASURE_MILLIS 60000UL
+
+static const unsigned long meterBaudrates[] = {2400, 9600, 19200, 115200};
+static const uint32_t meterConfigs[] = {SERIAL_8N1, SERIAL_8E1, SERIAL_8N2};
+
+static const char *ConfigName(uint32_t config) {
+    switch (config) {
+        case SERIAL_8N1: return "8N1";
+        case SERIAL_8N2: return "8N2";
+        case SERIAL_8E1: return "8E1";
+        case SERIAL_8O1: return "8O1";
+        default: return "?";
+    }
+}
+
+static float SnapshotsPerSecond(OctaveModbusWrapper &octave) {
+    OctaveSnapshot snapshot;
+    uint32_t snapshots = 0;
+    unsigned long start = millis();
+    while (millis() - start < MEASURE_MILLIS) {
+        if (octave.ReadSnapshot(&snapshot) == 0) snapshots++;
+    }
+    return snapshots * 1000.0 / (millis() - start);
+}
+
+int main() {
+    bool ok = true;
+    printf("%-8s %6s %8s %8s %10s %8s %14s %14s\n", "meter", "line", "found", "probes", "ms", "migrate",
+           "snapshot ms", "at target ms");
+    for (unsigned long baudrate : meterBaudrates) {
+        for (uint32_t config : meterConfigs) {
+            HostClock::Reset();
+            HardwareSerial port(1);
+            port.begin(2400);
+            OctaveSlaveSimulator simulator(port);
+            simulator.SetLineSettings(baudrate, config);
+            simulator.AddMeter(MODBUS_SLAVE_ADDRESS);
+
+            OctaveModbusWrapper octave(port);
+            octave.begin(2400);
+            OctaveAutoBaudResult result;
+            unsigned long start = millis();
+            uint8_t errorCode = octave.AutoBaud(&result, TARGET_BAUDRATE);
+            unsigned long elapsedMillis = millis() - start;
+
+            bool found = errorCode == 0 && result.baudrate == baudrate && result.config == config;
+            ok = ok && found;
+            printf("%-8lu %6s %8s %8u %10lu %8s %14.1f %14.1f\n", baudrate, ConfigName(config), found ? "yes" : "NO",
+                   result.probes, elapsedMillis, result.canMigrate ? "yes" : "no", result.snapshotLineMicros / 1000.0,
+                   result.targetSnapshotLineMicros / 1000.0);
+        }
+    }
+
+    // No meter on the bus: every setting is probed, then the port goes back to its settings
+    HostClock::Reset();
+    HardwareSerial port(1);
+    port.begin(2400);
+    OctaveSlaveSimulator simulator(port);
+    OctaveModbusWrapper octave(port);
+    octave.begin(2400);
+    OctaveAutoBaudResult result;
+    unsigned long start = millis();
+    uint8_t errorCode = octave.AutoBaud(&result);
+    printf("\nNo meter: error %u after %u probes and %lu ms, port back at %lu %s\n", errorCode, result.probes,
+           millis() - start, port.baudRate(), ConfigName(port.config()));
+    ok = ok && errorCode == 5 && port.baudRate() == 2400;
+
+    // Migration, the meter is moved to the target rate with the NFC reader
+    simulator.AddMeter(MODBUS_SLAVE_ADDRESS);
+    simulator.SetLineSettings(2400);
+    octave.AutoBaud(&result, TARGET_BAUDRATE);
+    float before = SnapshotsPerSecond(octave);
+    simulator.SetLineSettings(TARGET_BAUDRATE);
+    octave.AutoBaud(&result);
+    float after = SnapshotsPerSecond(octave);
+    printf("Snapshots/s at 2400 baud: %.2f, at %u baud: %.2f, %.1fx\n", before, TARGET_BAUDRATE, after, after / before);
+    ok = ok && result.baudrate == TARGET_BAUDRATE;
+
+    printf("%s\n", ok ? "OK" : "ERROR");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+// Time from a cold start to the first reading, as a gateway that wakes, reads and sleeps goes through on every wake
+// Compares the wall-clock cost of constructing the wrapper and calling begin() with the name-to-code maps
+// begin() used to build, then measures the simulated time from begin() to the first decoded reading
+
+#include <Arduino.h>
+#include <chrono>
+#include <map>
+#include <new>
+#include "OctaveModbusWrapper.h"
+#include "../sim/OctaveSlaveSimulator.h"
+
+#define REPETITIONS 20000
+
+static const unsigned long baudrates[] = {2400, 9600, 115200};
+
+// Maps as InitMaps() built them in begin() before the names moved to constant tables, kept here as the baseline
+struct LegacyMaps {
+    std::map<String, uint8_t> flowUnitNameToCode;
+    std::map<String, uint8_t> volumeUnitNameToCode;
+    std::map<String, uint8_t> temperatureUnitNameToCode;
+    std::map<String, uint8_t> flowDirectionNameToCode;
+    std::map<String, uint8_t> resolutiontNameToCode;
+
+    void InitMaps() {
+        flowUnitNameToCode["Cubic Meters/Hour"] = 0;
+        flowUnitNameToCode["Gallons/Minute"] = 1;
+        flowUnitNameToCode["Litres/Second"] = 2;
+        flowUnitNameToCode["Imperial Gallons/ Minute"] = 3;
+        flowUnitNameToCode["Litres/Minute"] = 4;
+        flowUnitNameToCode["Barrel/Minute"] = 5;
+
+        resolutiontNameToCode["0.001x"] = 1;
+        resolutiontNameToCode["0.01x"] = 2;
+        resolutiontNameToCode["0.1x"] = 3;
+        resolutiontNameToCode["1x"] = 4;
+        resolutiontNameToCode["10x"] = 5;
+        resolutiontNameToCode["100x"] = 6;
+        resolutiontNameToCode["1000x"] = 7;
+        resolutiontNameToCode["10000x"] = 8;
+
+        volumeUnitNameToCode["Cubic Meters"] = 0;
+        volumeUnitNameToCode["Cubic Feet"] = 1;
+        volumeUnitNameToCode["Cubic Inch"] = 2;
+        volumeUnitNameToCode["Cubic Yards"] = 3;
+        volumeUnitNameToCode["US Gallons"] = 4;
+        volumeUnitNameToCode["Imperial Gallons"] = 5;
+        volumeUnitNameToCode["Acre Feet"] = 6;
+        volumeUnitNameToCode["Kiloliters"] = 7;
+        volumeUnitNameToCode["Liters"] = 8;
+        volumeUnitNameToCode["Acre-inch"] = 9;
+        volumeUnitNameToCode["Barrel"] = 10;
+
+        temperatureUnitNameToCode["Not Active"] = 0;
+        temperatureUnitNameToCode["Celsius"] = 1;
+        temperatureUnitNameToCode["Fahrenheit"] = 2;
+
+        flowDirectionNameToCode["No flow"] = 0;
+        flowDirectionNameToCode["Forward flow"] = 1;
+        flowDirectionNameToCode["Backward flow"] = 2;
+    }
+};
+
+// Storage of the wrapper, constructed again on every repetition as after a wake from deep sleep
+alignas(OctaveModbusWrapper) static uint8_t storage[sizeof(OctaveModbusWrapper)];
+
+// Keeps the results alive, so the loops aren't optimized away
+static volatile int16_t sink;
+
+// Construct the wrapper and call begin() REPETITIONS times, returns ns per start
+template <typename Start>
+static double NanosPerStart(Start start) {
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < REPETITIONS; i++) start();
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / REPETITIONS;
+}
+
+int main() {
+    HardwareSerial port(1);
+
+    double constantTables = NanosPerStart([&port]() {
+        OctaveModbusWrapper *octave = new (storage) OctaveModbusWrapper(port);
+        octave->begin(9600);
+        octave->~OctaveModbusWrapper();
+    });
+    double legacyMaps = NanosPerStart([&port]() {
+        OctaveModbusWrapper *octave = new (storage) OctaveModbusWrapper(port);
+        LegacyMaps maps;
+        maps.InitMaps();
+        octave->begin(9600);
+        sink = maps.volumeUnitNameToCode["Liters"];
+        octave->~OctaveModbusWrapper();
+    });
+    // The tables are only read when a name is needed, e.g. to print a reading
+    double firstLookup = NanosPerStart([]() {
+        sink = OctaveModbusWrapper::NameToCode(OctaveDecodeKind::VolumeUnit, "Liters");
+    });
+
+    printf("Constructor and begin(), wall-clock time\n");
+    printf("%-40s %10.0f ns\n", "Name-to-code maps built by begin()", legacyMaps);
+    printf("%-40s %10.0f ns %7.1fx\n", "Constant tables", constantTables, legacyMaps / constantTables);
+    printf("%-40s %10.0f ns\n", "First name lookup, when it is needed", firstLookup);
+
+    printf("\nSimulated time from begin() to the first reading of ForwardVolume_double\n");
+    printf("%-8s %14s\n", "baud", "first reading");
+    bool ok = true;
+    for (unsigned long baudrate : baudrates) {
+        HostClock::Reset();
+        HardwareSerial bus(1);
+        bus.begin(baudrate);
+        OctaveSlaveSimulator simulator(bus);
+        simulator.SetLineSettings(baudrate);
+        simulator.AddMeter(MODBUS_SLAVE_ADDRESS).SetVolumes(1234.5, 0.0);
+
+        unsigned long start = micros();
+        OctaveModbusWrapper octave(bus);
+        octave.begin(baudrate);
+        double volume = 0.0;
+        uint8_t errorCode = octave.Read<OctaveField::ForwardVolume_double>(&volume);
+        unsigned long elapsed = micros() - start;
+
+        ok = ok && errorCode == 0 && volume == 1234.5;
+        printf("%-8lu %11.2f ms\n", baudrate, elapsed / 1000.0);
+    }
+
+    if (!ok) printf("First reading failed\n");
+    return ok ? 0 : 1;
+}
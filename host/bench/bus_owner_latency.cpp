@@ -0,0 +1,160 @@
+// Latency of high priority requests through a BusOwner under heavy background polling
+// Snapshots of 10 meters are requested back to back at normal priority, while the alarms of one meter
+// are requested every 500 ms, at high priority and then at normal priority, i.e. first-come first-served.
+// Latency is from Submit() to completion, in simulated bus time, with the owner polled from the main thread
+// Then several producer threads submit reads to an owner running on its own thread and check every result
+
+#include <Arduino.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "BusOwner.h"
+#include "../sim/OctaveSlaveSimulator.h"
+
+#define NUM_METERS 10
+#define MEASURE_MILLIS 60000UL
+#define ALARMS_PERIOD_MILLIS 500
+// Time spent in the rest of loop() between two calls to Poll()
+#define LOOP_MICROS 200
+
+#define NUM_PRODUCERS 4
+#define REQUESTS_PER_PRODUCER 500
+
+static const unsigned long baudrates[] = {2400, 9600, 115200};
+
+// Background snapshot of one meter, submitted again as soon as it finishes
+struct SnapshotJob {
+    BusOwner *owner;
+    OctaveRequest request;
+    uint16_t registers[SNAPSHOT_NUM_REGISTERS];
+};
+
+static void ResubmitSnapshot(OctaveRequest &, void *context) {
+    // Submitted again from the owner's own callback, once the request is handed back
+    static_cast<SnapshotJob*>(context)->owner->Submit(static_cast<SnapshotJob*>(context)->request);
+}
+
+struct LatencyStats {
+    uint32_t count = 0;
+    double totalMillis = 0.0;
+    double maxMillis = 0.0;
+
+    void Add(double millis) {
+        count++;
+        totalMillis += millis;
+        if (millis > maxMillis) maxMillis = millis;
+    }
+};
+
+static LatencyStats MeasureAlarms(unsigned long baudrate, OctaveRequestPriority alarmsPriority) {
+    HostClock::Reset();
+    HardwareSerial port(1);
+    port.begin(baudrate);
+    OctaveSlaveSimulator simulator(port);
+    simulator.SetLineSettings(baudrate);
+    for (uint8_t address = 1; address <= NUM_METERS; address++) simulator.AddMeter(address);
+
+    OctaveModbusWrapper octave(port);
+    octave.begin(baudrate);
+    BusOwner owner(octave);
+
+    static SnapshotJob jobs[NUM_METERS];
+    for (uint8_t i = 0; i < NUM_METERS; i++) {
+        jobs[i].owner = &owner;
+        jobs[i].request.ReadRawRegisters(SNAPSHOT_START_ADDRESS, SNAPSHOT_NUM_REGISTERS, jobs[i].registers, i + 1);
+        jobs[i].request.SetCallback(ResubmitSnapshot, &jobs[i]);
+        owner.Submit(jobs[i].request);
+    }
+
+    OctaveRequest alarms;
+    int16_t alarmsValue;
+    alarms.Read(OctaveField::ReadAlarms, &alarmsValue, 1);
+    alarms.SetPriority(alarmsPriority);
+
+    LatencyStats stats;
+    unsigned long submitMicros = 0;
+    bool submitted = false;
+    unsigned long nextAlarmsMillis = ALARMS_PERIOD_MILLIS;
+    while (millis() < MEASURE_MILLIS) {
+        if (!submitted && millis() >= nextAlarmsMillis) {
+            submitMicros = micros();
+            owner.Submit(alarms);
+            submitted = true;
+            nextAlarmsMillis += ALARMS_PERIOD_MILLIS;
+        }
+        owner.Poll();
+        if (submitted && alarms.Done()) {
+            if (alarms.ErrorCode() == 0) stats.Add((micros() - submitMicros) / 1000.0);
+            submitted = false;
+        }
+        delayMicroseconds(LOOP_MICROS);
+    }
+
+    // Let the background requests finish before the owner goes out of scope
+    for (uint8_t i = 0; i < NUM_METERS; i++) jobs[i].request.SetCallback(nullptr);
+    bool done = false;
+    while (!done) {
+        owner.Poll();
+        delayMicroseconds(LOOP_MICROS);
+        done = true;
+        for (uint8_t i = 0; i < NUM_METERS; i++) done = done && jobs[i].request.Done();
+    }
+    return stats;
+}
+
+// Producer threads submitting reads to an owner thread, every value must match the simulator's
+static bool MeasureProducers(uint32_t *completed, double *seconds) {
+    HardwareSerial port(1);
+    port.begin(115200);
+    OctaveSlaveSimulator simulator(port);
+    simulator.SetLineSettings(115200);
+    for (uint8_t address = 1; address <= NUM_PRODUCERS; address++) simulator.AddMeter(address).SetVolumes(100.0 * address, 0.0);
+
+    OctaveModbusWrapper octave(port);
+    octave.begin(115200);
+    BusOwner owner(octave);
+    owner.Start();
+
+    std::atomic<uint32_t> errors(0);
+    std::vector<std::thread> producers;
+    auto start = std::chrono::steady_clock::now();
+    for (uint8_t i = 0; i < NUM_PRODUCERS; i++) {
+        producers.emplace_back([&owner, &errors, i]() {
+            OctaveRequest request;
+            double volume;
+            uint8_t slaveAddress = i + 1;
+            for (uint32_t j = 0; j < REQUESTS_PER_PRODUCER; j++) {
+                // Every other producer's requests are high priority
+                request.SetPriority(i % 2 == 0 ? OctaveRequestPriority::High : OctaveRequestPriority::Normal);
+                request.Read(OctaveField::ForwardVolume_double, &volume, slaveAddress);
+                owner.Submit(request);
+                if (request.Wait() != 0 || volume != 100.0 * slaveAddress) errors++;
+            }
+        });
+    }
+    for (std::thread &producer : producers) producer.join();
+    *seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    owner.Stop();
+
+    *completed = owner.Completed(OctaveRequestPriority::High) + owner.Completed(OctaveRequestPriority::Normal);
+    return errors == 0 && *completed == NUM_PRODUCERS * REQUESTS_PER_PRODUCER;
+}
+
+int main() {
+    printf("Alarms latency under background snapshot polling of %u meters\n", NUM_METERS);
+    printf("%-8s %16s %16s %16s %16s\n", "baud", "high mean ms", "high max ms", "fifo mean ms", "fifo max ms");
+    for (unsigned long baudrate : baudrates) {
+        LatencyStats high = MeasureAlarms(baudrate, OctaveRequestPriority::High);
+        LatencyStats fifo = MeasureAlarms(baudrate, OctaveRequestPriority::Normal);
+        printf("%-8lu %16.1f %16.1f %16.1f %16.1f\n", baudrate, high.totalMillis / high.count, high.maxMillis,
+               fifo.totalMillis / fifo.count, fifo.maxMillis);
+    }
+
+    uint32_t completed;
+    double seconds;
+    bool ok = MeasureProducers(&completed, &seconds);
+    printf("\n%u producer threads: %u requests completed in %.2f s of wall-clock time, %s\n", NUM_PRODUCERS, completed,
+           seconds, ok ? "all values correct" : "ERRORS");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+// Bus statistics of a MeterBus polling snapshots, on a clean bus and on a noisy one
+// with dropped and corrupted responses and exceptions, as read with BusStats()
+// All times are simulated bus time. The counters must agree with the simulator's, and the clean bus must have no errors
+
+#include <Arduino.h>
+#include "OctaveModbusWrapper.h"
+#include "MeterBus.h"
+#include "../sim/OctaveSlaveSimulator.h"
+
+#define NUM_METERS 5
+#define BAUDRATE 9600
+#define MEASURE_MILLIS 600000UL
+
+// Returns false when the counters don't agree with the simulated slaves
+static bool Measure(const char *name, double dropRate, double corruptRate, double exceptionRate) {
+    HostClock::Reset();
+    HardwareSerial port(1);
+    port.begin(BAUDRATE);
+    OctaveSlaveSimulator simulator(port);
+    simulator.SetLineSettings(BAUDRATE);
+    simulator.SetLatency(5000, 20000);
+    simulator.SetErrorRates(dropRate, corruptRate, exceptionRate);
+    for (uint8_t address = 1; address <= NUM_METERS; address++) simulator.AddMeter(address);
+
+    OctaveModbusWrapper octave(port);
+    octave.begin(BAUDRATE);
+
+    uint8_t slaveAddresses[NUM_METERS];
+    OctaveSnapshot snapshots[NUM_METERS];
+    uint8_t errorCodes[NUM_METERS];
+    for (uint8_t i = 0; i < NUM_METERS; i++) slaveAddresses[i] = i + 1;
+    MeterBus bus(octave, slaveAddresses, NUM_METERS, snapshots, errorCodes);
+
+    unsigned long start = millis();
+    unsigned long nextAlarmsMillis = start;
+    while (millis() - start < MEASURE_MILLIS) {
+        bus.Poll();
+        // A read started every second while the bus is busy is refused
+        int16_t alarms;
+        if (millis() >= nextAlarmsMillis) {
+            octave.StartReadInto(OctaveField::ReadAlarms, &alarms);
+            nextAlarmsMillis += 1000;
+        }
+    }
+
+    OctaveBusStats stats;
+    octave.BusStats(&stats);
+    const OctaveLatencyStats &reads = stats.latency[0];
+    printf("\n%s: %u requests, %u timeouts, exceptions 1-4: %u %u %u %u, %u busy, %u bytes sent, %u received\n", name,
+           stats.requests, stats.timeouts, stats.exceptions[0], stats.exceptions[1], stats.exceptions[2],
+           stats.exceptions[3], stats.busyRejections, stats.bytesSent, stats.bytesReceived);
+    printf("Function code %02X round trip: min %.1f ms, mean %.1f ms, max %.1f ms\n", reads.functionCode,
+           reads.minMicros / 1000.0, reads.totalMicros / 1000.0 / reads.responses, reads.maxMicros / 1000.0);
+    for (uint8_t i = 0; i < OCTAVE_LATENCY_BUCKETS; i++) {
+        if (reads.histogram[i] == 0) continue;
+        uint32_t bound = OctaveModbusWrapper::LatencyBucketMicros(i);
+        if (bound == UINT32_MAX) printf("  %10s %8u\n", "over", reads.histogram[i]);
+        else printf("  < %5.0f ms %8u\n", bound / 1000.0, reads.histogram[i]);
+    }
+    // Simulator's own count, for comparison
+    printf("Simulator: %u requests received, %u errors injected\n", simulator.RequestsReceived(), simulator.ErrorsInjected());
+
+    uint32_t failures = stats.timeouts;
+    for (uint8_t i = 0; i < 4; i++) failures += stats.exceptions[i];
+    bool ok = stats.requests == simulator.RequestsReceived() && reads.responses > 0 && stats.busyRejections > 0;
+    // A clean bus has no failures, a noisy one has at least one per injected error that reached the master
+    if (simulator.ErrorsInjected() == 0) ok = ok && failures == 0;
+    else ok = ok && failures > 0;
+    if (!ok) printf("Counters don't agree with the simulator\n");
+    return ok;
+}
+
+int main() {
+    bool ok = Measure("Clean bus", 0.0, 0.0, 0.0);
+    ok = Measure("Noisy bus", 0.02, 0.02, 0.01) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+// Readings sent upstream over a quiet night, with and without a ChangeFilter
+// A meter is polled with a PollScheduler from midnight to 6 am, with a small noise on the flow and a few
+// short water uses, and every reading goes through a ChangeFilter with a deadband and a 15 minute heartbeat
+// Each reading is checked against the last reported one: a field must never be further from its reported
+// value than its deadband, nor be silent for longer than its heartbeat, once the next read is in
+// Then two meters are read through the wrapper's read callback, with a ChangeFilter per meter, which must
+// only report the readings of its own meter
+
+#include <Arduino.h>
+#include <random>
+#include "ChangeFilter.h"
+#include "PollScheduler.h"
+#include "../sim/OctaveSlaveSimulator.h"
+
+#define NIGHT_MILLIS (6 * 3600000UL)
+#define POLL_PERIOD_MILLIS 5000
+#define HEARTBEAT_MILLIS (15 * 60000UL)
+// Time spent in the rest of loop() between two calls to Poll()
+#define LOOP_MICROS 200
+// Meter model: flow noise in m3/h, and water uses of USE_MILLIS at USE_FLOW m3/h
+#define FLOW_NOISE 0.002
+#define USES_PER_NIGHT 6
+#define USE_FLOW 0.6
+#define USE_MILLIS 90000UL
+
+struct Deadband {
+    OctaveField field;
+    double absolute;
+    double relative;
+};
+
+// Flow within 10 l/h or 5 %, volumes within a litre, any change of the others
+static const Deadband deadbands[] = {
+    {OctaveField::SignedCurrentFlow_double, 0.01, 0.05},
+    {OctaveField::ForwardVolume_double, 0.001, 0.0},
+    {OctaveField::NetSignedVolume_double, 0.001, 0.0},
+    {OctaveField::TemperatureValue, 0.0, 0.0},
+    {OctaveField::ReadAlarms, 0.0, 0.0},
+    {OctaveField::FlowDirection, 0.0, 0.0},
+};
+#define NUM_FIELDS (sizeof(deadbands) / sizeof(deadbands[0]))
+
+// What the uplink receiver knows of each field
+struct Receiver {
+    ChangeFilter *filter;
+    double reported[NUM_FIELDS];
+    int16_t reportedCode[NUM_FIELDS];
+    uint32_t reportedMillis[NUM_FIELDS];
+    uint32_t readings = 0;
+    uint32_t violations = 0;
+    uint32_t maxSilenceMillis = 0;
+};
+
+static int8_t FieldIndex(OctaveField field) {
+    for (uint8_t i = 0; i < NUM_FIELDS; i++) {
+        if (deadbands[i].field == field) return i;
+    }
+    return -1;
+}
+
+static void OnRead(OctaveField field, uint8_t errorCode, const OctaveValue &value, void *context) {
+    Receiver &receiver = *static_cast<Receiver*>(context);
+    int8_t i = FieldIndex(field);
+    if (i < 0 || errorCode != 0) return;
+    receiver.readings++;
+
+    bool isDouble = OctaveRegisterMap::Get(field).kind == OctaveDecodeKind::Double;
+    double current = isDouble ? value.float64 : value.int16[0];
+    uint32_t now = millis();
+    if (receiver.filter->Update(field, errorCode, value, now)) {
+        if (now - receiver.reportedMillis[i] > receiver.maxSilenceMillis) receiver.maxSilenceMillis = now - receiver.reportedMillis[i];
+        receiver.reported[i] = current;
+        receiver.reportedMillis[i] = now;
+        return;
+    }
+
+    // Not reported, the receiver's value must still be within the deadband
+    double threshold = deadbands[i].relative * fabs(receiver.reported[i]);
+    if (threshold < deadbands[i].absolute) threshold = deadbands[i].absolute;
+    if (fabs(current - receiver.reported[i]) > threshold) receiver.violations++;
+    if (now - receiver.reportedMillis[i] >= HEARTBEAT_MILLIS) receiver.violations++;
+}
+
+// Run the night, with or without the deadbands, returns the readings reported
+static uint32_t RunNight(bool filtered, Receiver &receiver) {
+    HostClock::Reset();
+    HardwareSerial port(1);
+    port.begin(9600);
+    OctaveSlaveSimulator simulator(port);
+    simulator.SetLineSettings(9600);
+    SimulatedOctave &meter = simulator.AddMeter(MODBUS_SLAVE_ADDRESS);
+    meter.inputRegisters[0x34] = 18;
+
+    OctaveModbusWrapper octave(port);
+    octave.begin(9600);
+    PollScheduler scheduler(octave);
+    ChangeFilter filter(octave);
+    for (uint8_t i = 0; i < NUM_FIELDS; i++) {
+        scheduler.AddField(deadbands[i].field, POLL_PERIOD_MILLIS);
+        if (filtered) filter.SetDeadband(deadbands[i].field, deadbands[i].absolute, deadbands[i].relative, HEARTBEAT_MILLIS);
+    }
+    receiver.filter = &filter;
+    scheduler.SetCallback(OnRead, &receiver);
+
+    // Same night for both runs
+    std::mt19937 random(7);
+    std::uniform_int_distribution<uint32_t> useStart(0, NIGHT_MILLIS - USE_MILLIS);
+    uint32_t uses[USES_PER_NIGHT];
+    for (uint32_t &start : uses) start = useStart(random);
+    std::uniform_real_distribution<double> noise(-FLOW_NOISE, FLOW_NOISE);
+
+    double volume = 1234.5;
+    uint32_t lastMillis = 0;
+    while (millis() < NIGHT_MILLIS) {
+        uint32_t now = millis();
+        if (now / 1000 != lastMillis / 1000) {
+            // The meter updates its flow and volume every second
+            double flow = noise(random);
+            for (uint32_t start : uses) {
+                if (now >= start && now < start + USE_MILLIS) flow += USE_FLOW;
+            }
+            if (flow > 0.0) volume += flow / 3600.0;
+            meter.SetFlow(flow);
+            meter.SetVolumes(volume, 0.0);
+            // The water warms up by a degree during a use
+            meter.inputRegisters[0x34] = flow > USE_FLOW / 2 ? 19 : 18;
+            lastMillis = now;
+        }
+        scheduler.Poll();
+        delayMicroseconds(LOOP_MICROS);
+    }
+    return filter.Reported();
+}
+
+// Readings a filter on the wrapper's read callback forwards, and the ones that aren't of its meter
+struct MeterReadings {
+    double flow;
+    uint32_t reported = 0;
+    uint32_t wrongMeter = 0;
+};
+
+static void OnMeterReading(OctaveField, uint8_t errorCode, const OctaveValue &value, void *context) {
+    MeterReadings &readings = *static_cast<MeterReadings*>(context);
+    readings.reported++;
+    if (errorCode != 0 || value.float64 != readings.flow) readings.wrongMeter++;
+}
+
+// The wrapper has a single read callback, it goes to both filters
+static void ForwardToBoth(OctaveField field, uint8_t errorCode, const OctaveValue &value, void *context) {
+    ChangeFilter **filters = static_cast<ChangeFilter**>(context);
+    ChangeFilter::Forward(field, errorCode, value, filters[0]);
+    ChangeFilter::Forward(field, errorCode, value, filters[1]);
+}
+
+// Two meters with steady, different flows, read in turn, with a filter per meter on the wrapper's read callback
+// Each filter must report the first flow of its meter once, and never a flow of the other one
+static bool CheckTwoMeters() {
+    HostClock::Reset();
+    HardwareSerial port(1);
+    port.begin(9600);
+    OctaveSlaveSimulator simulator(port);
+    simulator.SetLineSettings(9600);
+    simulator.AddMeter(1).SetFlow(1.0);
+    simulator.AddMeter(2).SetFlow(5.0);
+
+    OctaveModbusWrapper octave(port, 1);
+    octave.begin(9600);
+    ChangeFilter first(octave, 1), second(octave, 2);
+    MeterReadings firstReadings, secondReadings;
+    firstReadings.flow = 1.0;
+    secondReadings.flow = 5.0;
+    first.SetDeadband(OctaveField::SignedCurrentFlow_double, 0.01);
+    second.SetDeadband(OctaveField::SignedCurrentFlow_double, 0.01);
+    first.SetCallback(OnMeterReading, &firstReadings);
+    second.SetCallback(OnMeterReading, &secondReadings);
+
+    ChangeFilter *filters[] = {&first, &second};
+    octave.SetReadCallback(ForwardToBoth, filters);
+    for (uint8_t i = 0; i < 10; i++) {
+        octave.BlockingRead(OctaveField::SignedCurrentFlow_double, 1);
+        octave.BlockingRead(OctaveField::SignedCurrentFlow_double, 2);
+    }
+
+    printf("Two meters on one read callback: meter 1 reported %u of %u readings, meter 2 %u of %u, %u of the other meter\n",
+           firstReadings.reported, first.Received(), secondReadings.reported, second.Received(),
+           firstReadings.wrongMeter + secondReadings.wrongMeter);
+    return firstReadings.reported == 1 && secondReadings.reported == 1 && first.Received() == 10 &&
+           second.Received() == 10 && firstReadings.wrongMeter + secondReadings.wrongMeter == 0;
+}
+
+int main() {
+    // Without deadbands, the filter still drops the readings that didn't change at all
+    Receiver anyChange = {}, deadband = {};
+    uint32_t changes = RunNight(false, anyChange);
+    uint32_t reported = RunNight(true, deadband);
+
+    printf("Quiet night, %u fields read every %u s for %lu h\n", (unsigned)NUM_FIELDS, POLL_PERIOD_MILLIS / 1000,
+           NIGHT_MILLIS / 3600000UL);
+    printf("%-16s %12s %10s\n", "reported", "readings", "fewer");
+    printf("%-16s %12u %9.1fx\n", "every reading", anyChange.readings, 1.0);
+    printf("%-16s %12u %9.1fx\n", "any change", changes, (double)anyChange.readings / changes);
+    printf("%-16s %12u %9.1fx\n", "deadband", reported, (double)deadband.readings / reported);
+    printf("\nLongest silence of a field: %.1f min, readings outside the deadband or heartbeat: %u\n",
+           deadband.maxSilenceMillis / 60000.0, deadband.violations);
+    bool twoMeters = CheckTwoMeters();
+    return deadband.violations == 0 && twoMeters ? 0 : 1;
+}
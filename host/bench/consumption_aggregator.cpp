@@ -0,0 +1,231 @@
+// Consumption summaries of a ConsumptionAggregator against shipping every reading, over 2 hours of a meter
+// with a few water uses, a backflow episode and sensor noise, read every second with a PollScheduler
+// Every reading is encoded as a telemetry record, as it would be sent without the aggregator, and every
+// window summary, of 1 minute, 15 minutes and 1 hour, is encoded, decoded back and checked against
+// statistics computed from the readings of its window. The volumes of the windows must add up exactly
+// to the increase of the counters. A day long window of flows over the whole range checks the variance
+// where the sum of the squared deviations takes more than 64 bits
+
+#include <Arduino.h>
+#include <map>
+#include <random>
+#include <vector>
+#include "ConsumptionAggregator.h"
+#include "PollScheduler.h"
+#include "Telemetry.h"
+#include "TelemetryReader.h"
+#include "../sim/OctaveSlaveSimulator.h"
+
+#define RUN_MILLIS (2 * 3600000UL)
+#define POLL_PERIOD_MILLIS 1000
+// Time spent in the rest of loop() between two calls to Poll()
+#define LOOP_MICROS 200
+
+// Day long window read every 100 ms, of flows up to 2000000 units either way
+#define HIGH_FLOW_WINDOW_MILLIS (24 * 3600000UL)
+#define HIGH_FLOW_PERIOD_MILLIS 100
+#define HIGH_FLOW_MAX 2000000.0
+
+static const uint32_t windows[] = {60000UL, 15 * 60000UL, 3600000UL};
+#define NUM_WINDOWS (sizeof(windows) / sizeof(windows[0]))
+
+struct Reading {
+    uint32_t millis;
+    OctaveField field;
+    double value;
+};
+
+struct Bench {
+    ConsumptionAggregator aggregator{MODBUS_SLAVE_ADDRESS};
+    std::vector<Reading> readings;
+    uint32_t readingBytes = 0;
+    uint32_t summaryBytes[NUM_WINDOWS] = {};
+    uint32_t summaries[NUM_WINDOWS] = {};
+    int64_t forwardVolume[NUM_WINDOWS] = {};
+    int64_t reverseVolume[NUM_WINDOWS] = {};
+    uint32_t mismatches = 0;
+};
+
+static int64_t Scaled(double value) {
+    return llround(value * CONSUMPTION_SCALE);
+}
+
+static void OnRead(OctaveField field, uint8_t errorCode, const OctaveValue &value, void *context) {
+    Bench &bench = *static_cast<Bench*>(context);
+    if (errorCode != 0) return;
+
+    uint8_t buffer[TELEMETRY_MAX_READING_BYTES];
+    TelemetryEncoder encoder(buffer, sizeof(buffer));
+    encoder.Reading(field, errorCode, &value);
+    bench.readingBytes += encoder.Length();
+
+    bench.readings.push_back({(uint32_t)millis(), field, value.float64});
+    bench.aggregator.Update(field, errorCode, value, millis());
+}
+
+// Statistics of the flow readings of a window, from the readings
+static bool CheckSummary(const Bench &bench, const ConsumptionSummary &summary) {
+    uint32_t samples = 0, reverseSamples = 0;
+    int64_t minFlow = INT64_MAX, maxFlow = INT64_MIN;
+    double sum = 0.0, squares = 0.0;
+    for (const Reading &reading : bench.readings) {
+        if (reading.field != OctaveField::SignedCurrentFlow_double) continue;
+        if (reading.millis < summary.startMillis || reading.millis - summary.startMillis >= summary.durationMillis) continue;
+        int64_t flow = Scaled(reading.value);
+        samples++;
+        if (flow < 0) reverseSamples++;
+        if (flow < minFlow) minFlow = flow;
+        if (flow > maxFlow) maxFlow = flow;
+        sum += flow;
+        squares += (double)flow * flow;
+    }
+    if (samples != summary.flowSamples || reverseSamples != summary.reverseFlowSamples) return false;
+    if (samples == 0) return true;
+    double mean = sum / samples;
+    double variance = squares / samples - mean * mean;
+    return minFlow == summary.minFlow && maxFlow == summary.maxFlow && fabs(mean - summary.meanFlow) <= 0.5 &&
+           fabs(variance - (double)summary.flowVariance) <= 1.0 + 1e-9 * variance;
+}
+
+static uint8_t WindowIndex(uint32_t durationMillis) {
+    for (uint8_t i = 0; i < NUM_WINDOWS; i++) {
+        if (windows[i] == durationMillis) return i;
+    }
+    return 0;
+}
+
+static void OnSummary(const ConsumptionSummary &summary, void *context) {
+    Bench &bench = *static_cast<Bench*>(context);
+    uint8_t i = WindowIndex(summary.durationMillis);
+
+    uint8_t buffer[TELEMETRY_MAX_SUMMARY_BYTES];
+    TelemetryEncoder encoder(buffer, sizeof(buffer));
+    encoder.Summary(summary);
+    bench.summaryBytes[i] += encoder.Length();
+    bench.summaries[i]++;
+    bench.forwardVolume[i] += summary.forwardVolume;
+    bench.reverseVolume[i] += summary.reverseVolume;
+
+    // The decoded summary must be the same, and match the readings
+    TelemetryReader reader(encoder.Data(), encoder.Length());
+    TelemetryRecord record;
+    const ConsumptionSummary &decoded = record.summary;
+    bool same = reader.Next(&record) && record.header == TELEMETRY_HEADER_SUMMARY &&
+                summary.slaveAddress == MODBUS_SLAVE_ADDRESS && decoded.slaveAddress == summary.slaveAddress &&
+                decoded.startMillis == summary.startMillis &&
+                decoded.durationMillis == summary.durationMillis && decoded.forwardVolume == summary.forwardVolume &&
+                decoded.reverseVolume == summary.reverseVolume && decoded.flowSamples == summary.flowSamples &&
+                decoded.reverseFlowSamples == summary.reverseFlowSamples && decoded.minFlow == summary.minFlow &&
+                decoded.maxFlow == summary.maxFlow && decoded.meanFlow == summary.meanFlow &&
+                decoded.flowVariance == summary.flowVariance;
+    if (!same || !CheckSummary(bench, summary)) bench.mismatches++;
+}
+
+static void OnHighFlowSummary(const ConsumptionSummary &summary, void *context) {
+    *static_cast<ConsumptionSummary*>(context) = summary;
+}
+
+// The day long window of high flows, checked against a two-pass mean and variance of its readings
+static bool CheckHighFlow() {
+    ConsumptionAggregator aggregator(MODBUS_SLAVE_ADDRESS);
+    aggregator.AddWindow(HIGH_FLOW_WINDOW_MILLIS);
+    ConsumptionSummary summary = {};
+    aggregator.SetCallback(OnHighFlowSummary, &summary);
+
+    std::mt19937 random(5);
+    std::uniform_real_distribution<double> flows(-HIGH_FLOW_MAX, HIGH_FLOW_MAX);
+    std::vector<int64_t> readings;
+    for (uint32_t now = 0; now < HIGH_FLOW_WINDOW_MILLIS; now += HIGH_FLOW_PERIOD_MILLIS) {
+        OctaveValue value;
+        value.float64 = round(flows(random));
+        aggregator.Update(OctaveField::SignedCurrentFlow_double, 0, value, now);
+        readings.push_back(Scaled(value.float64));
+    }
+    aggregator.Poll(HIGH_FLOW_WINDOW_MILLIS);
+
+    long double mean = 0.0L, variance = 0.0L;
+    for (int64_t flow : readings) mean += flow;
+    mean /= readings.size();
+    for (int64_t flow : readings) variance += (flow - mean) * (flow - mean);
+    variance /= readings.size();
+
+    printf("\n%lu h window of flows up to %.0f every %u ms: %u readings, variance %.9Le, expected %.9Le\n",
+           HIGH_FLOW_WINDOW_MILLIS / 3600000UL, HIGH_FLOW_MAX, HIGH_FLOW_PERIOD_MILLIS, summary.flowSamples,
+           (long double)summary.flowVariance, variance);
+    return summary.flowSamples == readings.size() && fabsl(mean - summary.meanFlow) <= 0.5L &&
+           fabsl(variance - summary.flowVariance) <= 1e-9L * variance;
+}
+
+int main() {
+    HostClock::Reset();
+    HardwareSerial port(1);
+    port.begin(9600);
+    OctaveSlaveSimulator simulator(port);
+    simulator.SetLineSettings(9600);
+    SimulatedOctave &meter = simulator.AddMeter(MODBUS_SLAVE_ADDRESS);
+
+    OctaveModbusWrapper octave(port);
+    octave.begin(9600);
+    PollScheduler scheduler(octave);
+    scheduler.AddField(OctaveField::ForwardVolume_double, POLL_PERIOD_MILLIS);
+    scheduler.AddField(OctaveField::ReverseVolume_double, POLL_PERIOD_MILLIS);
+    scheduler.AddField(OctaveField::SignedCurrentFlow_double, POLL_PERIOD_MILLIS);
+
+    Bench bench;
+    for (uint32_t duration : windows) bench.aggregator.AddWindow(duration);
+    bench.aggregator.SetCallback(OnSummary, &bench);
+    scheduler.SetCallback(OnRead, &bench);
+
+    // Flow in m3/h, volumes in m3, both rounded to the litre like the meter's registers
+    std::mt19937 random(3);
+    std::normal_distribution<double> noise(0.0, 0.002);
+    double forward = 1234.567, reverse = 2.5;
+    uint32_t lastSecond = UINT32_MAX;
+    while (millis() < RUN_MILLIS) {
+        uint32_t second = millis() / 1000;
+        if (second != lastSecond) {
+            // Uses of a few minutes every 20 minutes, and backflow for 2 minutes after the first hour
+            double flow = noise(random);
+            if (second % 1200 < 240) flow += 0.8 + 0.2 * sin(second / 30.0);
+            if (second >= 4000 && second < 4120) flow -= 0.3;
+            flow = round(flow * 1000.0) / 1000.0;
+            if (flow > 0.0) forward += flow / 3600.0;
+            else reverse -= flow / 3600.0;
+            meter.SetFlow(flow);
+            meter.SetVolumes(round(forward * 1000.0) / 1000.0, round(reverse * 1000.0) / 1000.0);
+            lastSecond = second;
+        }
+        scheduler.Poll();
+        delayMicroseconds(LOOP_MICROS);
+    }
+    // Close the last windows
+    bench.aggregator.Poll(RUN_MILLIS + windows[NUM_WINDOWS - 1]);
+
+    // Increase of the counters, from the first reading to the last
+    int64_t forwardIncrease = 0, reverseIncrease = 0;
+    std::map<OctaveField, double> first, last;
+    for (const Reading &reading : bench.readings) {
+        if (first.count(reading.field) == 0) first[reading.field] = reading.value;
+        last[reading.field] = reading.value;
+    }
+    forwardIncrease = Scaled(last[OctaveField::ForwardVolume_double]) - Scaled(first[OctaveField::ForwardVolume_double]);
+    reverseIncrease = Scaled(last[OctaveField::ReverseVolume_double]) - Scaled(first[OctaveField::ReverseVolume_double]);
+
+    printf("%lu h of readings every %u s: %u readings, %u telemetry bytes\n", RUN_MILLIS / 3600000UL,
+           POLL_PERIOD_MILLIS / 1000, (unsigned)bench.readings.size(), bench.readingBytes);
+    printf("%-10s %10s %10s %10s %14s %14s\n", "window", "summaries", "bytes", "fewer", "forward l", "reverse l");
+    bool volumesMatch = true;
+    for (uint8_t i = 0; i < NUM_WINDOWS; i++) {
+        printf("%6u min %10u %10u %9.0fx %14.3f %14.3f\n", windows[i] / 60000, bench.summaries[i], bench.summaryBytes[i],
+               (double)bench.readingBytes / bench.summaryBytes[i], bench.forwardVolume[i] * 1000.0 / CONSUMPTION_SCALE,
+               bench.reverseVolume[i] * 1000.0 / CONSUMPTION_SCALE);
+        volumesMatch = volumesMatch && bench.forwardVolume[i] == forwardIncrease && bench.reverseVolume[i] == reverseIncrease;
+    }
+    printf("\nCounter increase: forward %.3f l, reverse %.3f l, windows %s\n", forwardIncrease * 1000.0 / CONSUMPTION_SCALE,
+           reverseIncrease * 1000.0 / CONSUMPTION_SCALE, volumesMatch ? "add up exactly" : "DON'T ADD UP");
+    printf("Summaries that don't match their readings: %u\n", bench.mismatches);
+
+    bool highFlow = CheckHighFlow();
+    if (!highFlow) printf("The high flow window doesn't match its readings\n");
+    return volumesMatch && bench.mismatches == 0 && highFlow ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// Decoding cost of 32- and 64-bit register values, in ns per decoded value
+// Compares the shift/mask decoders used before the byte-swap ones, the scalar byte-swap
+// decoders, and the batch decoders on back-to-back values and on raw snapshots of many meters
+// Also compares the number compression of truncateDoubleto32bits with the strtod-based one it replaced
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "OctaveModbusWrapper.h"
+
+#define NUM_VALUES 4096
+#define NUM_METERS 256
+#define REPETITIONS 2000
+
+// Decoders as they were before RegisterDecoding.h, kept here as the baseline
+static uint32_t ShiftCombineABCD(const uint16_t* registers){
+  return (static_cast<uint32_t>(registers[0]) << 16) + static_cast<uint32_t>(registers[1]);
+}
+
+static double ShiftCombineHGFEDCBA(const uint16_t* registers){
+  uint64_t auxDoubleBuffer = 0;
+
+  auxDoubleBuffer |= static_cast<uint64_t>(registers[3] >> 8) << 48; // H
+  auxDoubleBuffer |= static_cast<uint64_t>(registers[3] & 0xFF) << 56; // G
+  auxDoubleBuffer |= static_cast<uint64_t>(registers[2] >> 8) << 32; // F
+  auxDoubleBuffer |= static_cast<uint64_t>(registers[2] & 0xFF) << 40; // E
+  auxDoubleBuffer |= static_cast<uint64_t>(registers[1] >> 8) << 16; // D
+  auxDoubleBuffer |= static_cast<uint64_t>(registers[1] & 0xFF) << 24; // C
+  auxDoubleBuffer |= static_cast<uint64_t>(registers[0] >> 8);  // B
+  auxDoubleBuffer |= static_cast<uint64_t>(registers[0] & 0xFF) << 8;  // A
+
+  // The original cast the pointer, which breaks strict aliasing, the copy compiles to the same move
+  double output;
+  memcpy(&output, &auxDoubleBuffer, sizeof(output));
+  return output;
+}
+
+// Number compression as it was before the limits were parsed at compile time, kept here as the baseline
+static uint8_t StrtodTruncateDoubleto32bits(double &input, int32_t &output){
+  if (input > strtod(DEC32_MAX, nullptr)) {
+    output = INT32_MAX;
+    return 8;
+  }
+  else if (input < strtod(DEC32_MIN, nullptr)) {
+    output = INT32_MIN;
+    return 9;
+  }
+  output = static_cast<int32_t>(input * strtod(SCALE_FACTOR, nullptr));
+  return 0;
+}
+
+// Keeps the decoded values alive, so the loops aren't optimized away
+static volatile double sink;
+
+// Run a decode pass REPETITIONS times and return ns per decoded value
+template <typename Pass>
+static double NanosPerValue(Pass pass, size_t valuesPerPass) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < REPETITIONS; i++) pass();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (static_cast<double>(valuesPerPass) * REPETITIONS);
+}
+
+int main() {
+    // Back-to-back values, with a bit pattern that changes per value
+    std::vector<uint16_t> registers(4 * NUM_VALUES);
+    for (size_t i = 0; i < registers.size(); i++) registers[i] = static_cast<uint16_t>(i * 2654435761u >> 7);
+    std::vector<double> doubles(NUM_VALUES);
+    std::vector<uint32_t> uint32s(NUM_VALUES);
+
+    // Raw snapshots of many meters, decoding one 64-bit value per meter
+    std::vector<uint16_t> snapshots(SNAPSHOT_NUM_REGISTERS * NUM_METERS);
+    for (size_t i = 0; i < snapshots.size(); i++) snapshots[i] = static_cast<uint16_t>(i * 40503u);
+    std::vector<double> column(NUM_METERS);
+
+    // Every decoder must agree
+    DecodeDoubleArray(registers.data(), 4, doubles.data(), NUM_VALUES);
+    for (size_t i = 0; i < NUM_VALUES; i++) {
+        double before = ShiftCombineHGFEDCBA(&registers[4 * i]);
+        double after = DecodeHGFEDCBA(&registers[4 * i]);
+        if (memcmp(&before, &after, sizeof(double)) != 0 || memcmp(&before, &doubles[i], sizeof(double)) != 0 ||
+            ShiftCombineABCD(&registers[2 * i]) != DecodeABCD(&registers[2 * i])) {
+            printf("Decoders disagree at value %zu\n", i);
+            return 1;
+        }
+    }
+
+    printf("%-36s %12s\n", "decoder", "ns/value");
+
+    printf("%-36s %12.3f\n", "64-bit shift/mask (before)", NanosPerValue([&]() {
+        for (size_t i = 0; i < NUM_VALUES; i++) doubles[i] = ShiftCombineHGFEDCBA(&registers[4 * i]);
+        sink = doubles[NUM_VALUES - 1];
+    }, NUM_VALUES));
+    printf("%-36s %12.3f\n", "64-bit bswap scalar", NanosPerValue([&]() {
+        for (size_t i = 0; i < NUM_VALUES; i++) doubles[i] = DecodeHGFEDCBA(&registers[4 * i]);
+        sink = doubles[NUM_VALUES - 1];
+    }, NUM_VALUES));
+    printf("%-36s %12.3f\n", "64-bit batch, back to back", NanosPerValue([&]() {
+        DecodeDoubleArray(registers.data(), 4, doubles.data(), NUM_VALUES);
+        sink = doubles[NUM_VALUES - 1];
+    }, NUM_VALUES));
+    printf("%-36s %12.3f\n", "64-bit batch, one per meter", NanosPerValue([&]() {
+        DecodeDoubleArray(&snapshots[0x18], SNAPSHOT_NUM_REGISTERS, column.data(), NUM_METERS);
+        sink = column[NUM_METERS - 1];
+    }, NUM_METERS));
+
+    printf("%-36s %12.3f\n", "32-bit shift (before)", NanosPerValue([&]() {
+        for (size_t i = 0; i < NUM_VALUES; i++) uint32s[i] = ShiftCombineABCD(&registers[2 * i]);
+        sink = uint32s[NUM_VALUES - 1];
+    }, NUM_VALUES));
+    printf("%-36s %12.3f\n", "32-bit batch, back to back", NanosPerValue([&]() {
+        DecodeUInt32Array(registers.data(), 2, uint32s.data(), NUM_VALUES);
+        sink = uint32s[NUM_VALUES - 1];
+    }, NUM_VALUES));
+
+    // Volumes with 2 decimal places
+    std::vector<double> volumes(NUM_VALUES);
+    std::vector<int32_t> compressed(NUM_VALUES);
+    for (size_t i = 0; i < NUM_VALUES; i++) volumes[i] = static_cast<double>(i * 7919 % 10000000) / 100.0;
+    for (size_t i = 0; i < NUM_VALUES; i++) {
+        int32_t before, after;
+        if (StrtodTruncateDoubleto32bits(volumes[i], before) != truncateDoubleto32bits(volumes[i], after) || before != after) {
+            printf("Truncations disagree at value %zu\n", i);
+            return 1;
+        }
+    }
+
+    printf("%-36s %12.3f\n", "32-bit truncation, strtod (before)", NanosPerValue([&]() {
+        for (size_t i = 0; i < NUM_VALUES; i++) StrtodTruncateDoubleto32bits(volumes[i], compressed[i]);
+        sink = compressed[NUM_VALUES - 1];
+    }, NUM_VALUES));
+    printf("%-36s %12.3f\n", "32-bit truncation, integer", NanosPerValue([&]() {
+        for (size_t i = 0; i < NUM_VALUES; i++) truncateDoubleto32bits(volumes[i], compressed[i]);
+        sink = compressed[NUM_VALUES - 1];
+    }, NUM_VALUES));
+    return 0;
+}
@@ -0,0 +1,152 @@
+// Time to format a double with FormatDouble() against sprintf, as PrintDouble() did with "%.12g",
+// and with "%.17g", the shortest printf format that always reads back as the same double
+// Values are meter-like readings with 3 decimals, then random bit patterns covering every exponent
+// Every output of FormatDouble() is read back with strtod and must give the same bits, and its length
+// is compared to the shortest "%.*e" that reads back. Subnormals, whose rounding interval is the same
+// on both sides, are checked on their own, and the edge cases among them must be the shortest
+
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "DoubleFormat.h"
+
+#define NUM_VALUES 200000
+#define ROUND_TRIP_VALUES 1000000
+#define SUBNORMAL_VALUES 200000
+
+static volatile uint32_t sink;
+
+// Nanoseconds per value of a formatter
+template <typename Formatter>
+static double Measure(const std::vector<double> &values, Formatter format) {
+    char buffer[32];
+    uint32_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (double value : values) total += format(value, buffer);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sink = total;
+    return seconds * 1e9 / values.size();
+}
+
+static double RandomDouble(std::mt19937_64 &random) {
+    uint64_t bits;
+    double value;
+    // Every finite double, NaN and infinities excluded
+    do {
+        bits = random();
+        memcpy(&value, &bits, sizeof(value));
+    } while (((bits >> 52) & 0x7FF) == 0x7FF);
+    return value;
+}
+
+static double Subnormal(uint64_t fraction) {
+    double value;
+    memcpy(&value, &fraction, sizeof(value));
+    return value;
+}
+
+// Digits of the shortest "%.*e" that reads back as the same double
+static uint8_t ShortestDigits(double value) {
+    char shortest[32];
+    uint8_t digits = 1;
+    for (; digits < 17; digits++) {
+        sprintf(shortest, "%.*e", digits - 1, value);
+        if (strtod(shortest, nullptr) == value) break;
+    }
+    return digits;
+}
+
+// Significant digits of an output of FormatDouble()
+static uint8_t FormatDigits(const char *buffer) {
+    uint8_t formatDigits = 0;
+    for (const char *c = buffer; *c != '\0' && *c != 'e'; c++) {
+        if (*c >= '1' && *c <= '9') formatDigits++;
+        else if (*c == '0' && formatDigits > 0) formatDigits++;
+    }
+    // Trailing zeros of integers aren't significant digits
+    if (strchr(buffer, '.') == nullptr && strchr(buffer, 'e') == nullptr) {
+        for (const char *c = buffer + strlen(buffer) - 1; c > buffer && *c == '0'; c--) formatDigits--;
+    }
+    return formatDigits;
+}
+
+// Whether FormatDouble() reads back as the same bits
+static bool ReadsBack(double value, const char *buffer, uint8_t length) {
+    double parsed = strtod(buffer, nullptr);
+    return memcmp(&parsed, &value, sizeof(value)) == 0 && length == strlen(buffer);
+}
+
+static void Compare(const char *name, const std::vector<double> &values) {
+    double grisu = Measure(values, [](double value, char *buffer) { return (uint32_t)FormatDouble(value, buffer); });
+    double sprintf12 = Measure(values, [](double value, char *buffer) { return (uint32_t)sprintf(buffer, "%.12g", value); });
+    double sprintf17 = Measure(values, [](double value, char *buffer) { return (uint32_t)sprintf(buffer, "%.17g", value); });
+    printf("%-14s %14.1f %14.1f %14.1f %10.1fx %10.1fx\n", name, grisu, sprintf12, sprintf17, sprintf12 / grisu,
+           sprintf17 / grisu);
+}
+
+int main() {
+    std::mt19937_64 random(1);
+
+    std::vector<double> readings(NUM_VALUES);
+    std::uniform_int_distribution<int64_t> thousandths(-1000000000, 100000000000);
+    for (double &value : readings) value = thousandths(random) / 1000.0;
+    std::vector<double> bitPatterns(NUM_VALUES);
+    for (double &value : bitPatterns) value = RandomDouble(random);
+
+    printf("%-14s %14s %14s %14s %11s %11s\n", "values", "FormatDouble", "%.12g", "%.17g", "vs %.12g", "vs %.17g");
+    printf("%-14s %14s %14s %14s\n", "", "ns/value", "ns/value", "ns/value");
+    Compare("readings", readings);
+    Compare("random bits", bitPatterns);
+
+    // Round trip and length against the shortest exact scientific form
+    uint32_t mismatches = 0, longer = 0;
+    char buffer[FORMAT_DOUBLE_BUFFER_SIZE];
+    for (uint32_t i = 0; i < ROUND_TRIP_VALUES; i++) {
+        double value = i % 2 == 0 ? RandomDouble(random) : readings[i % NUM_VALUES];
+        uint8_t length = FormatDouble(value, buffer);
+        if (!ReadsBack(value, buffer, length)) {
+            if (mismatches++ < 5) printf("mismatch: %.17g formatted as %s\n", value, buffer);
+        }
+        if (FormatDigits(buffer) > ShortestDigits(value)) longer++;
+    }
+
+    // Random subnormals, every fraction below the hidden bit
+    uint32_t subnormalMismatches = 0, subnormalLonger = 0;
+    for (uint32_t i = 0; i < SUBNORMAL_VALUES; i++) {
+        double value = Subnormal(random() & 0xFFFFFFFFFFFFFULL);
+        uint8_t length = FormatDouble(value, buffer);
+        if (!ReadsBack(value, buffer, length)) {
+            if (subnormalMismatches++ < 5) printf("mismatch: %.17g formatted as %s\n", value, buffer);
+        }
+        if (FormatDigits(buffer) > ShortestDigits(value)) subnormalLonger++;
+    }
+
+    // Special values, and the edge subnormals, which must be the shortest form
+    static const double specials[] = {0.0, -0.0, 1.0, -1.5, 0.001, 1e-4, 1e17, 1e18, 1.7976931348623157e308,
+                                      2.2250738585072014e-308};
+    const double subnormals[] = {Subnormal(1), -Subnormal(1), Subnormal(2), Subnormal(3), Subnormal(5),
+                                 Subnormal(1ULL << 26), Subnormal(1ULL << 51), Subnormal(0xFFFFFFFFFFFFFULL),
+                                 1e-310, 1e-320, 1.5e-320, 2.5e-323};
+    printf("\n%-26s %s\n", "value, %.17g", "FormatDouble");
+    for (double value : specials) {
+        FormatDouble(value, buffer);
+        printf("%-26.17g %s\n", value, buffer);
+    }
+    uint32_t subnormalEdges = 0;
+    for (double value : subnormals) {
+        uint8_t length = FormatDouble(value, buffer);
+        bool shortest = ReadsBack(value, buffer, length) && FormatDigits(buffer) == ShortestDigits(value);
+        if (!shortest) subnormalEdges++;
+        printf("%-26.17g %s%s\n", value, buffer, shortest ? "" : ", NOT THE SHORTEST");
+    }
+
+    printf("\n%u doubles formatted, %u don't read back as the same double, %u are longer than the shortest form\n",
+           ROUND_TRIP_VALUES, mismatches, longer);
+    printf("%u subnormals formatted, %u don't read back as the same double, %u are longer than the shortest form\n",
+           SUBNORMAL_VALUES, subnormalMismatches, subnormalLonger);
+    if (subnormalEdges > 0) printf("%u edge subnormals aren't the shortest form\n", subnormalEdges);
+    return mismatches == 0 && subnormalMismatches == 0 && subnormalEdges == 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+// Snapshot throughput of a gateway with the same meters spread over 1, 2 and 3 RS-485 buses,
+// each polled by its own MultiBus thread, as the ESP32 tasks would on their UARTs
+// Throughput is in simulated bus time, each thread has its own clock. The main thread reads
+// the shared SnapshotStore meanwhile, as the uplink task would. Every entry must match its meter and be updated
+
+#include <Arduino.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "MultiBus.h"
+#include "../sim/OctaveSlaveSimulator.h"
+
+#define NUM_METERS 24
+// Wall-clock time each configuration runs for
+#define RUN_MILLIS 500
+
+static const unsigned long baudrates[] = {9600, 38400, 115200};
+
+// One UART with its simulated meters, wrapper and MeterBus
+struct Bus {
+    HardwareSerial port;
+    OctaveSlaveSimulator simulator;
+    OctaveModbusWrapper octave;
+    std::vector<uint8_t> slaveAddresses;
+    std::vector<OctaveSnapshot> snapshots;
+    std::vector<uint8_t> errorCodes;
+    std::unique_ptr<MeterBus> meterBus;
+
+    Bus(int uart, unsigned long baudrate, uint8_t firstAddress, uint8_t numMeters)
+        : port(uart), simulator(port), octave(port), slaveAddresses(numMeters), snapshots(numMeters), errorCodes(numMeters) {
+        port.begin(baudrate);
+        simulator.SetLineSettings(baudrate);
+        for (uint8_t i = 0; i < numMeters; i++) {
+            slaveAddresses[i] = firstAddress + i;
+            simulator.AddMeter(slaveAddresses[i]).SetVolumes(100.0 * slaveAddresses[i], 0.0);
+        }
+        octave.begin(baudrate);
+        meterBus.reset(new MeterBus(octave, slaveAddresses.data(), numMeters, snapshots.data(), errorCodes.data()));
+    }
+};
+
+int main() {
+    printf("%-8s %6s %12s %14s %10s %14s %12s\n", "baud", "buses", "meters/bus", "snapshots/s", "speedup",
+           "store reads/s", "store errors");
+    uint32_t totalErrors = 0;
+
+    for (unsigned long baudrate : baudrates) {
+        float singleBus = 0.0;
+        for (uint8_t numBuses = 1; numBuses <= MULTI_BUS_MAX_BUSES; numBuses++) {
+            SnapshotStoreEntry entries[NUM_METERS];
+            SnapshotStore store(entries, NUM_METERS);
+            MultiBus multiBus(store);
+
+            std::vector<std::unique_ptr<Bus>> buses;
+            uint8_t metersPerBus = NUM_METERS / numBuses;
+            for (uint8_t i = 0; i < numBuses; i++) {
+                buses.emplace_back(new Bus(i + 1, baudrate, 1 + i * metersPerBus, metersPerBus));
+                multiBus.AddBus(*buses.back()->meterBus, i * metersPerBus, i % 2);
+            }
+
+            // Read every entry of the store while the buses run, checking that each one is consistent
+            uint64_t reads = 0;
+            uint32_t errors = 0;
+            multiBus.Start();
+            auto start = std::chrono::steady_clock::now();
+            while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(RUN_MILLIS)) {
+                for (uint16_t i = 0; i < NUM_METERS; i++) {
+                    SnapshotStoreEntry entry;
+                    store.Read(i, &entry);
+                    reads++;
+                    if (entry.updates > 0 && (entry.errorCode != 0 || entry.snapshot.forwardVolume != 100.0 * (i + 1))) errors++;
+                }
+            }
+            multiBus.Stop();
+            for (uint16_t i = 0; i < NUM_METERS; i++) {
+                SnapshotStoreEntry entry;
+                store.Read(i, &entry);
+                if (entry.updates == 0) errors++;
+            }
+            totalErrors += errors;
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            float snapshotsPerSecond = multiBus.SnapshotsPerSecond();
+            if (numBuses == 1) singleBus = snapshotsPerSecond;
+            printf("%-8lu %6u %12u %14.2f %9.2fx %14.0f %12u\n", baudrate, numBuses, metersPerBus, snapshotsPerSecond,
+                   snapshotsPerSecond / singleBus, reads / seconds, errors);
+        }
+    }
+    if (totalErrors > 0) printf("\n%u store entries were missing or didn't match their meter\n", totalErrors);
+    return totalErrors == 0 ? 0 : 1;
+}
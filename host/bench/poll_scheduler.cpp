@@ -0,0 +1,129 @@
+// Polling a meter with a PollScheduler, compared with calling every getter in a fixed sequence
+// Flow every second, alarms every 5 seconds, volumes every minute and units once, over 10 minutes
+// of simulated bus time at each of the common baud rates, then with the flow every 100 ms,
+// which 2400 baud can't keep up with
+// All times are simulated bus time. Every read must succeed, and every flow value must match the meter's
+
+#include <Arduino.h>
+#include "OctaveModbusWrapper.h"
+#include "PollScheduler.h"
+#include "../sim/OctaveSlaveSimulator.h"
+
+#define MEASURE_MILLIS 600000UL
+// Time spent in the rest of loop() between two calls to Poll()
+#define LOOP_MICROS 200
+// Flow of the simulated meter
+#define METER_FLOW 12.5
+
+static const unsigned long baudrates[] = {2400, 9600, 19200, 38400, 115200};
+
+struct Schedule {
+    OctaveField field;
+    uint32_t periodMillis;
+    uint8_t priority;
+};
+
+static const Schedule schedule[] = {
+    {OctaveField::SignedCurrentFlow_double, 1000, 3},
+    {OctaveField::ReadAlarms, 5000, 2},
+    {OctaveField::ForwardVolume_double, 60000, 1},
+    {OctaveField::ReverseVolume_double, 60000, 1},
+    {OctaveField::NetSignedVolume_double, 60000, 1},
+    {OctaveField::VolumeUnit, POLL_PERIOD_ONCE, 0},
+    {OctaveField::FlowUnit, POLL_PERIOD_ONCE, 0},
+    {OctaveField::TemperatureUnit, POLL_PERIOD_ONCE, 0},
+};
+#define NUM_SCHEDULED (sizeof(schedule) / sizeof(schedule[0]))
+
+// Longest time between two flow reads, number of reads, and reads that failed or didn't match the meter
+struct FlowStats {
+    unsigned long lastMillis = 0;
+    unsigned long maxIntervalMillis = 0;
+    uint32_t reads = 0;
+    uint32_t errors = 0;
+
+    void Read() {
+        unsigned long now = millis();
+        if (reads > 0 && now - lastMillis > maxIntervalMillis) maxIntervalMillis = now - lastMillis;
+        lastMillis = now;
+        reads++;
+    }
+};
+
+static void OnRead(OctaveField field, uint8_t errorCode, const OctaveValue &value, void *context) {
+    FlowStats &flow = *static_cast<FlowStats*>(context);
+    if (errorCode != 0) flow.errors++;
+    else if (field == OctaveField::SignedCurrentFlow_double) {
+        if (value.float64 != METER_FLOW) flow.errors++;
+        flow.Read();
+    }
+}
+
+// Every getter of the schedule in a fixed sequence, as fast as the bus allows
+static void MeasureGetters(OctaveModbusWrapper &octave, uint32_t *requests, FlowStats *flow) {
+    unsigned long start = millis();
+    while (millis() - start < MEASURE_MILLIS) {
+        for (uint8_t i = 0; i < NUM_SCHEDULED; i++) {
+            uint8_t result = octave.BlockingRead(schedule[i].field);
+            (*requests)++;
+            if (result != 0) flow->errors++;
+            if (schedule[i].field == OctaveField::SignedCurrentFlow_double && result == 0) flow->Read();
+        }
+    }
+}
+
+static void MeasureScheduler(uint32_t flowPeriodMillis, PollScheduler &scheduler, FlowStats *flow) {
+    scheduler.SetCallback(OnRead, flow);
+    for (uint8_t i = 0; i < NUM_SCHEDULED; i++) {
+        uint32_t period = schedule[i].field == OctaveField::SignedCurrentFlow_double ? flowPeriodMillis : schedule[i].periodMillis;
+        scheduler.AddField(schedule[i].field, period, schedule[i].priority);
+    }
+
+    unsigned long start = millis();
+    while (millis() - start < MEASURE_MILLIS) {
+        scheduler.Poll();
+        delayMicroseconds(LOOP_MICROS);
+    }
+}
+
+// Returns the number of reads that failed or didn't match the meter
+static uint32_t Run(uint32_t flowPeriodMillis) {
+    uint32_t errors = 0;
+    printf("\nFlow every %u ms\n", flowPeriodMillis);
+    printf("%-8s %14s %14s %14s %14s %14s %14s %14s\n", "baud", "getters req/m", "getters flow", "sched req/m",
+           "sched fields/m", "sched flow", "missed", "max late ms");
+
+    for (unsigned long baudrate : baudrates) {
+        HostClock::Reset();
+        HardwareSerial port(1);
+        port.begin(baudrate);
+        OctaveSlaveSimulator simulator(port);
+        simulator.SetLineSettings(baudrate);
+        simulator.AddMeter(MODBUS_SLAVE_ADDRESS).SetFlow(METER_FLOW);
+
+        OctaveModbusWrapper octave(port);
+        octave.begin(baudrate);
+
+        uint32_t getterRequests = 0;
+        FlowStats getterFlow;
+        MeasureGetters(octave, &getterRequests, &getterFlow);
+
+        PollScheduler scheduler(octave);
+        FlowStats schedulerFlow;
+        MeasureScheduler(flowPeriodMillis, scheduler, &schedulerFlow);
+
+        double minutes = MEASURE_MILLIS / 60000.0;
+        printf("%-8lu %14.0f %11lu ms %14.0f %14.0f %11lu ms %14u %14u\n", baudrate, getterRequests / minutes,
+               getterFlow.maxIntervalMillis, scheduler.Requests() / minutes, scheduler.FieldReads() / minutes,
+               schedulerFlow.maxIntervalMillis, scheduler.MissedDeadlines(), scheduler.MaxLatenessMillis());
+        errors += getterFlow.errors + schedulerFlow.errors;
+    }
+    return errors;
+}
+
+int main() {
+    uint32_t errors = Run(1000);
+    errors += Run(100);
+    if (errors > 0) printf("\n%u reads failed or didn't match the meter\n", errors);
+    return errors == 0 ? 0 : 1;
+}
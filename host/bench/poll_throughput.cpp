@@ -0,0 +1,103 @@
+// Polling throughput of the library against simulated Octave meters
+// All times are simulated bus time, at each of the common baud rates
+// Every request must succeed and every value must match the simulated meters
+
+#include <Arduino.h>
+#include "OctaveModbusWrapper.h"
+#include "MeterBus.h"
+#include "../sim/OctaveSlaveSimulator.h"
+
+#define NUM_METERS 10
+#define MEASURE_MILLIS 60000UL
+
+static const unsigned long baudrates[] = {2400, 9600, 19200, 38400, 115200};
+
+int main() {
+    uint32_t errors = 0;
+    printf("%-8s %16s %16s %20s %12s %16s %16s\n", "baud", "getters ms/cycle", "snapshot ms", "MeterBus snapshots/s",
+           "MeterBus tps", "register sync ms", "clock sync ms");
+
+    for (unsigned long baudrate : baudrates) {
+        HostClock::Reset();
+        HardwareSerial port(1);
+        port.begin(baudrate);
+        OctaveSlaveSimulator simulator(port);
+        simulator.SetLineSettings(baudrate);
+        for (uint8_t address = 1; address <= NUM_METERS; address++) simulator.AddMeter(address).SetVolumes(100.0 * address, 0.0);
+
+        OctaveModbusWrapper octave(port);
+        octave.begin(baudrate);
+
+        // One request per field, as with the getters
+        // The combined clock read is left out, since it repeats the clock fields
+        unsigned long start = micros();
+        for (uint8_t i = 0; i < static_cast<uint8_t>(OctaveField::Count); i++) {
+            OctaveField field = static_cast<OctaveField>(i);
+            const OctaveRegister &info = OctaveRegisterMap::Get(field);
+            if (info.functionCode == 0x04 && info.kind != OctaveDecodeKind::Clock && octave.BlockingRead(field) != 0) errors++;
+        }
+        double gettersMillis = (micros() - start) / 1000.0;
+
+        // Every field in one snapshot
+        OctaveSnapshot snapshot;
+        start = micros();
+        uint8_t result = octave.ReadSnapshot(&snapshot);
+        double snapshotMillis = (micros() - start) / 1000.0;
+        if (result != 0 || snapshot.forwardVolume != 100.0 * MODBUS_SLAVE_ADDRESS) {
+            printf("Snapshot error %u\n", result);
+            errors++;
+        }
+
+        // Clock synchronization: read the clock, then set it
+        // With one request per register, then with ReadClock and WriteClock
+        int16_t value;
+        start = micros();
+        octave.ReadWeekday(&value);
+        octave.ReadDay(&value);
+        octave.ReadMonth(&value);
+        octave.ReadYear(&value);
+        octave.ReadHours(&value);
+        octave.ReadMinutes(&value);
+        octave.WriteWeekday(7);
+        octave.WriteDay(31);
+        octave.WriteMonth(12);
+        octave.WriteYear(26);
+        octave.WriteHours(23);
+        octave.WriteMinutes(59);
+        double registerSyncMillis = (micros() - start) / 1000.0;
+
+        OctaveDateTime dateTime;
+        start = micros();
+        octave.ReadClock(&dateTime);
+        result = octave.WriteClock(dateTime);
+        double clockSyncMillis = (micros() - start) / 1000.0;
+        // The clock written register by register must read back, and be written back unchanged
+        const SimulatedOctave &meter = *simulator.Meter(MODBUS_SLAVE_ADDRESS);
+        bool clockMatches = dateTime.weekday == 7 && dateTime.day == 31 && dateTime.month == 12 && dateTime.year == 26
+                         && dateTime.hours == 23 && dateTime.minutes == 59 && meter.inputRegisters[0x15] == 23;
+        if (result != 0 || !clockMatches) {
+            printf("Clock error %u\n", result);
+            errors++;
+        }
+
+        // Round-robin over every meter on the bus
+        uint8_t slaveAddresses[NUM_METERS];
+        OctaveSnapshot snapshots[NUM_METERS];
+        uint8_t errorCodes[NUM_METERS];
+        for (uint8_t i = 0; i < NUM_METERS; i++) slaveAddresses[i] = i + 1;
+        MeterBus bus(octave, slaveAddresses, NUM_METERS, snapshots, errorCodes);
+        bus.ResetStats();
+        start = millis();
+        while (millis() - start < MEASURE_MILLIS) bus.Poll();
+        double snapshotsPerSecond = bus.Snapshots() * 1000.0 / (millis() - start);
+        for (uint8_t i = 0; i < NUM_METERS; i++) {
+            if (errorCodes[i] != 0 || snapshots[i].forwardVolume != 100.0 * slaveAddresses[i]) errors++;
+        }
+
+        printf("%-8lu %16.1f %16.1f %20.2f %12.2f %16.1f %16.1f\n", baudrate, gettersMillis, snapshotMillis,
+               snapshotsPerSecond, bus.TransactionsPerSecond(), registerSyncMillis, clockSyncMillis);
+    }
+
+    if (errors > 0) printf("%u errors\n", errors);
+    return errors == 0 ? 0 : 1;
+}
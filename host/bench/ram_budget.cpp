@@ -0,0 +1,118 @@
+// RAM budget of an OctaveModbusWrapper, printed by every build of this target
+// Counts the heap allocated from the constructor to the first reading, which must stay at 0,
+// and splits the size of the object between the Modbus master and the optional features
+// Sizes are those of the host build, with 64-bit pointers and padding, the AVR and ESP32 ones are smaller
+// The AVR layout, without padding, is checked by static_asserts in src/Arduino/OctaveModbusWrapper.cpp instead,
+// since there is no AVR toolchain in the host build
+
+#include <Arduino.h>
+#include <new>
+#include "OctaveModbusWrapper.h"
+#include "../sim/OctaveSlaveSimulator.h"
+
+// Heap allocated while counting
+static bool counting = false;
+static size_t heapAllocations = 0;
+static size_t heapBytes = 0;
+
+void *operator new(size_t size) {
+    if (counting) {
+        heapAllocations++;
+        heapBytes += size;
+    }
+    void *pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept { free(pointer); }
+void operator delete(void *pointer, size_t) noexcept { free(pointer); }
+
+// Bytes of the name of each code, error and field, all of them in constant tables
+static size_t NameTableBytes() {
+    size_t bytes = 0;
+    for (uint8_t kind = 0; kind <= static_cast<uint8_t>(OctaveDecodeKind::Write); kind++) {
+        for (int16_t code = 0; code < 16; code++) {
+            const char *name = OctaveModbusWrapper::CodeToName(static_cast<OctaveDecodeKind>(kind), code);
+            if (OctaveModbusWrapper::NameToCode(static_cast<OctaveDecodeKind>(kind), name) == code) bytes += strlen(name) + 1;
+        }
+    }
+    for (uint8_t errorCode = 0; strcmp(OctaveModbusWrapper::ErrorName(errorCode), "Unknown") != 0; errorCode++) {
+        bytes += strlen(OctaveModbusWrapper::ErrorName(errorCode)) + 1;
+    }
+    for (uint8_t i = 0; i < static_cast<uint8_t>(OctaveField::Count); i++) {
+        bytes += strlen(OctaveRegisterMap::Get(static_cast<OctaveField>(i)).name) + 1;
+    }
+    return bytes;
+}
+
+int main() {
+    HardwareSerial port(1);
+    port.begin(9600);
+    OctaveSlaveSimulator simulator(port);
+    simulator.SetLineSettings(9600);
+    simulator.AddMeter(MODBUS_SLAVE_ADDRESS).SetVolumes(1234.5, 0.0);
+
+    // Only the wrapper is counted, the simulator is set up before
+    counting = true;
+    OctaveModbusWrapper *octave = new (malloc(sizeof(OctaveModbusWrapper))) OctaveModbusWrapper(port);
+    octave->begin(9600);
+    double volume = 0.0;
+    uint8_t errorCode = octave->Read<OctaveField::ForwardVolume_double>(&volume);
+    counting = false;
+
+    size_t master = sizeof(ModbusRTUMaster);
+    size_t policies = 3 * sizeof(OctaveRequestPolicy);
+    size_t lastValue = sizeof(OctaveValue);
+#if OCTAVE_BUS_STATS
+    size_t busStats = sizeof(OctaveBusStats);
+#else
+    size_t busStats = 0;
+#endif
+#if OCTAVE_FIELD_CACHE
+    // Same layout as the wrapper's private CacheEntry, one per field
+    struct CacheEntry {
+        OctaveValue value;
+        uint32_t storedMillis;
+        uint32_t ttlMillis;
+        uint8_t slaveAddress;
+        bool valid;
+    };
+    size_t cache = static_cast<uint8_t>(OctaveField::Count) * sizeof(CacheEntry);
+#else
+    size_t cache = 0;
+#endif
+#if OCTAVE_LEGACY_BUFFERS
+    size_t legacyBuffers = 16 * sizeof(int16_t) + sizeof(int32_t) + sizeof(uint32_t) + sizeof(double);
+#else
+    size_t legacyBuffers = 0;
+#endif
+    size_t total = sizeof(OctaveModbusWrapper);
+    size_t state = total - master - policies - lastValue - busStats - cache - legacyBuffers;
+
+    printf("RAM budget of an OctaveModbusWrapper (host sizes)\n");
+    printf("%-46s %6zu B\n", "Modbus master, frame and receive buffers", master);
+    printf("%-46s %6zu B\n", "Request state and line settings", state);
+    printf("%-46s %6zu B\n", "Request policies, current, next and active", policies);
+    printf("%-46s %6zu B\n", "Last decoded value", lastValue);
+    printf("%-46s %6zu B%s\n", "Bus statistics", busStats, busStats > 0 ? ", OCTAVE_BUS_STATS=0 removes it" : "");
+    printf("%-46s %6zu B%s\n", "Field cache", cache, cache > 0 ? ", OCTAVE_FIELD_CACHE=0 removes it" : "");
+    printf("%-46s %6zu B\n", "Legacy buffers", legacyBuffers);
+    printf("%-46s %6zu B\n", "Total, sizeof(OctaveModbusWrapper)", total);
+    printf("%-46s %6zu B in %zu allocations\n", "Heap, from the constructor to the first read", heapBytes, heapAllocations);
+    printf("%-46s %6zu B, constant, no RAM copy\n", "Code, error and field names", NameTableBytes());
+
+    octave->~OctaveModbusWrapper();
+    free(octave);
+
+    if (errorCode != 0 || volume != 1234.5) {
+        printf("First reading failed, error code %u\n", errorCode);
+        return 1;
+    }
+    // The wrapper must not allocate, so it can't fragment the heap of a small MCU
+    if (heapAllocations > 0) {
+        printf("The wrapper allocated from the heap\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,187 @@
+// Blocking reads on a noisy bus with several request policies: how many reads still fail
+// and how long a read takes on average, in simulated bus time, with the retries read from BusStats()
+// Then a meter that doesn't answer, to check that reads are retried but SystemReset is sent once,
+// and that a retry the master refuses is counted as busy and not as a response
+// Last, that the automatic inter-frame gap is the full 3.5 characters at 300 baud, where it is over 65535 us
+
+#include <Arduino.h>
+#include "OctaveModbusWrapper.h"
+#include "../sim/OctaveSlaveSimulator.h"
+
+#define BAUDRATE 9600
+#define NUM_READS 5000
+#define SLOW_BAUDRATE 300
+
+struct Policy {
+    const char *name;
+    uint16_t responseTimeoutMillis;
+    uint8_t retries;
+    uint16_t backoffMillis;
+};
+
+static const Policy policies[] = {
+    {"1000 ms, no retries", 1000, 0, 0},
+    {"1000 ms, 2 retries", 1000, 2, 50},
+    {"200 ms, 2 retries", 200, 2, 50},
+    {"100 ms, 4 retries", 100, 4, 20},
+};
+
+static void Measure(const Policy &policy) {
+    HostClock::Reset();
+    HardwareSerial port(1);
+    port.begin(BAUDRATE);
+    OctaveSlaveSimulator simulator(port);
+    simulator.SetLineSettings(BAUDRATE);
+    simulator.SetLatency(5000, 20000);
+    // 10% of the responses are lost or corrupted
+    simulator.SetErrorRates(0.05, 0.05, 0.0);
+    simulator.AddMeter(MODBUS_SLAVE_ADDRESS);
+
+    OctaveModbusWrapper octave(port);
+    octave.begin(BAUDRATE);
+    OctaveRequestPolicy requestPolicy;
+    requestPolicy.responseTimeoutMillis = policy.responseTimeoutMillis;
+    requestPolicy.retries = policy.retries;
+    requestPolicy.backoffMillis = policy.backoffMillis;
+    octave.SetRequestPolicy(requestPolicy);
+
+    uint32_t failed = 0;
+    unsigned long start = millis();
+    for (uint32_t i = 0; i < NUM_READS; i++) {
+        double volume;
+        if (octave.ForwardVolume_double(&volume) != 0) failed++;
+    }
+    unsigned long elapsedMillis = millis() - start;
+
+    OctaveBusStats stats;
+    octave.BusStats(&stats);
+    printf("%-22s %8u %9.2f%% %12.1f %10u %10u %10u\n", policy.name, failed, 100.0 * failed / NUM_READS,
+           (double)elapsedMillis / NUM_READS, stats.requests, stats.timeouts, stats.retries);
+}
+
+// Requests sent to a meter that doesn't answer, for a read and for SystemReset
+static bool CheckNonIdempotent() {
+    HostClock::Reset();
+    HardwareSerial port(1);
+    port.begin(BAUDRATE);
+    OctaveSlaveSimulator simulator(port);
+    simulator.SetLineSettings(BAUDRATE);
+    simulator.AddMeter(MODBUS_SLAVE_ADDRESS);
+
+    // No meter at this address
+    OctaveModbusWrapper octave(port, MODBUS_SLAVE_ADDRESS + 1);
+    octave.begin(BAUDRATE);
+    OctaveRequestPolicy policy;
+    policy.responseTimeoutMillis = 100;
+    policy.retries = 3;
+    octave.SetRequestPolicy(policy);
+
+    OctaveBusStats stats;
+    int16_t alarms;
+    uint8_t readResult = octave.ReadAlarms(&alarms);
+    octave.BusStats(&stats);
+    uint32_t readRequests = stats.requests;
+
+    octave.ResetBusStats();
+    uint8_t resetResult = octave.SystemReset();
+    octave.BusStats(&stats);
+    uint32_t resetRequests = stats.requests;
+
+    // A longer timeout for one read only
+    octave.ResetBusStats();
+    OctaveRequestPolicy once = policy;
+    once.retries = 0;
+    octave.SetNextRequestPolicy(once);
+    octave.ReadAlarms(&alarms);
+    octave.ReadAlarms(&alarms);
+    octave.BusStats(&stats);
+    uint32_t oneShotRequests = stats.requests;
+
+    printf("\nMeter not answering, %u retries: ReadAlarms sent %u times (error %u), SystemReset sent %u times (error %u)\n",
+           policy.retries, readRequests, readResult, resetRequests, resetResult);
+    printf("Next request policy without retries, then the instance's: %u requests\n", oneShotRequests);
+    return readRequests == 1u + policy.retries && resetRequests == 1 && oneShotRequests == 2u + policy.retries;
+}
+
+// A read that times out, then whose retry the master refuses
+static bool CheckRefusedRetry() {
+    HostClock::Reset();
+    HardwareSerial port(1);
+    port.begin(BAUDRATE);
+    OctaveSlaveSimulator simulator(port);
+    simulator.SetLineSettings(BAUDRATE);
+    simulator.AddMeter(MODBUS_SLAVE_ADDRESS);
+
+    // No meter at this address
+    OctaveModbusWrapper octave(port, MODBUS_SLAVE_ADDRESS + 1);
+    octave.begin(BAUDRATE);
+    OctaveRequestPolicy policy;
+    policy.responseTimeoutMillis = 100;
+    policy.retries = 1;
+    octave.SetRequestPolicy(policy);
+
+    uint8_t started = octave.StartRead(OctaveField::ReadAlarms);
+    // The first attempt is on the bus, the retry will be refused
+    ModbusRTUMaster::RefuseRequests(1);
+    while (octave.Poll() == OctaveRequestStatus::Pending) delay(1);
+    uint8_t result = octave.LastErrorCode();
+
+    OctaveBusStats stats;
+    octave.BusStats(&stats);
+    uint32_t exceptions = stats.exceptions[0] + stats.exceptions[1] + stats.exceptions[2] + stats.exceptions[3];
+    uint32_t responses = 0;
+    for (uint8_t i = 0; i < OCTAVE_STATS_FUNCTION_CODES; i++) responses += stats.latency[i].responses;
+
+    printf("Retry refused by the master: error %u, %u requests, %u timeouts, %u retries, %u busy, %u exceptions, "
+           "%u bytes received, %u latency samples\n", result, stats.requests, stats.timeouts, stats.retries,
+           stats.busyRejections, exceptions, stats.bytesReceived, responses);
+    return started == 0 && result == 5 && stats.requests == 1 && stats.timeouts == 1 && stats.retries == 1
+        && stats.busyRejections == 1 && exceptions == 0 && stats.bytesReceived == 0 && responses == 0;
+}
+
+// Time of a read of ReadAlarms at SLOW_BAUDRATE, in us, after idling for idleMillis
+static uint32_t SlowReadMicros(OctaveModbusWrapper &octave, uint32_t idleMillis) {
+    delay(idleMillis);
+    unsigned long start = micros();
+    uint8_t result = octave.BlockingRead(OctaveField::ReadAlarms);
+    return result == 0 ? micros() - start : 0;
+}
+
+// A read right after another waits for the whole automatic gap, one after a long idle doesn't wait
+static bool CheckSlowBaudGap() {
+    HostClock::Reset();
+    HardwareSerial port(1);
+    port.begin(SLOW_BAUDRATE);
+    OctaveSlaveSimulator simulator(port);
+    simulator.SetLineSettings(SLOW_BAUDRATE);
+    simulator.SetLatency(0);
+    simulator.AddMeter(MODBUS_SLAVE_ADDRESS);
+
+    OctaveModbusWrapper octave(port);
+    octave.begin(SLOW_BAUDRATE);
+    OctaveRequestPolicy policy;
+    policy.responseTimeoutMillis = 2000;
+    octave.SetRequestPolicy(policy);
+
+    SlowReadMicros(octave, 0);
+    uint32_t backToBack = SlowReadMicros(octave, 0);
+    uint32_t afterIdle = SlowReadMicros(octave, 1000);
+    int32_t gapMicros = static_cast<int32_t>(backToBack - afterIdle);
+    int32_t expectedMicros = 38500000L / SLOW_BAUDRATE;
+
+    printf("Inter-frame gap at %u baud: %.1f ms, 3.5 characters are %.1f ms\n", SLOW_BAUDRATE, gapMicros / 1000.0,
+           expectedMicros / 1000.0);
+    return backToBack != 0 && afterIdle != 0 && gapMicros >= expectedMicros - 100 && gapMicros <= expectedMicros + 100;
+}
+
+int main() {
+    printf("%u blocking reads at %u baud, 10%% of the responses lost\n", NUM_READS, BAUDRATE);
+    printf("%-22s %8s %10s %12s %10s %10s %10s\n", "policy", "failed", "failed %", "ms/read", "requests", "timeouts", "retries");
+    for (const Policy &policy : policies) Measure(policy);
+
+    bool ok = CheckNonIdempotent();
+    ok = CheckRefusedRetry() && ok;
+    ok = CheckSlowBaudGap() && ok;
+    printf("%s\n", ok ? "OK" : "ERROR");
+    return ok ? 0 : 1;
+}
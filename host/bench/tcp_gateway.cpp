@@ -0,0 +1,260 @@
+// Upstream Modbus TCP reads served by a ModbusTcpGateway on loopback, against the load on a 2400 baud bus
+// Two simulated meters are mirrored by the gateway, polled from the main thread, while 1 to 4 client
+// threads read all input registers of a meter as fast as they can over TCP and check every register
+// The bus carries the same snapshot reads whatever the number of clients. Without the mirror, every
+// upstream read would be a bus read, so the bus snapshot rate is the most a pass-through gateway could serve
+// Upstream reads are in wall-clock time, the bus in simulated time
+// Then one client checks the exceptions, and requests split over segments or sent back to back
+
+#include <Arduino.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "ModbusTcpGateway.h"
+#include "../sim/OctaveSlaveSimulator.h"
+
+#define BAUDRATE 2400
+#define NUM_METERS 2
+#define FIRST_PORT 15020
+// Wall-clock time each number of clients runs for
+#define RUN_MILLIS 500
+// Time spent in the rest of loop() between two calls to Poll()
+#define LOOP_MICROS 200
+
+static const uint8_t slaveAddresses[NUM_METERS] = {1, 2};
+// Expected input registers of each meter
+static uint16_t expected[NUM_METERS][SNAPSHOT_NUM_REGISTERS];
+static uint16_t port;
+
+// Blocking loopback connection of an upstream client
+class TcpClient {
+    public:
+        TcpClient() {
+            _fd = socket(AF_INET, SOCK_STREAM, 0);
+            int one = 1;
+            setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            timeval timeout = {2, 0};
+            setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = htons(port);
+            _connected = connect(_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+        }
+        ~TcpClient() { close(_fd); }
+
+        bool Connected() const { return _connected; }
+        bool Send(const uint8_t *bytes, size_t length) { return send(_fd, bytes, length, MSG_NOSIGNAL) == (ssize_t)length; }
+
+        // Receive one response frame, returns its length or 0
+        size_t Receive(uint8_t *frame) {
+            if (!ReceiveAll(frame, 6)) return 0;
+            size_t length = 6 + ((frame[4] << 8) | frame[5]);
+            if (length > MODBUS_TCP_MAX_FRAME_BYTES || !ReceiveAll(frame + 6, length - 6)) return 0;
+            return length;
+        }
+
+    private:
+        int _fd;
+        bool _connected;
+
+        bool ReceiveAll(uint8_t *bytes, size_t length) {
+            while (length > 0) {
+                ssize_t received = recv(_fd, bytes, length, 0);
+                if (received <= 0) return false;
+                bytes += received;
+                length -= received;
+            }
+            return true;
+        }
+};
+
+// Read Input Registers request
+static size_t Request(uint8_t *frame, uint16_t transaction, uint8_t unitId, uint16_t startAddress, uint16_t numRegisters,
+                      uint8_t functionCode = 0x04) {
+    const uint8_t request[] = {(uint8_t)(transaction >> 8), (uint8_t)transaction, 0, 0, 0, 6, unitId, functionCode,
+                               (uint8_t)(startAddress >> 8), (uint8_t)startAddress, (uint8_t)(numRegisters >> 8),
+                               (uint8_t)numRegisters};
+    memcpy(frame, request, sizeof(request));
+    return sizeof(request);
+}
+
+// Whether a response is the registers of a meter, or the exception expected
+static bool Check(const uint8_t *response, size_t length, uint16_t transaction, uint8_t meter, uint16_t startAddress,
+                  uint16_t numRegisters, uint8_t exceptionCode = 0) {
+    if (length < 9 || ((response[0] << 8) | response[1]) != transaction || response[6] != slaveAddresses[meter]) return false;
+    if (exceptionCode != 0) return length == 9 && response[7] == 0x84 && response[8] == exceptionCode;
+    if (length != 9 + 2 * static_cast<size_t>(numRegisters) || response[7] != 0x04 || response[8] != 2 * numRegisters) return false;
+    for (uint16_t i = 0; i < numRegisters; i++) {
+        if (((response[9 + 2 * i] << 8) | response[10 + 2 * i]) != expected[meter][startAddress + i]) return false;
+    }
+    return true;
+}
+
+// Read all input registers of a meter until stopped, counting the reads and the wrong responses
+static void RunClient(uint8_t meter, std::atomic<bool> *running, std::atomic<uint32_t> *reads, std::atomic<uint32_t> *errors) {
+    TcpClient client;
+    if (!client.Connected()) {
+        (*errors)++;
+        return;
+    }
+    uint8_t request[12], response[MODBUS_TCP_MAX_FRAME_BYTES];
+    for (uint16_t transaction = 0; *running; transaction++) {
+        size_t length = Request(request, transaction, slaveAddresses[meter], 0, SNAPSHOT_NUM_REGISTERS);
+        if (!client.Send(request, length)) {
+            (*errors)++;
+            return;
+        }
+        length = client.Receive(response);
+        if (Check(response, length, transaction, meter, 0, SNAPSHOT_NUM_REGISTERS)) (*reads)++;
+        else (*errors)++;
+    }
+}
+
+// Exceptions, requests split over segments and requests sent back to back, returns the number of failed checks
+static uint32_t RunConformance() {
+    TcpClient client;
+    if (!client.Connected()) return 1;
+    uint32_t failed = 0;
+    uint8_t request[3 * 12], response[MODBUS_TCP_MAX_FRAME_BYTES];
+
+    struct Case { uint8_t unitId; uint8_t functionCode; uint16_t startAddress; uint16_t numRegisters; uint8_t exceptionCode; };
+    const Case cases[] = {
+        {1, 0x04, 0x18, 4, 0},
+        {2, 0x04, 0x59, 1, 0},
+        {1, 0x03, 0x00, 1, MODBUS_EXCEPTION_ILLEGAL_FUNCTION},
+        {1, 0x04, 0x58, 4, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS},
+        {1, 0x04, 0x00, 0, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE},
+        {1, 0x04, 0x00, 126, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE},
+        {9, 0x04, 0x00, 1, MODBUS_EXCEPTION_GATEWAY_TARGET_FAILED},
+    };
+    uint16_t transaction = 1000;
+    for (const Case &c : cases) {
+        size_t length = Request(request, transaction, c.unitId, c.startAddress, c.numRegisters, c.functionCode);
+        client.Send(request, length);
+        length = client.Receive(response);
+        uint8_t meter = c.unitId == 2 ? 1 : 0;
+        bool ok;
+        if (c.exceptionCode == 0) ok = Check(response, length, transaction, meter, c.startAddress, c.numRegisters);
+        else ok = length == 9 && response[7] == (c.functionCode | 0x80) && response[8] == c.exceptionCode;
+        if (!ok) {
+            printf("unexpected response to function 0x%02X, unit %u, 0x%02X + %u\n", c.functionCode, c.unitId,
+                   c.startAddress, c.numRegisters);
+            failed++;
+        }
+        transaction++;
+    }
+
+    // One request in two segments
+    size_t length = Request(request, transaction, 1, 0x29, 4);
+    client.Send(request, 5);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    client.Send(request + 5, length - 5);
+    length = client.Receive(response);
+    if (!Check(response, length, transaction, 0, 0x29, 4)) failed++;
+    transaction++;
+
+    // Three requests in one segment, answered in order
+    for (uint8_t i = 0; i < 3; i++) Request(request + 12 * i, transaction + i, slaveAddresses[i % 2], 0x10 * i, 8);
+    client.Send(request, sizeof(request));
+    for (uint8_t i = 0; i < 3; i++) {
+        length = client.Receive(response);
+        if (!Check(response, length, transaction + i, i % 2, 0x10 * i, 8)) failed++;
+    }
+    return failed;
+}
+
+// Poll the gateway from this thread until done
+static void PollUntil(ModbusTcpGateway &gateway, const std::atomic<bool> &done) {
+    while (!done) {
+        gateway.Poll();
+        delayMicroseconds(LOOP_MICROS);
+    }
+}
+
+int main() {
+    HardwareSerial serial(1);
+    serial.begin(BAUDRATE);
+    OctaveSlaveSimulator simulator(serial);
+    simulator.SetLineSettings(BAUDRATE);
+    for (uint8_t i = 0; i < NUM_METERS; i++) {
+        SimulatedOctave &meter = simulator.AddMeter(slaveAddresses[i]);
+        meter.SetVolumes(1000.0 * (i + 1), 2.5);
+        meter.SetFlow(0.25 * (i + 1));
+        memcpy(expected[i], meter.inputRegisters, sizeof(expected[i]));
+    }
+
+    OctaveModbusWrapper octave(serial);
+    octave.begin(BAUDRATE);
+    OctaveSnapshot snapshots[NUM_METERS];
+    uint8_t errorCodes[NUM_METERS];
+    MeterBus bus(octave, slaveAddresses, NUM_METERS, snapshots, errorCodes);
+    RegisterMirror mirrors[NUM_METERS];
+    ModbusTcpGateway gateway(bus, mirrors);
+
+    bool listening = false;
+    for (port = FIRST_PORT; port < FIRST_PORT + 20 && !listening; port++) listening = gateway.begin(port);
+    port--;
+    if (!listening) {
+        printf("No free port from %u\n", FIRST_PORT);
+        return 1;
+    }
+
+    // Wait for the first read of every meter
+    bool mirrored = false;
+    while (!mirrored) {
+        gateway.Poll();
+        delayMicroseconds(LOOP_MICROS);
+        mirrored = true;
+        for (uint8_t i = 0; i < NUM_METERS; i++) mirrored = mirrored && gateway.Mirror(i).valid;
+    }
+
+    printf("%u meters at %u baud, all %u input registers per upstream read\n", NUM_METERS, BAUDRATE, SNAPSHOT_NUM_REGISTERS);
+    printf("%-8s %16s %16s %16s %14s\n", "clients", "upstream reads/s", "bus requests/s", "bus snapshots/s", "wrong answers");
+    uint32_t totalErrors = 0;
+    for (uint8_t numClients = 1; numClients <= MODBUS_TCP_MAX_CLIENTS; numClients *= 2) {
+        std::atomic<bool> running(true), done(false);
+        std::atomic<uint32_t> reads(0), errors(0);
+        bus.ResetStats();
+        uint32_t snapshotsBefore = bus.Snapshots();
+        unsigned long busStartMillis = millis();
+
+        std::thread timer([&]() {
+            std::vector<std::thread> clients;
+            for (uint8_t i = 0; i < numClients; i++) clients.emplace_back(RunClient, i % NUM_METERS, &running, &reads, &errors);
+            std::this_thread::sleep_for(std::chrono::milliseconds(RUN_MILLIS));
+            running = false;
+            for (std::thread &client : clients) client.join();
+            done = true;
+        });
+        auto start = std::chrono::steady_clock::now();
+        PollUntil(gateway, done);
+        timer.join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double busSeconds = (millis() - busStartMillis) / 1000.0;
+
+        printf("%-8u %16.0f %16.2f %16.2f %14u\n", numClients, reads / seconds, bus.TransactionsPerSecond(),
+               (bus.Snapshots() - snapshotsBefore) / busSeconds, (unsigned)errors);
+        totalErrors += errors;
+    }
+
+    std::atomic<bool> done(false);
+    uint32_t failed = 0;
+    std::thread conformance([&]() {
+        failed = RunConformance();
+        done = true;
+    });
+    PollUntil(gateway, done);
+    conformance.join();
+    gateway.end();
+
+    printf("\nConformance: %u checks failed, %u requests answered, %u exceptions\n", failed, gateway.Requests(),
+           gateway.Exceptions());
+    return failed == 0 && totalErrors == 0 ? 0 : 1;
+}
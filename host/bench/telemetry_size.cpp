@@ -0,0 +1,154 @@
+// Size of the binary telemetry records against the text printed by InterpretResult(), for every readable field
+// and for a full snapshot, with the time each one takes on a 9600 baud 8N1 debug UART
+// Every record is decoded back with the host TelemetryReader and compared to the value that was read,
+// then random doubles are encoded and decoded to check that the decimal form is lossless
+
+#include <Arduino.h>
+#include <random>
+#include "OctaveModbusWrapper.h"
+#include "Telemetry.h"
+#include "TelemetryReader.h"
+#include "../sim/OctaveSlaveSimulator.h"
+
+#define DEBUG_BAUDRATE 9600
+#define RANDOM_DOUBLES 1000000
+
+// Other end of the debug UART, counts what is printed to it
+class ByteCounter : public SerialDevice {
+    public:
+        void OnByteReceived(HardwareSerial &, uint8_t, uint64_t) override { bytes++; }
+        uint32_t bytes = 0;
+};
+
+static double UartMillis(uint32_t bytes) {
+    return bytes * 10 * 1000.0 / DEBUG_BAUDRATE;
+}
+
+int main() {
+    HardwareSerial port(1);
+    port.begin(115200);
+    OctaveSlaveSimulator simulator(port);
+    simulator.SetLineSettings(115200);
+    SimulatedOctave &meter = simulator.AddMeter(MODBUS_SLAVE_ADDRESS);
+    meter.SetVolumes(98765.432, 12.3);
+    meter.SetFlow(-0.1);
+
+    HardwareSerial debug(2);
+    debug.begin(DEBUG_BAUDRATE);
+    ByteCounter counter;
+    debug.Attach(&counter);
+
+    OctaveModbusWrapper octave(port);
+    octave.begin(115200);
+
+    uint8_t buffer[256];
+    TelemetryEncoder encoder(buffer, sizeof(buffer));
+    uint32_t textBytes = 0;
+    uint32_t mismatches = 0;
+    uint8_t fields = 0;
+
+    printf("%-24s %8s %8s\n", "field", "text B", "binary B");
+    for (uint8_t i = 0; i < static_cast<uint8_t>(OctaveField::Count); i++) {
+        OctaveField field = static_cast<OctaveField>(i);
+        if (OctaveRegisterMap::Get(field).functionCode != 0x04) continue;
+
+        OctaveValue value;
+        uint8_t errorCode = octave.BlockingReadInto(field, &value);
+        uint32_t before = counter.bytes;
+        octave.InterpretResult(errorCode, debug);
+        uint32_t text = counter.bytes - before;
+        uint16_t start = encoder.Length();
+        octave.EncodeResult(errorCode, encoder);
+        uint16_t binary = encoder.Length() - start;
+
+        TelemetryRecord record;
+        TelemetryReader reader(&buffer[start], binary);
+        if (!reader.Next(&record) || record.field != field || record.errorCode != errorCode
+            || memcmp(&record.value, &value, OctaveRegisterMap::ValueSize(field)) != 0) mismatches++;
+
+        printf("%-24s %8u %8u\n", OctaveRegisterMap::Get(field).name, text, binary);
+        textBytes += text;
+        fields++;
+    }
+    printf("%u fields: %u B of text, %u B of telemetry, %.1fx smaller, %.1f ms vs %.1f ms at %u baud\n", fields,
+           textBytes, encoder.Length(), (double)textBytes / encoder.Length(), UartMillis(textBytes),
+           UartMillis(encoder.Length()), DEBUG_BAUDRATE);
+
+    // Snapshot, against the text of its fields read one by one, without the clock fields already in ReadClock
+    OctaveSnapshot snapshot;
+    octave.ReadSnapshot(&snapshot);
+    encoder.Clear();
+    encoder.Snapshot(MODBUS_SLAVE_ADDRESS, millis(), snapshot);
+    uint32_t snapshotText = 0;
+    const OctaveField clockFields[] = {OctaveField::ReadWeekday, OctaveField::ReadDay, OctaveField::ReadMonth,
+                                       OctaveField::ReadYear, OctaveField::ReadHours, OctaveField::ReadMinutes};
+    for (uint8_t i = 0; i < static_cast<uint8_t>(OctaveField::Count); i++) {
+        OctaveField field = static_cast<OctaveField>(i);
+        bool clockField = false;
+        for (OctaveField clock : clockFields) clockField = clockField || clock == field;
+        // The 32-bit and 64-bit volumes and flow are all in the snapshot
+        if (OctaveRegisterMap::Get(field).functionCode != 0x04 || clockField) continue;
+        OctaveValue value;
+        uint32_t before = counter.bytes;
+        octave.InterpretResult(octave.BlockingReadInto(field, &value), debug);
+        snapshotText += counter.bytes - before;
+    }
+
+    OctaveSnapshot decoded;
+    memset(&decoded, 0, sizeof(decoded));
+    uint8_t slaveAddress;
+    uint32_t timestamp;
+    TelemetryReader snapshotReader(buffer, encoder.Length());
+    bool snapshotOk = snapshotReader.NextSnapshot(&slaveAddress, &timestamp, &decoded)
+                      && memcmp(&decoded, &snapshot, sizeof(snapshot)) == 0 && encoder.Length() <= TELEMETRY_MAX_SNAPSHOT_BYTES;
+    if (!snapshotOk) mismatches++;
+    printf("Snapshot: %u B of text, %u B of telemetry, %.1fx smaller, %.1f ms vs %.1f ms, decoded %s\n", snapshotText,
+           encoder.Length(), (double)snapshotText / encoder.Length(), UartMillis(snapshotText),
+           UartMillis(encoder.Length()), snapshotOk ? "identical" : "DIFFERENT");
+
+    // Reads started from an address are only encoded as the field there if they read that field's values
+    encoder.Clear();
+    uint8_t errorCode = octave.BlockingReadRegisters(0x18, 1, 16);
+    octave.EncodeResult(errorCode, encoder);
+    bool otherShapeSkipped = errorCode == 0 && encoder.Length() == 0;
+    errorCode = octave.BlockingReadRegisters(0x18, 1, -64);
+    octave.EncodeResult(errorCode, encoder);
+    TelemetryRecord addressRecord;
+    TelemetryReader addressReader(buffer, encoder.Length());
+    bool sameShapeEncoded = errorCode == 0 && addressReader.Next(&addressRecord) &&
+                            addressRecord.field == OctaveField::ForwardVolume_double && addressRecord.value.float64 == 98765.432;
+    if (!otherShapeSkipped || !sameShapeEncoded) mismatches++;
+    printf("Reads at 0x18: 1 int16 %s, 1 double %s\n", otherShapeSkipped ? "not encoded" : "ENCODED",
+           sameShapeEncoded ? "encoded as ForwardVolume_double" : "NOT ENCODED");
+
+    // Random doubles: decimals with up to 4 places, some beyond TELEMETRY_MAX_DECIMALS, and random bit patterns
+    std::mt19937_64 random(1);
+    uint32_t decimalForm = 0;
+    uint64_t doubleBytes = 0;
+    for (uint32_t i = 0; i < RANDOM_DOUBLES; i++) {
+        double value;
+        if (i % 4 == 3) {
+            uint64_t bits = random();
+            memcpy(&value, &bits, sizeof(value));
+        }
+        else {
+            static const double scales[] = {1.0, 10.0, 100.0, 1000.0, 10000.0};
+            int64_t digits = static_cast<int64_t>(random() % 2000000000000ULL) - 1000000000000LL;
+            value = static_cast<double>(digits % (1LL << (random() % 40 + 8))) / scales[random() % 5];
+        }
+        encoder.Clear();
+        encoder.Reading(OctaveField::ForwardVolume_double, 0, &value);
+        doubleBytes += encoder.Length();
+        if ((buffer[0] >> 6) == TELEMETRY_FORM_VALUE) decimalForm++;
+
+        TelemetryRecord record;
+        TelemetryReader reader(buffer, encoder.Length());
+        // Compare the bits, so NaN and -0 must come back identical too
+        if (!reader.Next(&record) || memcmp(&record.value.float64, &value, sizeof(value)) != 0) mismatches++;
+    }
+    printf("%u random doubles: %.1f%% in decimal form, %.2f B per record\n", RANDOM_DOUBLES,
+           100.0 * decimalForm / RANDOM_DOUBLES, (double)doubleBytes / RANDOM_DOUBLES);
+
+    printf("%s: %u mismatches\n", mismatches == 0 ? "OK" : "ERROR", mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
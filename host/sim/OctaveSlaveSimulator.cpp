@@ -0,0 +1,310 @@
+#include "OctaveSlaveSimulator.h"
+#include "../IndustrialShields/ModbusRTUMaster.h"
+
+/****** Simulated meter ******/
+SimulatedOctave::SimulatedOctave(uint8_t slaveAddress) : _slaveAddress(slaveAddress) {
+    memset(inputRegisters, 0, sizeof(inputRegisters));
+
+    SetSerialNumber("0000000012345678");
+    // Clock: Wednesday 17/10/26 12:00
+    inputRegisters[0x11] = 3;
+    inputRegisters[0x12] = 17;
+    inputRegisters[0x13] = 10;
+    inputRegisters[0x14] = 26;
+    inputRegisters[0x15] = 12;
+    inputRegisters[0x16] = 0;
+    // Cubic meters, 1x resolution, cubic meters per hour, 22 Celsius
+    inputRegisters[0x17] = 0;
+    inputRegisters[0x28] = 4;
+    inputRegisters[0x31] = 4;
+    inputRegisters[0x32] = 0;
+    inputRegisters[0x34] = 22;
+    inputRegisters[0x35] = 1;
+
+    SetVolumes(1234.56, 1.5);
+    SetFlow(3.25);
+}
+
+void SimulatedOctave::SetUInt32(uint8_t address, uint32_t value) {
+    // AB CD
+    inputRegisters[address] = value >> 16;
+    inputRegisters[address + 1] = value & 0xFFFF;
+}
+
+uint32_t SimulatedOctave::GetUInt32(uint8_t address) const {
+    return (static_cast<uint32_t>(inputRegisters[address]) << 16) | inputRegisters[address + 1];
+}
+
+void SimulatedOctave::SetDouble(uint8_t address, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    // HG FE DC BA: each register holds two bytes of the value, least significant register first,
+    // with the bytes of each register swapped
+    for (uint8_t i = 0; i < 4; i++) {
+        uint16_t word = (bits >> (16 * i)) & 0xFFFF;
+        inputRegisters[address + i] = static_cast<uint16_t>((word >> 8) | (word << 8));
+    }
+}
+
+double SimulatedOctave::GetDouble(uint8_t address) const {
+    uint64_t bits = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        uint16_t word = inputRegisters[address + i];
+        bits |= static_cast<uint64_t>(static_cast<uint16_t>((word >> 8) | (word << 8))) << (16 * i);
+    }
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void SimulatedOctave::SetSerialNumber(const char *digits) {
+    // Shorter serial numbers are padded with zeros
+    bool ended = false;
+    for (uint8_t i = 0; i < 16; i++) {
+        if (digits[i] == '\0') ended = true;
+        inputRegisters[0x01 + i] = ended ? 0 : digits[i];
+    }
+}
+
+void SimulatedOctave::SetVolumes(double forwardVolume, double reverseVolume) {
+    SetDouble(0x18, forwardVolume);
+    SetDouble(0x20, reverseVolume);
+    SetDouble(0x42, forwardVolume - reverseVolume);
+    SetDouble(0x4A, fabs(forwardVolume - reverseVolume));
+    SetUInt32(0x36, static_cast<uint32_t>(forwardVolume));
+    SetUInt32(0x3A, static_cast<uint32_t>(reverseVolume));
+    SetInt32(0x52, static_cast<int32_t>(forwardVolume - reverseVolume));
+    SetUInt32(0x56, static_cast<uint32_t>(fabs(forwardVolume - reverseVolume)));
+}
+
+void SimulatedOctave::SetFlow(double signedCurrentFlow) {
+    SetDouble(0x29, signedCurrentFlow);
+    SetInt32(0x3E, static_cast<int32_t>(signedCurrentFlow));
+    // No flow, forward flow, backward flow
+    inputRegisters[0x33] = signedCurrentFlow == 0.0 ? 0 : (signedCurrentFlow > 0.0 ? 1 : 2);
+}
+
+// Check a write to a holding register without applying it, returns the Modbus exception code or 0
+uint8_t SimulatedOctave::CheckRegister(uint16_t address, uint16_t value) const {
+    // Valid range of each holding register
+    static const uint16_t minValues[SIM_NUM_HOLDING_REGISTERS] = {1, 1, 1, 1, 14, 0, 0, 0, 0};
+    static const uint16_t maxValues[SIM_NUM_HOLDING_REGISTERS] = {1, 7, 31, 12, 99, 23, 59, 8, 8};
+
+    // Exception 2: Illegal Data Address
+    if (address >= SIM_NUM_HOLDING_REGISTERS) return 2;
+    // Exception 3: Illegal Data Value
+    if (value < minValues[address] || value > maxValues[address]) return 3;
+    return 0;
+}
+
+// Apply a write to a holding register, returns the Modbus exception code or 0
+uint8_t SimulatedOctave::WriteRegister(uint16_t address, uint16_t value) {
+    uint8_t exception = CheckRegister(address, value);
+    if (exception != 0) return exception;
+
+    switch (address) {
+        case 0x0:
+            _resets++;
+            break;
+        case 0x7:
+            inputRegisters[0x28] = value;
+            break;
+        case 0x8:
+            inputRegisters[0x31] = value;
+            break;
+        default:
+            // Clock registers, 0x1 to 0x6 map to 0x11 to 0x16
+            inputRegisters[0x10 + address] = value;
+    }
+    return 0;
+}
+
+
+/****** Simulated bus ******/
+OctaveSlaveSimulator::OctaveSlaveSimulator(HardwareSerial &port) : _port(port) {
+    _port.Attach(this);
+}
+
+SimulatedOctave &OctaveSlaveSimulator::AddMeter(uint8_t slaveAddress) {
+    return _meters.insert(std::make_pair(slaveAddress, SimulatedOctave(slaveAddress))).first->second;
+}
+
+SimulatedOctave *OctaveSlaveSimulator::Meter(uint8_t slaveAddress) {
+    std::map<uint8_t, SimulatedOctave>::iterator meter = _meters.find(slaveAddress);
+    return meter == _meters.end() ? nullptr : &meter->second;
+}
+
+void OctaveSlaveSimulator::SetLineSettings(unsigned long baudrate, uint32_t config) {
+    _baudrate = baudrate;
+    _config = config;
+}
+
+void OctaveSlaveSimulator::SetLatency(uint32_t latencyMicros, uint32_t jitterMicros) {
+    _latencyMicros = latencyMicros;
+    _jitterMicros = jitterMicros;
+}
+
+void OctaveSlaveSimulator::SetErrorRates(double dropRate, double corruptRate, double exceptionRate) {
+    _dropRate = dropRate;
+    _corruptRate = corruptRate;
+    _exceptionRate = exceptionRate;
+}
+
+// Uniform random number in [0, 1), xorshift32
+double OctaveSlaveSimulator::Random() {
+    _randomState ^= _randomState << 13;
+    _randomState ^= _randomState >> 17;
+    _randomState ^= _randomState << 5;
+    return _randomState / 4294967296.0;
+}
+
+void OctaveSlaveSimulator::OnByteReceived(HardwareSerial &port, uint8_t byte, uint64_t endMicros) {
+    // With other line settings, the meters only see garbage
+    if (port.baudRate() != _baudrate || port.config() != _config) return;
+
+    // A silence longer than 3.5 characters starts a new frame
+    if (_requestLength > 0 && endMicros - _lastByteMicros > 4 * port.CharMicros()) _requestLength = 0;
+    _lastByteMicros = endMicros;
+
+    if (_requestLength >= sizeof(_request)) _requestLength = 0;
+    _request[_requestLength++] = byte;
+
+    uint16_t expected = ExpectedLength();
+    if (expected != 0 && _requestLength >= expected) {
+        HandleRequest(endMicros);
+        _requestLength = 0;
+    }
+}
+
+// Length of the request in the buffer, known once its header is received, 0 until then
+uint16_t OctaveSlaveSimulator::ExpectedLength() const {
+    if (_requestLength < 2) return 0;
+    // Write Multiple Registers: address, quantity, byte count, data, CRC
+    if (_request[1] == 0x10) {
+        if (_requestLength < 7) return 0;
+        return 9 + _request[6];
+    }
+    // Every other function: slave, function code, 4 bytes, CRC
+    return 8;
+}
+
+// Answer a complete request that ended at endMicros
+void OctaveSlaveSimulator::HandleRequest(uint64_t endMicros) {
+    uint16_t length = ExpectedLength();
+    uint16_t crc = ModbusCRC(_request, length - 2);
+    // Corrupted requests are ignored
+    if (_request[length - 2] != (crc & 0xFF) || _request[length - 1] != (crc >> 8)) return;
+
+    _requestsReceived++;
+    uint8_t slaveAddress = _request[0];
+
+    // Broadcasts are applied to every meter, without a response
+    if (slaveAddress == 0) {
+        uint8_t response[256];
+        for (std::map<uint8_t, SimulatedOctave>::iterator meter = _meters.begin(); meter != _meters.end(); ++meter) {
+            BuildResponse(meter->second, response);
+        }
+        return;
+    }
+
+    SimulatedOctave *meter = Meter(slaveAddress);
+    if (meter == nullptr) return;
+
+    uint8_t response[256];
+    uint16_t responseLength = BuildResponse(*meter, response);
+
+    // Injected errors
+    if (Random() < _dropRate) {
+        _errorsInjected++;
+        return;
+    }
+    if (Random() < _exceptionRate) {
+        _errorsInjected++;
+        // Exception 4: Server Device Failure
+        response[1] = _request[1] | 0x80;
+        response[2] = 4;
+        responseLength = 3;
+    }
+
+    SendResponse(response, responseLength, endMicros);
+}
+
+// Value i of a Write Multiple Registers request
+uint16_t OctaveSlaveSimulator::RequestValue(uint16_t i) const {
+    return (static_cast<uint16_t>(_request[7 + 2 * i]) << 8) | _request[8 + 2 * i];
+}
+
+// Build the response of a meter, returns its length without the CRC
+uint16_t OctaveSlaveSimulator::BuildResponse(SimulatedOctave &meter, uint8_t *response) {
+    uint8_t functionCode = _request[1];
+    uint16_t address = (static_cast<uint16_t>(_request[2]) << 8) | _request[3];
+    uint16_t quantity = (static_cast<uint16_t>(_request[4]) << 8) | _request[5];
+    uint8_t exception = 0;
+
+    response[0] = meter.SlaveAddress();
+    response[1] = functionCode;
+
+    switch (functionCode) {
+        case 0x04:
+            // Exception 3: Illegal Data Value, 2: Illegal Data Address
+            if (quantity == 0 || quantity > SIM_MAX_READ_REGISTERS) exception = 3;
+            else if (address + quantity > SIM_NUM_INPUT_REGISTERS) exception = 2;
+            else {
+                response[2] = 2 * quantity;
+                for (uint16_t i = 0; i < quantity; i++) {
+                    response[3 + 2 * i] = meter.inputRegisters[address + i] >> 8;
+                    response[4 + 2 * i] = meter.inputRegisters[address + i] & 0xFF;
+                }
+                return 3 + 2 * quantity;
+            }
+            break;
+        case 0x06:
+            // quantity holds the value of Write Single Register
+            exception = meter.WriteRegister(address, quantity);
+            if (exception == 0) {
+                // Echo the request
+                memcpy(response, _request, 6);
+                return 6;
+            }
+            break;
+        case 0x10:
+            // Exception 3: Illegal Data Value, 2: Illegal Data Address
+            if (quantity == 0 || quantity > SIM_MAX_WRITE_REGISTERS || _request[6] != 2 * quantity) exception = 3;
+            else if (address + quantity > SIM_NUM_HOLDING_REGISTERS) exception = 2;
+            else {
+                // Check every value before applying any, so a rejected request changes nothing
+                for (uint16_t i = 0; i < quantity && exception == 0; i++) {
+                    exception = meter.CheckRegister(address + i, RequestValue(i));
+                }
+                if (exception == 0) {
+                    for (uint16_t i = 0; i < quantity; i++) meter.WriteRegister(address + i, RequestValue(i));
+                    // Echo the address and quantity
+                    memcpy(response, _request, 6);
+                    return 6;
+                }
+            }
+            break;
+        default:
+            // Exception 1: Illegal Function
+            exception = 1;
+    }
+
+    response[1] = functionCode | 0x80;
+    response[2] = exception;
+    return 3;
+}
+
+void OctaveSlaveSimulator::SendResponse(uint8_t *response, uint16_t length, uint64_t requestEndMicros) {
+    uint16_t crc = ModbusCRC(response, length);
+    response[length] = crc & 0xFF;
+    response[length + 1] = crc >> 8;
+
+    if (Random() < _corruptRate) {
+        _errorsInjected++;
+        response[length + 1] ^= 0xFF;
+    }
+
+    uint64_t jitter = _jitterMicros > 0 ? static_cast<uint64_t>(Random() * _jitterMicros) : 0;
+    _port.Deliver(response, length + 2, requestEndMicros + _latencyMicros + jitter);
+    _responsesSent++;
+}
@@ -0,0 +1,112 @@
+#ifndef __OctaveSlaveSimulator_H__
+#define __OctaveSlaveSimulator_H__
+
+#include <Arduino.h>
+#include <map>
+
+// Number of input registers implemented by the meter, 0x00 to 0x59
+#define SIM_NUM_INPUT_REGISTERS 0x5A
+// Number of holding registers implemented by the meter, 0x0 to 0x8
+#define SIM_NUM_HOLDING_REGISTERS 0x9
+// Maximum number of registers per read request, according to the Modbus specification
+#define SIM_MAX_READ_REGISTERS 125
+// Maximum number of registers per Write Multiple Registers request
+#define SIM_MAX_WRITE_REGISTERS 123
+
+// Memory map of one simulated Arad Octave meter
+// Values are stored with the byte orders of the memory map: AB CD for 32-bit and HG FE DC BA for 64-bit values
+class SimulatedOctave {
+    public:
+        explicit SimulatedOctave(uint8_t slaveAddress);
+
+        uint8_t SlaveAddress() const { return _slaveAddress; }
+
+        // Input registers, as read with function code 04
+        uint16_t inputRegisters[SIM_NUM_INPUT_REGISTERS];
+
+        void SetUInt32(uint8_t address, uint32_t value);
+        void SetInt32(uint8_t address, int32_t value) { SetUInt32(address, static_cast<uint32_t>(value)); }
+        void SetDouble(uint8_t address, double value);
+        uint32_t GetUInt32(uint8_t address) const;
+        double GetDouble(uint8_t address) const;
+        // Serial number digits, one ASCII character per register
+        void SetSerialNumber(const char *digits);
+        // Update the 32- and 64-bit versions of the volumes and flow together
+        void SetVolumes(double forwardVolume, double reverseVolume);
+        void SetFlow(double signedCurrentFlow);
+
+        // Check a write to a holding register without applying it, returns the Modbus exception code or 0
+        uint8_t CheckRegister(uint16_t address, uint16_t value) const;
+        // Apply a write to a holding register, returns the Modbus exception code or 0
+        uint8_t WriteRegister(uint16_t address, uint16_t value);
+        // Number of SystemReset requests received
+        uint32_t Resets() const { return _resets; }
+
+    private:
+        uint8_t _slaveAddress;
+        uint32_t _resets = 0;
+};
+
+// In-process Modbus RTU bus with one or more simulated Octave meters, attached to a host HardwareSerial
+// Implements Read Input Registers (04) and Write Single Register (06), models the line time of the
+// configured baud rate, the response latency of the meters, and injected transmission errors
+class OctaveSlaveSimulator : public SerialDevice {
+    public:
+        explicit OctaveSlaveSimulator(HardwareSerial &port);
+
+        // Add a meter to the bus, or get the one with that address
+        SimulatedOctave &AddMeter(uint8_t slaveAddress);
+        SimulatedOctave *Meter(uint8_t slaveAddress);
+
+        // Line settings configured in the meters, frames sent with other settings are not understood
+        void SetLineSettings(unsigned long baudrate, uint32_t config = SERIAL_8N1);
+        // Time between the end of a request and the start of its response, plus a random jitter
+        void SetLatency(uint32_t latencyMicros, uint32_t jitterMicros = 0);
+        // Probabilities, from 0 to 1, of dropping a response, corrupting its CRC,
+        // or answering with a Server Device Failure exception
+        void SetErrorRates(double dropRate, double corruptRate, double exceptionRate);
+        void SetSeed(uint32_t seed) { _randomState = seed != 0 ? seed : 1; }
+
+        /****** Counters ******/
+        uint32_t RequestsReceived() const { return _requestsReceived; }
+        uint32_t ResponsesSent() const { return _responsesSent; }
+        uint32_t ErrorsInjected() const { return _errorsInjected; }
+
+        void OnByteReceived(HardwareSerial &port, uint8_t byte, uint64_t endMicros) override;
+
+    private:
+        HardwareSerial &_port;
+        std::map<uint8_t, SimulatedOctave> _meters;
+
+        unsigned long _baudrate = 2400;
+        uint32_t _config = SERIAL_8N1;
+        uint32_t _latencyMicros = 5000;
+        uint32_t _jitterMicros = 0;
+        double _dropRate = 0.0;
+        double _corruptRate = 0.0;
+        double _exceptionRate = 0.0;
+        uint32_t _randomState = 1;
+
+        // Request being received
+        uint8_t _request[256];
+        uint16_t _requestLength = 0;
+        uint64_t _lastByteMicros = 0;
+
+        uint32_t _requestsReceived = 0;
+        uint32_t _responsesSent = 0;
+        uint32_t _errorsInjected = 0;
+
+        // Length of the request in the buffer, known once its header is received, 0 until then
+        uint16_t ExpectedLength() const;
+        // Answer a complete request that ended at endMicros
+        void HandleRequest(uint64_t endMicros);
+        // Value i of a Write Multiple Registers request
+        uint16_t RequestValue(uint16_t i) const;
+        // Build the response of a meter, returns its length without the CRC
+        uint16_t BuildResponse(SimulatedOctave &meter, uint8_t *response);
+        void SendResponse(uint8_t *response, uint16_t length, uint64_t requestEndMicros);
+        // Uniform random number in [0, 1)
+        double Random();
+};
+
+#endif
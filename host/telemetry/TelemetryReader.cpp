@@ -0,0 +1,159 @@
+#include "TelemetryReader.h"
+#include "Varint.h"
+#include <string.h>
+
+bool TelemetryReader::ReadVarint(uint64_t &value) {
+    uint8_t length = ::ReadVarint(&_bytes[_position], _length - _position, value);
+    _position += length;
+    return length > 0;
+}
+
+bool TelemetryReader::Next(TelemetryRecord *record) {
+    if (!_valid || _position >= _length) return false;
+
+    uint8_t tag = _bytes[_position++];
+    uint8_t index = tag & TELEMETRY_INDEX_MASK;
+    record->form = tag >> 6;
+    uint64_t number;
+
+    if (record->form == TELEMETRY_FORM_HEADER) {
+        if ((index != TELEMETRY_HEADER_METER && index != TELEMETRY_HEADER_SUMMARY) || _position >= _length) return Fail();
+        record->header = index;
+        record->slaveAddress = _bytes[_position++];
+        if (!ReadVarint(number)) return Fail();
+        record->millis = static_cast<uint32_t>(number);
+        if (index == TELEMETRY_HEADER_SUMMARY) return ReadSummary(record);
+        return true;
+    }
+
+    if (index >= static_cast<uint8_t>(OctaveField::Count)) return Fail();
+    record->field = static_cast<OctaveField>(index);
+    record->errorCode = 0;
+    memset(&record->value, 0, sizeof(record->value));
+
+    if (record->form == TELEMETRY_FORM_ERROR) {
+        if (_position >= _length) return Fail();
+        record->errorCode = _bytes[_position++];
+        return true;
+    }
+
+    OctaveDecodeKind kind = OctaveRegisterMap::Get(record->field).kind;
+    if (record->form == TELEMETRY_FORM_RAW) {
+        if (kind != OctaveDecodeKind::Double || _length - _position < 8) return Fail();
+        uint64_t bits = 0;
+        for (uint8_t i = 0; i < 8; i++) bits |= static_cast<uint64_t>(_bytes[_position++]) << (8 * i);
+        memcpy(&record->value.float64, &bits, sizeof(bits));
+        return true;
+    }
+
+    switch (kind) {
+        case OctaveDecodeKind::SerialNumber:
+            if (_length - _position < 8) return Fail();
+            for (uint8_t i = 0; i < 8; i++) {
+                uint8_t digits = _bytes[_position++];
+                // Registers that weren't digits are read back as 0
+                record->value.int16[2 * i] = (digits >> 4) == 0xF ? 0 : '0' + (digits >> 4);
+                record->value.int16[2 * i + 1] = (digits & 0xF) == 0xF ? 0 : '0' + (digits & 0xF);
+            }
+            return true;
+        case OctaveDecodeKind::Clock:
+            for (uint8_t i = 0; i < 6; i++) {
+                if (!ReadVarint(number)) return Fail();
+                record->value.int16[i] = static_cast<int16_t>(ZigzagDecode(number));
+            }
+            return true;
+        case OctaveDecodeKind::UInt32:
+            if (!ReadVarint(number)) return Fail();
+            record->value.uint32 = static_cast<uint32_t>(number);
+            return true;
+        case OctaveDecodeKind::Int32:
+            if (!ReadVarint(number)) return Fail();
+            record->value.int32 = static_cast<int32_t>(ZigzagDecode(number));
+            return true;
+        case OctaveDecodeKind::Double: {
+            static const double powersOf10[TELEMETRY_MAX_DECIMALS + 1] = {1.0, 10.0, 100.0, 1000.0};
+            if (!ReadVarint(number)) return Fail();
+            // k converts exactly, so the division gives back the encoded double
+            int64_t k = ZigzagDecode(number >> 2);
+            record->value.float64 = static_cast<double>(k) / powersOf10[number & 0x3];
+            return true;
+        }
+        case OctaveDecodeKind::Write:
+            return true;
+        default:
+            if (!ReadVarint(number)) return Fail();
+            record->value.int16[0] = static_cast<int16_t>(ZigzagDecode(number));
+            return true;
+    }
+}
+
+bool TelemetryReader::ReadSummary(TelemetryRecord *record) {
+    ConsumptionSummary &summary = record->summary;
+    uint64_t numbers[9];
+    // Duration, volumes, sample counts, flows and variance
+    for (uint8_t i = 0; i < 9; i++) {
+        if (!ReadVarint(numbers[i])) return Fail();
+    }
+    summary.slaveAddress = record->slaveAddress;
+    summary.startMillis = record->millis;
+    summary.durationMillis = static_cast<uint32_t>(numbers[0]);
+    summary.forwardVolume = ZigzagDecode(numbers[1]);
+    summary.reverseVolume = ZigzagDecode(numbers[2]);
+    summary.flowSamples = static_cast<uint32_t>(numbers[3]);
+    summary.reverseFlowSamples = static_cast<uint32_t>(numbers[4]);
+    summary.minFlow = static_cast<int32_t>(ZigzagDecode(numbers[5]));
+    summary.maxFlow = static_cast<int32_t>(ZigzagDecode(numbers[6]));
+    summary.meanFlow = static_cast<int32_t>(ZigzagDecode(numbers[7]));
+    summary.flowVariance = numbers[8];
+    return true;
+}
+
+bool TelemetryReader::NextSnapshot(uint8_t *slaveAddress, uint32_t *millis, OctaveSnapshot *snapshot) {
+    TelemetryRecord record;
+    uint16_t start = _position;
+    if (!Next(&record) || record.form != TELEMETRY_FORM_HEADER || record.header != TELEMETRY_HEADER_METER) {
+        if (_valid) _position = start;
+        return false;
+    }
+    *slaveAddress = record.slaveAddress;
+    *millis = record.millis;
+
+    // Fields up to the next header
+    while (_position < _length && (_bytes[_position] >> 6) != TELEMETRY_FORM_HEADER) {
+        if (!Next(&record)) return false;
+        if (record.form == TELEMETRY_FORM_ERROR) continue;
+
+        const OctaveValue &value = record.value;
+        switch (record.field) {
+            case OctaveField::ReadAlarms: snapshot->alarms = value.int16[0]; break;
+            case OctaveField::SerialNumber: memcpy(snapshot->serialNumber, value.int16, sizeof(snapshot->serialNumber)); break;
+            case OctaveField::ReadClock:
+                snapshot->weekday = value.int16[0];
+                snapshot->day = value.int16[1];
+                snapshot->month = value.int16[2];
+                snapshot->year = value.int16[3];
+                snapshot->hours = value.int16[4];
+                snapshot->minutes = value.int16[5];
+                break;
+            case OctaveField::VolumeUnit: snapshot->volumeUnit = value.int16[0]; break;
+            case OctaveField::ForwardVolume_double: snapshot->forwardVolume = value.float64; break;
+            case OctaveField::ReverseVolume_double: snapshot->reverseVolume = value.float64; break;
+            case OctaveField::ReadVolumeResIndex: snapshot->volumeResIndex = value.int16[0]; break;
+            case OctaveField::SignedCurrentFlow_double: snapshot->signedCurrentFlow = value.float64; break;
+            case OctaveField::ReadFlowResIndex: snapshot->flowResIndex = value.int16[0]; break;
+            case OctaveField::FlowUnit: snapshot->flowUnit = value.int16[0]; break;
+            case OctaveField::FlowDirection: snapshot->flowDirection = value.int16[0]; break;
+            case OctaveField::TemperatureValue: snapshot->temperatureValue = value.int16[0]; break;
+            case OctaveField::TemperatureUnit: snapshot->temperatureUnit = value.int16[0]; break;
+            case OctaveField::ForwardVolume_uint32: snapshot->forwardVolume_uint32 = value.uint32; break;
+            case OctaveField::ReverseVolume_uint32: snapshot->reverseVolume_uint32 = value.uint32; break;
+            case OctaveField::SignedCurrentFlow_int32: snapshot->signedCurrentFlow_int32 = value.int32; break;
+            case OctaveField::NetSignedVolume_double: snapshot->netSignedVolume = value.float64; break;
+            case OctaveField::NetUnsignedVolume_double: snapshot->netUnsignedVolume = value.float64; break;
+            case OctaveField::NetSignedVolume_int32: snapshot->netSignedVolume_int32 = value.int32; break;
+            case OctaveField::NetUnsignedVolume_uint32: snapshot->netUnsignedVolume_uint32 = value.uint32; break;
+            default: break;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef __TelemetryReader_H__
+#define __TelemetryReader_H__
+
+// Host decoder of the telemetry streams written by TelemetryEncoder, i.e. on the receiving end of the debug UART
+
+#include "Telemetry.h"
+#include "ConsumptionAggregator.h"
+
+// One decoded record
+struct TelemetryRecord {
+    uint8_t form;               // TELEMETRY_FORM_*
+    // Field of value and error records
+    OctaveField field;
+    uint8_t errorCode;
+    // Value of the field, in the layout the requests decode it to
+    OctaveValue value;
+    // Header records, TELEMETRY_HEADER_*
+    uint8_t header;
+    uint8_t slaveAddress;
+    uint32_t millis;
+    // Summary headers
+    ConsumptionSummary summary;
+};
+
+class TelemetryReader {
+    public:
+        TelemetryReader(const uint8_t *bytes, uint16_t length) : _bytes(bytes), _length(length) {}
+
+        // Returns false after the last record, or if the stream is truncated or malformed, see Valid()
+        bool Next(TelemetryRecord *record);
+        // False once a malformed or truncated record was found
+        bool Valid() const { return _valid; }
+
+        // Decode a whole snapshot record group, from its header, into a snapshot
+        // Fields missing from the group are left unchanged. Returns false if the next record isn't a header
+        bool NextSnapshot(uint8_t *slaveAddress, uint32_t *millis, OctaveSnapshot *snapshot);
+
+    private:
+        const uint8_t *_bytes;
+        uint16_t _length;
+        uint16_t _position = 0;
+        bool _valid = true;
+
+        // Read a varint at the current position, returns false if it doesn't end within the stream
+        bool ReadVarint(uint64_t &value);
+        // Read the fields of a summary header after its timestamp
+        bool ReadSummary(TelemetryRecord *record);
+        bool Fail() { _valid = false; return false; }
+};
+
+#endif
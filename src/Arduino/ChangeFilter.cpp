@@ -0,0 +1,172 @@
+#include "ChangeFilter.h"
+#include <string.h>
+
+/****** Deadband arithmetic ******/
+// fp64lib operations on the IEEE-754 bits of float64_t
+
+static float64_t Uint32ToReal(uint32_t value){
+  if (value <= 0x7FFFFFFF) return fp64_int32_to_float64(static_cast<int32_t>(value));
+  // value - 2^31, plus 2^31
+  return fp64_add(fp64_int32_to_float64(static_cast<int32_t>(value - 0x80000000UL)),
+                  fp64_neg(fp64_int32_to_float64(INT32_MIN)));
+}
+
+
+// Whether value moved from last by more than absolute, or by more than relative times last
+static bool ExceedsDeadband(float64_t value, float64_t last, float64_t absolute, float64_t relative){
+  if (fp64_isnan(value) || fp64_isnan(last)) return true;
+  float64_t threshold = fp64_mul(relative, fp64_abs(last));
+  if (fp64_compare(threshold, absolute) < 0) threshold = absolute;
+  return fp64_compare(fp64_abs(fp64_sub(value, last)), threshold) > 0;
+}
+
+
+// Value of a field with a deadband, as the bits of a float64_t
+static uint64_t RealValue(OctaveDecodeKind kind, const OctaveValue &value){
+  switch (kind){
+    case OctaveDecodeKind::UInt32: return Uint32ToReal(value.uint32);
+    case OctaveDecodeKind::Int32: return fp64_int32_to_float64(value.int32);
+    case OctaveDecodeKind::Double: return value.float64;
+    default: return fp64_int32_to_float64(value.int16[0]); // Int16
+  }
+}
+
+
+// Whether a field has a deadband, i.e. is a single number
+static bool HasDeadband(OctaveField field){
+  OctaveDecodeKind kind = OctaveRegisterMap::Get(field).kind;
+  return kind == OctaveDecodeKind::Int16 || kind == OctaveDecodeKind::UInt32 ||
+         kind == OctaveDecodeKind::Int32 || kind == OctaveDecodeKind::Double;
+}
+
+
+// FNV-1a hash of the registers of a field without a deadband, any change of the value changes it
+static uint64_t HashValue(OctaveField field, const OctaveValue &value){
+  const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&value);
+  uint32_t hash = 2166136261UL;
+  for (uint8_t i = 0; i < OctaveRegisterMap::ValueSize(field); i++) {
+    hash ^= bytes[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+
+/****** ChangeFilter ******/
+
+bool ChangeFilter::SetDeadband(OctaveField field, double absolute, double relative, uint32_t heartbeatMillis){
+  return SetDeadbandFloat64(field, fp64_sd(absolute), fp64_sd(relative), heartbeatMillis);
+}
+
+
+bool ChangeFilter::SetDeadbandFloat64(OctaveField field, float64_t absolute, float64_t relative, uint32_t heartbeatMillis){
+  if (field >= OctaveField::Count || OctaveRegisterMap::Get(field).functionCode != 0x04) return false;
+
+  int8_t index = Find(field);
+  if (index < 0) index = Add(field);
+  if (index < 0) return false;
+
+  TrackedField &tracked = _fields[index];
+  tracked.absolute = absolute;
+  tracked.relative = relative;
+  tracked.heartbeatMillis = heartbeatMillis;
+  tracked.configured = true;
+  return true;
+}
+
+
+bool ChangeFilter::RemoveDeadband(OctaveField field){
+  int8_t index = Find(field);
+  if (index < 0 || !_fields[index].configured) return false;
+
+  // The order of the fields doesn't matter, move the last one to the gap
+  _fields[index] = _fields[--_numFields];
+  return true;
+}
+
+
+// Forget the last reported readings, so the next reading of every field is reported
+void ChangeFilter::Reset(){
+  for (uint8_t i = 0; i < _numFields; i++) _fields[i].reported = false;
+}
+
+
+// Whether a reading must be reported. If so, it becomes the last reported reading of its field
+bool ChangeFilter::Update(OctaveField field, uint8_t errorCode, const OctaveValue &value, uint32_t nowMillis){
+  _received++;
+
+  int8_t index = Find(field);
+  if (index < 0) index = Add(field);
+  // No room to track it, report every reading
+  if (index < 0) {
+    _reported++;
+    return true;
+  }
+
+  TrackedField &tracked = _fields[index];
+  bool deadband = HasDeadband(field);
+  uint64_t current = 0;
+  if (errorCode == 0) current = deadband ? RealValue(OctaveRegisterMap::Get(field).kind, value) : HashValue(field, value);
+
+  bool report;
+  if (!tracked.reported || errorCode != tracked.lastErrorCode) report = true;
+  else if (tracked.heartbeatMillis != CHANGE_FILTER_NO_HEARTBEAT && nowMillis - tracked.lastMillis >= tracked.heartbeatMillis) report = true;
+  // Repeated errors are only reported by the heartbeat
+  else if (errorCode != 0 || current == tracked.lastValue) report = false;
+  else if (!deadband) report = true;
+  else report = ExceedsDeadband(current, tracked.lastValue, tracked.absolute, tracked.relative);
+
+  if (report) {
+    tracked.lastMillis = nowMillis;
+    tracked.lastErrorCode = errorCode;
+    // Keep the last good value through errors, so the next good one is compared to it
+    if (errorCode == 0) tracked.lastValue = current;
+    tracked.reported = true;
+    _reported++;
+  }
+  return report;
+}
+
+
+void ChangeFilter::SetCallback(OctaveReadCallback callback, void *context){
+  _callback = callback;
+  _callbackContext = context;
+}
+
+
+// OctaveReadCallback to give to the source of readings, with the ChangeFilter as its context
+void ChangeFilter::Forward(OctaveField field, uint8_t errorCode, const OctaveValue &value, void *context){
+  ChangeFilter &self = *static_cast<ChangeFilter*>(context);
+  // A reading of another meter would be compared with this meter's last reported one
+  uint8_t slaveAddress = self._slaveAddress == INSTANCE_SLAVE_ADDRESS ? self._octave.SlaveAddress() : self._slaveAddress;
+  if (self._octave.RequestSlaveAddress() != slaveAddress) return;
+  if (self.Update(field, errorCode, value, millis()) && self._callback != nullptr) {
+    self._callback(field, errorCode, value, self._callbackContext);
+  }
+}
+
+
+int8_t ChangeFilter::Find(OctaveField field) const {
+  for (uint8_t i = 0; i < _numFields; i++) {
+    if (_fields[i].field == field) return i;
+  }
+  return -1;
+}
+
+
+// Start tracking a field with no deadband, returns its index or -1 if there is no room
+int8_t ChangeFilter::Add(OctaveField field){
+  if (_numFields >= CHANGE_FILTER_MAX_FIELDS) return -1;
+
+  TrackedField &tracked = _fields[_numFields];
+  tracked.field = field;
+  tracked.absolute = 0;
+  tracked.relative = 0;
+  tracked.heartbeatMillis = CHANGE_FILTER_NO_HEARTBEAT;
+  tracked.lastMillis = 0;
+  tracked.lastValue = 0;
+  tracked.lastErrorCode = 0;
+  tracked.reported = false;
+  tracked.configured = false;
+  return _numFields++;
+}
@@ -0,0 +1,244 @@
+#include "ConsumptionAggregator.h"
+
+// Round a double, given as its IEEE-754 bits, times CONSUMPTION_SCALE to the nearest integer, using integer operations only
+// Both double and float64_t hold the IEEE-754 bits. Returns false for NaN, infinities and values of 2^52 and above
+static bool ScaleAndRound(uint64_t bits, int64_t &output){
+  bool negative = (bits >> 63) != 0;
+  int16_t exponent = (bits >> 52) & 0x7FF;
+  uint64_t fraction = bits & 0xFFFFFFFFFFFFFULL;
+
+  if (exponent == 0x7FF) return false;
+  // Zero and subnormals
+  if (exponent == 0) {
+    output = 0;
+    return true;
+  }
+
+  // The scaled value is scaled / 2^shift
+  int16_t shift = 1075 - exponent;
+  if (shift <= 0) return false;
+  uint64_t scaled = (fraction | (1ULL << 52)) * CONSUMPTION_SCALE;
+  uint64_t magnitude = 0;
+  if (shift < 64) magnitude = (scaled >> shift) + ((scaled >> (shift - 1)) & 1);
+  output = negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+  return true;
+}
+
+
+// Reading of a double field, scaled and rounded
+static bool ScaledDouble(const void *value, int64_t &output){
+  uint64_t bits;
+  memcpy(&bits, value, sizeof(bits));
+  return ScaleAndRound(bits, output);
+}
+
+
+// Quotient rounded to the nearest integer
+static int64_t RoundedDivide(int64_t dividend, uint32_t divisor){
+  int64_t half = divisor / 2;
+  return dividend >= 0 ? (dividend + half) / divisor : -((-dividend + half) / divisor);
+}
+
+
+// Unsigned 128-bit arithmetic on a high and a low word, for the sums of squares of the flows
+static void Multiply128(uint64_t a, uint64_t b, uint64_t &high, uint64_t &low){
+  uint64_t lowLow = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+  uint64_t highLow = (a >> 32) * (b & 0xFFFFFFFF);
+  uint64_t lowHigh = (a & 0xFFFFFFFF) * (b >> 32);
+  // At most 2^64 - 1, it can't overflow
+  uint64_t middle = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + lowHigh;
+  low = (middle << 32) | (lowLow & 0xFFFFFFFF);
+  high = (a >> 32) * (b >> 32) + (highLow >> 32) + (middle >> 32);
+}
+
+
+static void Add128(uint64_t &high, uint64_t &low, uint64_t addHigh, uint64_t addLow){
+  low += addLow;
+  high += addHigh + (low < addLow ? 1 : 0);
+}
+
+
+static void Subtract128(uint64_t &high, uint64_t &low, uint64_t subtractHigh, uint64_t subtractLow){
+  high -= subtractHigh + (low < subtractLow ? 1 : 0);
+  low -= subtractLow;
+}
+
+
+// Long division by 32-bit digits, the quotient rounded down
+static void Divide128(uint64_t &high, uint64_t &low, uint32_t divisor){
+  uint32_t digits[4] = {static_cast<uint32_t>(high >> 32), static_cast<uint32_t>(high),
+                        static_cast<uint32_t>(low >> 32), static_cast<uint32_t>(low)};
+  uint64_t remainder = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    uint64_t dividend = (remainder << 32) | digits[i];
+    digits[i] = dividend / divisor;
+    remainder = dividend % divisor;
+  }
+  high = (static_cast<uint64_t>(digits[0]) << 32) | digits[1];
+  low = (static_cast<uint64_t>(digits[2]) << 32) | digits[3];
+}
+
+
+// Aggregate over windows of durationMillis
+bool ConsumptionAggregator::AddWindow(uint32_t durationMillis){
+  if (_numWindows >= CONSUMPTION_MAX_WINDOWS || durationMillis == 0) return false;
+  _windows[_numWindows].durationMillis = durationMillis;
+  _windows[_numWindows].open = false;
+  _numWindows++;
+  return true;
+}
+
+
+void ConsumptionAggregator::SetCallback(ConsumptionCallback callback, void *context){
+  _callback = callback;
+  _callbackContext = context;
+}
+
+
+// Add a reading, readings of other fields and failed ones are ignored
+void ConsumptionAggregator::Update(OctaveField field, uint8_t errorCode, const OctaveValue &value, uint32_t nowMillis){
+  if (errorCode != 0) return;
+  if (field != OctaveField::ForwardVolume_double && field != OctaveField::ReverseVolume_double &&
+      field != OctaveField::SignedCurrentFlow_double) return;
+
+  int64_t scaled;
+  if (!ScaledDouble(&value.float64, scaled)) {
+    _rejected++;
+    return;
+  }
+
+  Advance(nowMillis);
+  _samples++;
+  if (field == OctaveField::ForwardVolume_double) AddVolume(_forwardVolume, _forwardValid, scaled, true);
+  else if (field == OctaveField::ReverseVolume_double) AddVolume(_reverseVolume, _reverseValid, scaled, false);
+  else if (scaled >= INT32_MIN && scaled <= INT32_MAX) AddFlow(static_cast<int32_t>(scaled));
+  else {
+    _samples--;
+    _rejected++;
+  }
+}
+
+
+// Add the volumes and flow of a snapshot
+void ConsumptionAggregator::Update(const OctaveSnapshot &snapshot, uint32_t nowMillis){
+  OctaveValue value;
+  value.float64 = snapshot.forwardVolume;
+  Update(OctaveField::ForwardVolume_double, 0, value, nowMillis);
+  value.float64 = snapshot.reverseVolume;
+  Update(OctaveField::ReverseVolume_double, 0, value, nowMillis);
+  value.float64 = snapshot.signedCurrentFlow;
+  Update(OctaveField::SignedCurrentFlow_double, 0, value, nowMillis);
+}
+
+
+// OctaveReadCallback to give to the source of readings, with the aggregator as its context
+void ConsumptionAggregator::Forward(OctaveField field, uint8_t errorCode, const OctaveValue &value, void *context){
+  static_cast<ConsumptionAggregator*>(context)->Update(field, errorCode, value, millis());
+}
+
+
+// Close the windows that ended, without waiting for the next reading
+uint8_t ConsumptionAggregator::Poll(uint32_t nowMillis){
+  uint8_t closed = 0;
+  for (uint8_t i = 0; i < _numWindows; i++) {
+    Window &window = _windows[i];
+    if (window.open && nowMillis - window.startMillis >= window.durationMillis) {
+      Close(window);
+      closed++;
+    }
+  }
+  return closed;
+}
+
+
+// Open the windows that aren't, after closing the ones that ended
+void ConsumptionAggregator::Advance(uint32_t nowMillis){
+  Poll(nowMillis);
+  for (uint8_t i = 0; i < _numWindows; i++) {
+    Window &window = _windows[i];
+    if (window.open) continue;
+
+    window.open = true;
+    // Windows without readings are skipped
+    window.startMillis = nowMillis - nowMillis % window.durationMillis;
+    window.forwardVolume = 0;
+    window.reverseVolume = 0;
+    window.flowSamples = 0;
+    window.reverseFlowSamples = 0;
+    window.flowSum = 0;
+    window.flowSquaresHigh = 0;
+    window.flowSquaresLow = 0;
+  }
+}
+
+
+// Report a window and leave it closed until its next reading
+void ConsumptionAggregator::Close(Window &window){
+  window.open = false;
+  if (_callback == nullptr) return;
+
+  ConsumptionSummary summary;
+  summary.slaveAddress = _slaveAddress;
+  summary.startMillis = window.startMillis;
+  summary.durationMillis = window.durationMillis;
+  summary.forwardVolume = window.forwardVolume;
+  summary.reverseVolume = window.reverseVolume;
+  summary.flowSamples = window.flowSamples;
+  summary.reverseFlowSamples = window.reverseFlowSamples;
+  summary.minFlow = window.minFlow;
+  summary.maxFlow = window.maxFlow;
+  summary.meanFlow = 0;
+  summary.flowVariance = 0;
+  if (window.flowSamples > 0) {
+    summary.meanFlow = window.referenceFlow + RoundedDivide(window.flowSum, window.flowSamples);
+    // n * variance = sum of squares - sum^2 / n, of the deviations from the reference, in 128 bits
+    // The sum of squares is at least sum^2 / n, and the variance of int32_t flows fits in 64 bits
+    uint64_t magnitude = static_cast<uint64_t>(window.flowSum < 0 ? -window.flowSum : window.flowSum);
+    uint64_t squaredSumHigh, squaredSumLow;
+    Multiply128(magnitude, magnitude, squaredSumHigh, squaredSumLow);
+    Divide128(squaredSumHigh, squaredSumLow, window.flowSamples);
+    uint64_t varianceHigh = window.flowSquaresHigh, varianceLow = window.flowSquaresLow;
+    Subtract128(varianceHigh, varianceLow, squaredSumHigh, squaredSumLow);
+    Divide128(varianceHigh, varianceLow, window.flowSamples);
+    summary.flowVariance = varianceLow;
+  }
+  _callback(summary, _callbackContext);
+}
+
+
+// Add the increase of a volume counter to the open windows
+void ConsumptionAggregator::AddVolume(int64_t &last, bool &valid, int64_t volume, bool forward){
+  // The first reading is the start of the counter, a counter that goes back restarts from its new value
+  int64_t increase = valid && volume > last ? volume - last : 0;
+  last = volume;
+  valid = true;
+  if (increase == 0) return;
+
+  for (uint8_t i = 0; i < _numWindows; i++) {
+    if (forward) _windows[i].forwardVolume += increase;
+    else _windows[i].reverseVolume += increase;
+  }
+}
+
+
+void ConsumptionAggregator::AddFlow(int32_t flow){
+  for (uint8_t i = 0; i < _numWindows; i++) {
+    Window &window = _windows[i];
+    if (window.flowSamples >= CONSUMPTION_MAX_FLOW_SAMPLES) continue;
+    if (window.flowSamples == 0) {
+      window.referenceFlow = flow;
+      window.minFlow = flow;
+      window.maxFlow = flow;
+    }
+    if (flow < window.minFlow) window.minFlow = flow;
+    if (flow > window.maxFlow) window.maxFlow = flow;
+    if (flow < 0) window.reverseFlowSamples++;
+
+    // Deviations are below 2^32, so their squares fit in 64 bits
+    int64_t deviation = static_cast<int64_t>(flow) - window.referenceFlow;
+    uint64_t magnitude = static_cast<uint64_t>(deviation < 0 ? -deviation : deviation);
+    window.flowSum += deviation;
+    Add128(window.flowSquaresHigh, window.flowSquaresLow, 0, magnitude * magnitude);
+    window.flowSamples++;
+  }
+}
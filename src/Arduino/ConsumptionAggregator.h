@@ -0,0 +1,119 @@
+#ifndef __ConsumptionAggregator_H__
+#define __ConsumptionAggregator_H__
+
+#include "OctaveModbusWrapper.h"
+
+/****** Settings ******/
+// Maximum number of windows of a ConsumptionAggregator, e.g. 1 minute, 15 minutes and 1 hour
+#ifndef CONSUMPTION_MAX_WINDOWS
+#define CONSUMPTION_MAX_WINDOWS 3
+#endif
+
+// Volumes and flows are aggregated as integers, in 1/CONSUMPTION_SCALE of the meter's units
+// At most 1024, so a 53-bit mantissa times the scale fits in 64 bits
+#define CONSUMPTION_SCALE 1000
+static_assert(CONSUMPTION_SCALE > 0 && CONSUMPTION_SCALE <= 1024, "CONSUMPTION_SCALE must be from 1 to 1024");
+
+// Flow readings a window takes at most, so the sum of their deviations fits in 64 bits, later ones are left out
+#define CONSUMPTION_MAX_FLOW_SAMPLES 0x80000000UL
+
+// Summary of one window of a ConsumptionAggregator
+// Volumes are in 1/CONSUMPTION_SCALE of the volume unit, flows in 1/CONSUMPTION_SCALE of the flow unit
+struct ConsumptionSummary {
+    uint8_t slaveAddress;
+    // Start of the window, a multiple of its duration, as given to the aggregator
+    uint32_t startMillis;
+    uint32_t durationMillis;
+    // Increase of the forward and reverse volume counters over the window, from the last reading
+    // before the window to the last one in it. A counter that goes back, e.g. after a replacement, adds nothing
+    int64_t forwardVolume;
+    int64_t reverseVolume;
+    // Flow readings, at most CONSUMPTION_MAX_FLOW_SAMPLES, and the ones that were negative, i.e. reverse flow
+    uint32_t flowSamples;
+    uint32_t reverseFlowSamples;
+    // Only valid if flowSamples isn't 0
+    int32_t minFlow;
+    int32_t maxFlow;
+    int32_t meanFlow;
+    // Population variance, in 1/CONSUMPTION_SCALE^2 of the flow unit squared
+    uint64_t flowVariance;
+};
+
+// Called when a window closes
+typedef void (*ConsumptionCallback)(const ConsumptionSummary &summary, void *context);
+
+// Streaming consumption statistics of one meter, over up to CONSUMPTION_MAX_WINDOWS window durations
+// Fed with ForwardVolume_double, ReverseVolume_double and SignedCurrentFlow_double readings, or snapshots,
+// it keeps the volume consumed, the reverse volume, and the flow minimum, maximum, mean and variance
+// of every window in O(1) per reading, and reports each window once, when it closes, instead of every reading
+// Windows are aligned to multiples of their duration, so a 1 hour window holds exactly four 15 minute ones
+// Integer operations only, so the AVR's float64_t readings cost no floating point
+class ConsumptionAggregator {
+    public:
+        // slaveAddress is the meter the readings come from, copied into every summary
+        explicit ConsumptionAggregator(uint8_t slaveAddress) : _slaveAddress(slaveAddress) {}
+
+        // Aggregate over windows of durationMillis, returns false if CONSUMPTION_MAX_WINDOWS windows are already set
+        bool AddWindow(uint32_t durationMillis);
+        // Set a function to call with the summary of every window that closes
+        void SetCallback(ConsumptionCallback callback, void *context = nullptr);
+
+        // Add a reading, readings of other fields and failed ones are ignored
+        void Update(OctaveField field, uint8_t errorCode, const OctaveValue &value, uint32_t nowMillis);
+        // Add the volumes and flow of a snapshot
+        void Update(const OctaveSnapshot &snapshot, uint32_t nowMillis);
+        // OctaveReadCallback to give to the source of readings, with the aggregator as its context
+        // Calls Update() with millis()
+        static void Forward(OctaveField field, uint8_t errorCode, const OctaveValue &value, void *context);
+
+        // Close the windows that ended, without waiting for the next reading, e.g. when the meter stopped answering
+        // Returns the number of windows closed. Windows without readings aren't reported
+        uint8_t Poll(uint32_t nowMillis);
+
+        // Readings added, and readings ignored because their value is out of range
+        uint32_t Samples() const { return _samples; }
+        uint32_t Rejected() const { return _rejected; }
+
+    private:
+        struct Window {
+            uint32_t durationMillis;
+            uint32_t startMillis;
+            // A window opens with its first reading
+            bool open;
+            int64_t forwardVolume;
+            int64_t reverseVolume;
+            uint32_t flowSamples;
+            uint32_t reverseFlowSamples;
+            int32_t minFlow;
+            int32_t maxFlow;
+            // Sums of the flows, and of their squares, as deviations from the first flow, to keep them small
+            // The squares of a long window of high flows take more than 64 bits, their sum has a high and a low word
+            int32_t referenceFlow;
+            int64_t flowSum;
+            uint64_t flowSquaresHigh;
+            uint64_t flowSquaresLow;
+        };
+
+        uint8_t _slaveAddress;
+        Window _windows[CONSUMPTION_MAX_WINDOWS];
+        uint8_t _numWindows = 0;
+        ConsumptionCallback _callback = nullptr;
+        void *_callbackContext = nullptr;
+
+        // Last volume counter readings, the increases are added to the open windows
+        int64_t _forwardVolume = 0;
+        int64_t _reverseVolume = 0;
+        bool _forwardValid = false;
+        bool _reverseValid = false;
+
+        uint32_t _samples = 0;
+        uint32_t _rejected = 0;
+
+        // Open the windows that aren't, after closing the ones that ended
+        void Advance(uint32_t nowMillis);
+        void Close(Window &window);
+        void AddVolume(int64_t &last, bool &valid, int64_t volume, bool forward);
+        void AddFlow(int32_t flow);
+};
+
+#endif
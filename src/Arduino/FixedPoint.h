@@ -0,0 +1,49 @@
+#ifndef __FixedPoint_H__
+#define __FixedPoint_H__
+
+#include <stdint.h>
+
+// Compile-time parsing of decimal strings, such as DEC16_MAX or SCALE_FACTOR
+// Digits of a decimal string as an integer, ignoring the decimal point
+constexpr int64_t ParseDecimalDigits(const char* s, int64_t value = 0) {
+    return *s == '\0' ? value
+         : *s == '.' ? ParseDecimalDigits(s + 1, value)
+         : ParseDecimalDigits(s + 1, value * 10 + (*s - '0'));
+}
+
+// Number of digits after the decimal point
+constexpr uint8_t ParseDecimalPlaces(const char* s, uint8_t places = 0, bool fraction = false) {
+    return *s == '\0' ? places : ParseDecimalPlaces(s + 1, places + (fraction ? 1 : 0), fraction || *s == '.');
+}
+
+constexpr int64_t PowerOf10(uint8_t exponent) {
+    return exponent == 0 ? 1 : 10 * PowerOf10(exponent - 1);
+}
+
+// Value of a decimal string multiplied by scale, truncated toward zero
+constexpr int64_t ParseScaledDecimal(const char* s, int64_t scale) {
+    return *s == '-' ? -ParseScaledDecimal(s + 1, scale)
+         : ParseDecimalDigits(s) * scale / PowerOf10(ParseDecimalPlaces(s));
+}
+
+// Whether a decimal string multiplied by scale is an integer
+constexpr bool IsExactScaledDecimal(const char* s, int64_t scale) {
+    return *s == '-' ? IsExactScaledDecimal(s + 1, scale)
+         : ParseDecimalDigits(s) * scale % PowerOf10(ParseDecimalPlaces(s)) == 0;
+}
+
+// Largest integer scale that ScaleAndTruncate supports, so the 53-bit mantissa times the scale fits in 64 bits
+#define MAX_FIXED_POINT_SCALE 2047
+
+enum class TruncationResult : uint8_t {
+    Ok,
+    Overflow,   // Truncates above maxScaled, or NaN
+    Underflow   // Truncates below minScaled
+};
+
+// Multiply a double, given as its IEEE-754 bits, by scale and truncate it toward zero, using integer operations only
+// The product is rounded as a double multiplication would, so decimal inputs such as 231.72 give 23172
+// minScaled and maxScaled are the limits of the truncated value, output is only written if the result is Ok
+TruncationResult ScaleAndTruncate(uint64_t bits, uint16_t scale, int32_t minScaled, int32_t maxScaled, int32_t &output);
+
+#endif
@@ -0,0 +1,74 @@
+#include "MeterBus.h"
+
+MeterBus::MeterBus(OctaveModbusWrapper &octave, const uint8_t *slaveAddresses, uint8_t numMeters,
+                   OctaveSnapshot *snapshots, uint8_t *errorCodes)
+  : _octave(octave), _slaveAddresses(slaveAddresses), _numMeters(numMeters),
+    _snapshotOutputs(snapshots), _errorCodes(errorCodes) {}
+
+
+// Advance the poll cycle without blocking, call it as often as possible from loop()
+// Returns the index of the meter whose snapshot just finished, or -1 if none did
+int16_t MeterBus::Poll(){
+  if (_numMeters == 0) return -1;
+
+  if (!_statsStarted) {
+    _statsStartMillis = millis();
+    _statsStarted = true;
+  }
+
+  int16_t finishedMeter = -1;
+
+  if (_pendingRegisters > 0) {
+    // Still waiting for the current meter
+    if (_octave.Poll() == OctaveRequestStatus::Pending) return -1;
+
+    _transactions++;
+    uint8_t result = _octave.LastErrorCode();
+    _registerOffset += _pendingRegisters;
+    _pendingRegisters = 0;
+
+    // The snapshot is finished when all blocks were read or one of them failed
+    if (result != 0 || _registerOffset >= SNAPSHOT_NUM_REGISTERS) {
+      if (result == 0) OctaveModbusWrapper::DecodeSnapshot(_registers, &_snapshotOutputs[_currentMeter]);
+      _errorCodes[_currentMeter] = result;
+      finishedMeter = _currentMeter;
+      _snapshots++;
+
+      // Move on to the next meter
+      _currentMeter = (_currentMeter + 1) % _numMeters;
+      _registerOffset = 0;
+    }
+  }
+
+  // Send the next request right away to keep the bus busy
+  StartNextRequest();
+  return finishedMeter;
+}
+
+
+// Send the request for the next register block of the current meter
+void MeterBus::StartNextRequest(){
+  uint8_t numRegisters = SNAPSHOT_NUM_REGISTERS - _registerOffset;
+  if (numRegisters > MODBUS_MAX_READ_REGISTERS) numRegisters = MODBUS_MAX_READ_REGISTERS;
+
+  uint8_t result = _octave.StartReadRawRegisters(SNAPSHOT_START_ADDRESS + _registerOffset, numRegisters,
+                                                 _registers + _registerOffset, _slaveAddresses[_currentMeter]);
+  // If the channel is busy with another request, try again on the next Poll()
+  if (result == 0) _pendingRegisters = numRegisters;
+}
+
+
+// Aggregate bus throughput since the first Poll() or the last ResetStats()
+float MeterBus::TransactionsPerSecond() const {
+  uint32_t elapsedMillis = millis() - _statsStartMillis;
+  if (!_statsStarted || elapsedMillis == 0) return 0.0;
+  return _transactions * 1000.0 / elapsedMillis;
+}
+
+
+void MeterBus::ResetStats(){
+  _transactions = 0;
+  _snapshots = 0;
+  _statsStartMillis = millis();
+  _statsStarted = true;
+}
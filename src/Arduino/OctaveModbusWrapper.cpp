@@ -1,58 +1,508 @@
 #include "OctaveModbusWrapper.h"
 
+// RAM of the wrapper's own state on the AVR, which doesn't pad, with the default settings, as given in the README
+// The last decoded value is sized for the 16 digits of the serial number, and 3 request policies are kept
+// because the next and active ones must survive a change of the others while a request is on the bus
+#if defined(__AVR__) && !OCTAVE_BUS_STATS && !OCTAVE_FIELD_CACHE && !OCTAVE_LEGACY_BUFFERS
+static_assert(sizeof(OctaveValue) == 32, "The last decoded value takes 32 bytes on the AVR, update the README");
+static_assert(sizeof(OctaveRequestPolicy) == 7, "A request policy takes 7 bytes on the AVR, update the README");
+static_assert(sizeof(OctaveModbusWrapper) - sizeof(ModbusRTUMaster) == 107,
+              "The wrapper's own state takes 107 bytes on the AVR, update the README");
+#endif
+
 // Initialize Serial interface used for Modbus communication
-OctaveModbusWrapper::OctaveModbusWrapper(HardwareSerial &modbusSerial) : _master(modbusSerial){}
+// and the slave address used by requests that don't specify one
+OctaveModbusWrapper::OctaveModbusWrapper(HardwareSerial &modbusSerial, uint8_t slaveAddress) : _master(modbusSerial), _serial(modbusSerial), _slaveAddress(slaveAddress){
+  ResetBusStats();
+#if OCTAVE_FIELD_CACHE
+  for (uint8_t i = 0; i < static_cast<uint8_t>(OctaveField::Count); i++) {
+    _cache[i].ttlMillis = 0;
+    _cache[i].valid = false;
+  }
+  // The serial number never changes
+  _cache[static_cast<uint8_t>(OctaveField::SerialNumber)].ttlMillis = CACHE_TTL_FOREVER;
+#endif
+}
 
 
 void OctaveModbusWrapper::begin(uint32_t baudrate) {
-  // Initialize name-to-code and code-to-name mappings to interpret readings
-  InitMaps();
   // Start the modbus _master object
+  SetBaudrate(baudrate);
+}
+
+
+void OctaveModbusWrapper::SetBaudrate(uint32_t baudrate){
 	_master.begin(baudrate);
+  _baudrate = baudrate;
+  // 3.5 characters of 11 bits, the standard fixes it at 1750 us above 19200 baud
+  _autoGapMicros = baudrate > 19200 ? 1750 : 38500000UL / baudrate;
+}
+
+
+/****** Bus statistics ******/
+// Copy the statistics gathered since the wrapper was created or since the last ResetBusStats()
+void OctaveModbusWrapper::BusStats(OctaveBusStats* output) const {
+#if OCTAVE_BUS_STATS
+  *output = _busStats;
+#else
+  memset(output, 0, sizeof(OctaveBusStats));
+#endif
+}
+
+
+void OctaveModbusWrapper::ResetBusStats(){
+#if OCTAVE_BUS_STATS
+  memset(&_busStats, 0, sizeof(OctaveBusStats));
+  const uint8_t functionCodes[OCTAVE_STATS_FUNCTION_CODES] = {0x04, 0x06, 0x10};
+  for (uint8_t i = 0; i < OCTAVE_STATS_FUNCTION_CODES; i++) {
+    _busStats.latency[i].functionCode = functionCodes[i];
+    _busStats.latency[i].minMicros = UINT32_MAX;
+  }
+#endif
+}
+
+
+// Upper bound, in us, of a latency histogram bucket, the last bucket has none and returns UINT32_MAX
+uint32_t OctaveModbusWrapper::LatencyBucketMicros(uint8_t bucket){
+  if (bucket >= OCTAVE_LATENCY_BUCKETS - 1) return UINT32_MAX;
+  return static_cast<uint32_t>(OCTAVE_LATENCY_FIRST_BUCKET_MICROS) << bucket;
+}
+
+
+#if OCTAVE_BUS_STATS
+// Count a request sent on the bus, with the size of its frame
+void OctaveModbusWrapper::RecordRequest(uint8_t frameBytes){
+  _requestStartMicros = micros();
+  _busStats.requests++;
+  _busStats.bytesSent += frameBytes;
 }
 
 
+// Count a request refused because the channel was busy
+void OctaveModbusWrapper::RecordBusy(){
+  _busStats.busyRejections++;
+}
+
+
+// Count the result of the request on the bus and its latency
+void OctaveModbusWrapper::RecordResult(uint8_t errorCode){
+  // Nothing was received
+  if (errorCode == 5) {
+    _busStats.timeouts++;
+    return;
+  }
+
+  uint8_t functionCode = lastUsedFunctionCode >> 8;
+  if (errorCode == 0) {
+    // Reads return a byte count and the registers, writes echo the address and quantity or value
+    _busStats.bytesReceived += functionCode == 0x04 ? 5 + 2 * _numRegisterstoRead : 8;
+  }
+  else {
+    // Exception response: address, function code, exception code and CRC
+    _busStats.bytesReceived += 5;
+    if (errorCode <= 4) _busStats.exceptions[errorCode - 1]++;
+  }
+
+  OctaveLatencyStats *latency = nullptr;
+  for (uint8_t i = 0; i < OCTAVE_STATS_FUNCTION_CODES; i++) {
+    if (_busStats.latency[i].functionCode == functionCode) latency = &_busStats.latency[i];
+  }
+  if (latency == nullptr) return;
+
+  uint32_t elapsedMicros = micros() - _requestStartMicros;
+  latency->responses++;
+  latency->totalMicros += elapsedMicros;
+  if (elapsedMicros < latency->minMicros) latency->minMicros = elapsedMicros;
+  if (elapsedMicros > latency->maxMicros) latency->maxMicros = elapsedMicros;
+
+  // Bucket i holds latencies under OCTAVE_LATENCY_FIRST_BUCKET_MICROS << i
+  uint8_t bucket = 0;
+  while (bucket < OCTAVE_LATENCY_BUCKETS - 1 && elapsedMicros >= LatencyBucketMicros(bucket)) bucket++;
+  latency->histogram[bucket]++;
+}
+#endif
+
+
 /****** Modbus communication functions ******/
 // Read the Modbus channel in blocking mode until a response is received or an error occurs
 uint8_t OctaveModbusWrapper::AwaitResponse(){
   // While the _master is in receiving mode and the timeout hasn't been reached
-  while(_master.isWaitingResponse()){
-    // Check available responses
-    ModbusResponse response = _master.available();
-
-    // If there was a valid response
-    if (response) {
-      if (response.hasError()) {
-        // Error: Response received, contains Modbus error code
-        return response.getErrorCode();
-      } else {
-        if (response.hasError()) {
-          // Error: Response received, contains Modbus error code
-          return response.getErrorCode();
-        } else {
-          // If there are registers to read, process them
-          if(_numRegisterstoRead > 0) {
-            ProcessResponse(&response);
-            // Assume no error occurred while processing
-            return 0;
-          }
-          // If there are no registers to read, it was a write request
-          else {
-            // No error
-            return 0;
-          }
-        }
-      }
+  while(Poll() == OctaveRequestStatus::Pending){
+    // Sleep through the backoff before a retry, so other tasks can run
+    if (_waitingRetry) delay(1);
+  }
+  return _lastModbusErrorCode;
+}
+
+
+// Check for the response of the current request without blocking
+// Returns Done once the request finishes, the error code is then available with LastErrorCode()
+OctaveRequestStatus OctaveModbusWrapper::Poll(){
+  if (_requestStatus != OctaveRequestStatus::Pending) return _requestStatus;
+
+  // Send the next attempt once the backoff is over
+  if (_waitingRetry) {
+    if (millis() - _retryStartMillis < _retryBackoffMillis) return _requestStatus;
+    _waitingRetry = false;
+    _retryBackoffMillis *= 2;
+    // The master refused the retry, which is a local busy condition and not a result from the bus
+    // The request ends with the timeout of the last attempt, which was already counted
+    if (!TransmitRequest()) {
+      RecordBusy();
+      EndRequest(5);
     }
+    return _requestStatus;
+  }
+
+  // Check available responses
+  ModbusResponse response = _master.available();
+
+  // If there was a valid response
+  if (response) {
+    if (response.hasError()) {
+      // Error: Response received, contains Modbus error code
+      CompleteRequest(response.getErrorCode());
+    } else {
+      // If there are registers to read, process them
+      // If there are no registers to read, it was a write request
+      if(_numRegisterstoRead > 0) ProcessResponse(&response);
+      // Assume no error occurred while processing
+      CompleteRequest(0);
+    }
+    _lastFrameEndMicros = micros();
+  }
+  // If the _master stopped waiting without a response, the timeout was reached
+  else if (!_master.isWaitingResponse()) {
+    _lastFrameEndMicros = micros();
+    if (_retriesLeft > 0) {
+      // Count the failed attempt, then wait before sending it again
+      RecordResult(5);
+      RecordRetry();
+      _retriesLeft--;
+      _waitingRetry = true;
+      _retryStartMillis = millis();
+    }
+    // Error code 5: Timeout
+    else CompleteRequest(5);
+  }
+
+  return _requestStatus;
+}
+
+
+// Count the result of the current request on the bus, then end it
+void OctaveModbusWrapper::CompleteRequest(uint8_t errorCode){
+  RecordResult(errorCode);
+  EndRequest(errorCode);
+}
+
+
+// Store the result of the current request and notify the read callback
+void OctaveModbusWrapper::EndRequest(uint8_t errorCode){
+  _lastModbusErrorCode = errorCode;
+  _requestStatus = OctaveRequestStatus::Done;
+
+  // The rest only applies to requests started from a field
+  if (_requestField == OctaveField::Count) return;
+
+  if (errorCode == 0) UpdateCache(_requestField);
+
+  // Only reads decoded into _lastValue notify the callback, the others already have their value
+  if (_numRegisterstoRead > 0 && _output == &_lastValue && _readCallback != nullptr) {
+    _readCallback(_requestField, errorCode, _lastValue, _readCallbackContext);
   }
+}
+
+
+/****** Request policy ******/
+// Use a policy for the next request only, the instance's policy applies again after it
+void OctaveModbusWrapper::SetNextRequestPolicy(const OctaveRequestPolicy &policy){
+  _nextPolicy = policy;
+  _nextPolicyValid = true;
+}
+
+
+/****** Line settings ******/
+// Line time of a snapshot read, the request and its response, in us
+static uint32_t SnapshotLineMicros(uint32_t baudrate, uint32_t config){
+  // Start bit, 8 data bits and one stop bit, plus a parity or second stop bit
+  uint32_t bitsPerChar = config == SERIAL_8N1 ? 10 : 11;
+  // Read request, then slave address, function code, byte count, registers and CRC
+  uint32_t bytes = 8 + 5 + 2 * SNAPSHOT_NUM_REGISTERS;
+  return (uint32_t)((uint64_t)bytes * bitsPerChar * 1000000UL / baudrate);
+}
+
+
+void OctaveModbusWrapper::SetLineSettingsCallback(OctaveLineSettingsCallback callback, void *context){
+  _lineSettingsCallback = callback;
+  _lineSettingsContext = context;
+}
+
+
+// Restart the port and the master with new line settings
+void OctaveModbusWrapper::ApplyLineSettings(uint32_t baudrate, uint32_t config){
+  if (_lineSettingsCallback != nullptr) _lineSettingsCallback(baudrate, config, _lineSettingsContext);
+  else _serial.begin(baudrate, config);
+  _config = config;
+  SetBaudrate(baudrate);
+}
+
+
+// Send a ReadAlarms frame, returns true if the meter answered, even with an exception
+bool OctaveModbusWrapper::ProbeLineSettings(uint8_t slaveAddress, uint8_t* probes){
+  OctaveRequestPolicy policy;
+  policy.responseTimeoutMillis = OCTAVE_AUTOBAUD_TIMEOUT_MS;
+  policy.retries = OCTAVE_AUTOBAUD_RETRIES;
+  SetNextRequestPolicy(policy);
+
+  uint16_t alarms;
+  // A raw read skips the cache, the probe must reach the meter
+  uint8_t errorCode = BlockingReadRawRegisters(OctaveRegisterMap::Get(OctaveField::ReadAlarms).startMemAddress, 1, &alarms, slaveAddress);
+  // The first attempt and the retries it used
+  *probes += 1 + _activePolicy.retries - _retriesLeft;
+  // Any response means the meter understood the frame, only a timeout means wrong settings
+  return errorCode != 5;
+}
+
+
+// Find the baud rate and parity the meter answers at, and keep the port at those settings
+// With a target rate, also report whether the meter can be moved to it
+uint8_t OctaveModbusWrapper::AutoBaud(OctaveAutoBaudResult* output, uint32_t targetBaudrate, uint8_t slaveAddress){
+  if (_requestStatus == OctaveRequestStatus::Pending) {
+    // Error code 3: Modbus channel busy
+    RecordBusy();
+    return 3;
+  }
+
+  static const uint32_t rates[] = {OCTAVE_AUTOBAUD_RATES};
+  static const uint32_t configs[] = {OCTAVE_AUTOBAUD_CONFIGS};
+  const uint8_t numRates = sizeof(rates) / sizeof(rates[0]);
+  const uint8_t numConfigs = sizeof(configs) / sizeof(configs[0]);
+
+  output->probes = 0;
+  const uint32_t startBaudrate = _baudrate;
+  const uint32_t startConfig = _config;
+
+  // The current rate first at every parity, the meter most likely still answers at it
+  // The port is restarted for every probe, since the parity it was started with isn't known
+  bool found = false;
+  for (uint8_t c = 0; c < numConfigs && !found; c++) {
+    ApplyLineSettings(startBaudrate, configs[c]);
+    found = ProbeLineSettings(slaveAddress, &output->probes);
+  }
+  for (uint8_t c = 0; c < numConfigs && !found; c++) {
+    for (uint8_t r = 0; r < numRates && !found; r++) {
+      if (rates[r] == startBaudrate) continue;
+      ApplyLineSettings(rates[r], configs[c]);
+      found = ProbeLineSettings(slaveAddress, &output->probes);
+    }
+  }
+  if (!found) ApplyLineSettings(startBaudrate, startConfig);
+
+  output->baudrate = _baudrate;
+  output->config = _config;
+  output->targetBaudrate = targetBaudrate;
+  output->canMigrate = false;
+  if (found && targetBaudrate > _baudrate) {
+    for (uint8_t r = 0; r < numRates; r++) {
+      if (rates[r] == targetBaudrate) output->canMigrate = true;
+    }
+  }
+  output->snapshotLineMicros = SnapshotLineMicros(_baudrate, _config);
+  output->targetSnapshotLineMicros = targetBaudrate != 0 ? SnapshotLineMicros(targetBaudrate, _config) : 0;
+
   // Error code 5: Timeout
-  return 5;
+  return found ? 0 : 5;
+}
+
+
+/****** Field cache ******/
+void OctaveModbusWrapper::SetCacheTTL(OctaveField field, uint32_t ttlMillis){
+#if OCTAVE_FIELD_CACHE
+  _cache[static_cast<uint8_t>(field)].ttlMillis = ttlMillis;
+#endif
+}
+
+uint32_t OctaveModbusWrapper::CacheTTL(OctaveField field) const {
+#if OCTAVE_FIELD_CACHE
+  return _cache[static_cast<uint8_t>(field)].ttlMillis;
+#else
+  return 0;
+#endif
+}
+
+void OctaveModbusWrapper::InvalidateCache(OctaveField field){
+#if OCTAVE_FIELD_CACHE
+  _cache[static_cast<uint8_t>(field)].valid = false;
+#endif
+}
+
+void OctaveModbusWrapper::InvalidateCache(){
+  for (uint8_t i = 0; i < static_cast<uint8_t>(OctaveField::Count); i++) {
+    InvalidateCache(static_cast<OctaveField>(i));
+  }
+}
+
+
+// Finish a read request with a cached value, returns false on a cache miss
+bool OctaveModbusWrapper::CompleteFromCache(OctaveField field, void* output, uint8_t slaveAddress){
+#if OCTAVE_FIELD_CACHE
+  const CacheEntry &entry = _cache[static_cast<uint8_t>(field)];
+  if (!entry.valid || entry.ttlMillis == 0 || entry.slaveAddress != ResolveSlaveAddress(slaveAddress)) return false;
+  if (entry.ttlMillis != CACHE_TTL_FOREVER && millis() - entry.storedMillis >= entry.ttlMillis) return false;
+
+  const OctaveRegister info = OctaveRegisterMap::Get(field);
+  lastUsedFunctionCode = OctaveRegisterMap::FunctionCode(field);
+  _numRegisterstoRead = info.numValues * abs(info.signedValueSizeinBits)/16;
+  _numValuesToDecode = info.numValues;
+  _signedResponseSizeinBits = info.signedValueSizeinBits;
+  _requestField = field;
+  _requestSlaveAddress = entry.slaveAddress;
+  _output = output;
+  memcpy(output, &entry.value, OctaveRegisterMap::ValueSize(field));
+  // The request didn't need the bus, but still uses up the next request's policy
+  _nextPolicyValid = false;
+  _lastModbusErrorCode = 0;
+  _requestStatus = OctaveRequestStatus::Done;
+
+  if (output == &_lastValue && _readCallback != nullptr) _readCallback(field, 0, _lastValue, _readCallbackContext);
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+// Store the result of a successful field request in the cache, or invalidate the fields it changed
+void OctaveModbusWrapper::UpdateCache(OctaveField field){
+#if OCTAVE_FIELD_CACHE
+  CacheEntry &entry = _cache[static_cast<uint8_t>(field)];
+  if (entry.ttlMillis != 0 && OctaveRegisterMap::Get(field).functionCode == 0x04) {
+    memcpy(&entry.value, _output, OctaveRegisterMap::ValueSize(field));
+    entry.storedMillis = millis();
+    entry.slaveAddress = _requestSlaveAddress;
+    entry.valid = true;
+    return;
+  }
+
+  switch (field) {
+    case OctaveField::SystemReset:
+      InvalidateCache();
+      break;
+    case OctaveField::WriteWeekday:
+      InvalidateCache(OctaveField::ReadWeekday);
+      InvalidateCache(OctaveField::ReadClock);
+      break;
+    case OctaveField::WriteDay:
+      InvalidateCache(OctaveField::ReadDay);
+      InvalidateCache(OctaveField::ReadClock);
+      break;
+    case OctaveField::WriteMonth:
+      InvalidateCache(OctaveField::ReadMonth);
+      InvalidateCache(OctaveField::ReadClock);
+      break;
+    case OctaveField::WriteYear:
+      InvalidateCache(OctaveField::ReadYear);
+      InvalidateCache(OctaveField::ReadClock);
+      break;
+    case OctaveField::WriteHours:
+      InvalidateCache(OctaveField::ReadHours);
+      InvalidateCache(OctaveField::ReadClock);
+      break;
+    case OctaveField::WriteMinutes:
+      InvalidateCache(OctaveField::ReadMinutes);
+      InvalidateCache(OctaveField::ReadClock);
+      break;
+    // The resolution also changes the scale of the 32-bit values
+    case OctaveField::WriteVolumeResIndex:
+      InvalidateCache(OctaveField::ReadVolumeResIndex);
+      InvalidateCache(OctaveField::ForwardVolume_uint32);
+      InvalidateCache(OctaveField::ReverseVolume_uint32);
+      InvalidateCache(OctaveField::NetSignedVolume_int32);
+      InvalidateCache(OctaveField::NetUnsignedVolume_uint32);
+      break;
+    case OctaveField::WriteFlowResIndex:
+      InvalidateCache(OctaveField::ReadFlowResIndex);
+      InvalidateCache(OctaveField::SignedCurrentFlow_int32);
+      break;
+    case OctaveField::WriteClock:
+      InvalidateCache(OctaveField::ReadWeekday);
+      InvalidateCache(OctaveField::ReadDay);
+      InvalidateCache(OctaveField::ReadMonth);
+      InvalidateCache(OctaveField::ReadYear);
+      InvalidateCache(OctaveField::ReadHours);
+      InvalidateCache(OctaveField::ReadMinutes);
+      InvalidateCache(OctaveField::ReadClock);
+      break;
+    default:
+      break;
+  }
+#endif
+}
+
+
+// Set a function to call when a request started with StartRead finishes
+void OctaveModbusWrapper::SetReadCallback(OctaveReadCallback callback, void *context){
+  _readCallback = callback;
+  _readCallbackContext = context;
+}
+
+
+// Decode one value from its registers, in the byte order of its type
+static void DecodeValue(const uint16_t* registers, uint16_t* output){ *output = registers[0]; }
+static void DecodeValue(const uint16_t* registers, int16_t* output){ *output = static_cast<int16_t>(registers[0]); }
+static void DecodeValue(const uint16_t* registers, uint32_t* output){ *output = DecodeABCD(registers); }
+static void DecodeValue(const uint16_t* registers, int32_t* output){ *output = static_cast<int32_t>(DecodeABCD(registers)); }
+static void DecodeValue(const uint16_t* registers, float64_t* output){ *output = DecodeHGFEDCBA(registers); }
+
+
+// Decode numValues values of type T from the response registers, straight into output
+template <typename T>
+static void DecodeRegisters(ModbusResponse *response, T* output, uint8_t numValues){
+  // Registers per value: 1 for 16-bit, 2 for 32-bit and 4 for 64-bit values
+  const uint8_t registersPerValue = sizeof(T) / sizeof(uint16_t);
+  uint16_t registers[4];
+
+  for (uint8_t i = 0; i < numValues; i++){
+    for (uint8_t j = 0; j < registersPerValue; j++){
+      registers[j] = response->getRegister(i * registersPerValue + j);
+    }
+    DecodeValue(registers, &output[i]);
+  }
 }
 
 
-// Processes the raw register values from the slave response and saves them to the buffers
+// Decodes the registers of the slave response straight into the output of the current request
 // Returns void because it shouldn't throw any errors
 void OctaveModbusWrapper::ProcessResponse(ModbusResponse *response){
+  switch (_signedResponseSizeinBits){
+    // Raw reads are copied as-is to the caller's buffer
+    case 0:
+      DecodeRegisters(response, static_cast<uint16_t*>(_output), _numValuesToDecode);
+      return;
+    case 16:
+      DecodeRegisters(response, static_cast<int16_t*>(_output), _numValuesToDecode);
+      break;
+    case 32:
+      DecodeRegisters(response, static_cast<uint32_t*>(_output), _numValuesToDecode);
+      break;
+    case -32:
+      DecodeRegisters(response, static_cast<int32_t*>(_output), _numValuesToDecode);
+      break;
+    default: // -64
+      DecodeRegisters(response, static_cast<float64_t*>(_output), _numValuesToDecode);
+      break;
+  }
+
+#if OCTAVE_LEGACY_BUFFERS
+  UpdateLegacyBuffers(response);
+#endif
+}
+
+
+#if OCTAVE_LEGACY_BUFFERS
+// Copy the registers of a decoded read to the legacy buffers, clearing the unused ones
+void OctaveModbusWrapper::UpdateLegacyBuffers(ModbusResponse *response){
   if (_signedResponseSizeinBits == 16){
     // Loop through the response
     for (int i = 0; i < 16; i++){
@@ -76,19 +526,21 @@ void OctaveModbusWrapper::ProcessResponse(ModbusResponse *response){
       int16Buffer[i] = 0;
     }
 
+    // Copy the registers of the value, up to 4 for 64-bit values
+    uint16_t registers[4];
+    for (int i = 0; i < _numRegisterstoRead && i < 4; i++){
+      registers[i] = response->getRegister(i);
+    }
+
     if (_signedResponseSizeinBits == 32){
-      // 32 bit values are split into AB CD bytes, according to the memory map
-      // Combine them into ABCD and save them to the buffer
-      uint32Buffer = (static_cast<unsigned long>(response->getRegister(0)) << 16) + static_cast<unsigned long>(response->getRegister(1));
+      uint32Buffer = DecodeABCD(registers);
 
       // Clear the unused buffers
       int32Buffer = 0;
       doubleBuffer = 0.0;
     }
     else if (_signedResponseSizeinBits == -32){
-      // 32 bit values are split into AB CD bytes, according to the memory map
-      // Combine them into ABCD and save them to the buffer
-      int32Buffer = (static_cast<unsigned long>(response->getRegister(0)) << 16) + static_cast<unsigned long>(response->getRegister(1));
+      int32Buffer = static_cast<int32_t>(DecodeABCD(registers));
 
       // Clear the unused buffers
       uint32Buffer = 0;
@@ -100,362 +552,504 @@ void OctaveModbusWrapper::ProcessResponse(ModbusResponse *response){
       int32Buffer = 0;
       uint32Buffer = 0;
 
-      uint64_t auxDoubleBuffer = 0;
+      doubleBuffer = DecodeHGFEDCBA(registers);
+    }
+  }
+}
+#endif
 
-      // 64 bit values are split into HG FE DC BA bytes, according to the memory map
-      // Combine them into ABCDEFGH and save them to the buffer
-      auxDoubleBuffer |= static_cast<uint64_t>(response->getRegister(3) >> 8) << 48; // H
-      auxDoubleBuffer |= static_cast<uint64_t>(response->getRegister(3) & 0xFF) << 56; // G
 
-      auxDoubleBuffer |= static_cast<uint64_t>(response->getRegister(2) >> 8) << 32; // F
-      auxDoubleBuffer |= static_cast<uint64_t>(response->getRegister(2) & 0xFF) << 40; // E
+// Send a read request for a field and return right away
+// Returns 0 if the request was sent, use Poll() to check for its result
+// The value is then available with LastValue()
+uint8_t OctaveModbusWrapper::StartRead(OctaveField field, uint8_t slaveAddress){
+  return StartReadInto(field, &_lastValue, slaveAddress);
+}
 
-      auxDoubleBuffer |= static_cast<uint64_t>(response->getRegister(1) >> 8) << 16; // D
-      auxDoubleBuffer |= static_cast<uint64_t>(response->getRegister(1) & 0xFF) << 24; // C
 
-      auxDoubleBuffer |= static_cast<uint64_t>(response->getRegister(0) >> 8);  // B
-      auxDoubleBuffer |= static_cast<uint64_t>(response->getRegister(0) & 0xFF) << 8;  // A
+// Send a read request for a field and return right away, the value is decoded straight into output
+// output must hold the field's value type and stay valid until the request finishes
+uint8_t OctaveModbusWrapper::StartReadInto(OctaveField field, void* output, uint8_t slaveAddress){
+  const OctaveRegister info = OctaveRegisterMap::Get(field);
+  // Only Read Input Registers fields can be read
+  if (info.functionCode != 0x04) return 1; // Error code 1: Illegal Modbus Function
 
-      doubleBuffer = *reinterpret_cast<float64_t*>(&auxDoubleBuffer);
-    }
+  // Only one request can be on the bus at a time, even if it's answered from the cache
+  if (_requestStatus == OctaveRequestStatus::Pending) {
+    // Error code 3: Modbus channel busy
+    RecordBusy();
+    return 3;
+  }
+  if (CompleteFromCache(field, output, slaveAddress)) return 0;
+
+  uint8_t result = StartReadRegisters(info.startMemAddress, info.numValues, info.signedValueSizeinBits, slaveAddress);
+  // Set after starting, since starting a request clears the request field and output
+  if (result == 0) {
+    _requestField = field;
+    _output = output;
   }
+  return result;
 }
 
 
-// Read one or more Modbus registers in blocking mode
-uint8_t OctaveModbusWrapper::BlockingReadRegisters(uint8_t startMemAddress, uint8_t numValues, int8_t signedValueSizeinBits){
+// Send a write request for a field and return right away
+// Returns 0 if the request was sent, use Poll() to check for its result
+uint8_t OctaveModbusWrapper::StartWrite(OctaveField field, int16_t value, uint8_t slaveAddress){
+  const OctaveRegister info = OctaveRegisterMap::Get(field);
+  // Only Write Single Register fields can be written
+  if (info.functionCode != 0x06) return 1; // Error code 1: Illegal Modbus Function
+
+  uint8_t result = StartWriteSingleRegister(info.startMemAddress, value, slaveAddress);
+  // Set after starting, since starting a request clears the request field
+  if (result == 0) _requestField = field;
+  return result;
+}
+
+
+// Send a write request for a Write Multiple Registers field and return right away
+// values must have one register per value of the field
+uint8_t OctaveModbusWrapper::StartWriteMultiple(OctaveField field, const uint16_t* values, uint8_t slaveAddress){
+  const OctaveRegister info = OctaveRegisterMap::Get(field);
+  // Only Write Multiple Registers fields can be written
+  if (info.functionCode != 0x10) return 1; // Error code 1: Illegal Modbus Function
+
+  uint8_t result = StartWriteMultipleRegisters(info.startMemAddress, values, info.numValues, slaveAddress);
+  // Set after starting, since starting a request clears the request field
+  if (result == 0) _requestField = field;
+  return result;
+}
+
+
+// Send a read request for one or more Modbus registers and return right away
+// The values are decoded to LastValue(), values past its capacity are read but not decoded
+uint8_t OctaveModbusWrapper::StartReadRegisters(uint8_t startMemAddress, uint8_t numValues, int8_t signedValueSizeinBits, uint8_t slaveAddress){
+  // Only one request can be on the bus at a time
+  if (_requestStatus == OctaveRequestStatus::Pending) {
+    // Error code 3: Modbus channel busy
+    RecordBusy();
+    return 3;
+  }
+
   lastUsedFunctionCode = (0x04 << 8) + startMemAddress;
 
   // Calculate the number of registers from the number of values and their size
   // e.g.: 1 32-bit value occupies 2 registers (2 x 16bit)
   _numRegisterstoRead = numValues * abs(signedValueSizeinBits)/16;
+  // Decode up to the capacity of _lastValue
+  const uint8_t maxValues = sizeof(OctaveValue) * 8 / abs(signedValueSizeinBits);
+  _numValuesToDecode = numValues < maxValues ? numValues : maxValues;
   _signedResponseSizeinBits = signedValueSizeinBits;
+  _output = &_lastValue;
+  _requestField = OctaveField::Count;
+  _requestSlaveAddress = ResolveSlaveAddress(slaveAddress);
+  _requestQuantity = _numRegisterstoRead;
 
-  if (!_master.readInputRegisters(MODBUS_SLAVE_ADDRESS, startMemAddress, _numRegisterstoRead)) {
+  return SendRequest();
+}
+
+
+// Send a read request for a block of consecutive registers and return right away
+// output must have room for numRegisters values and stay valid until the request finishes
+uint8_t OctaveModbusWrapper::StartReadRawRegisters(uint8_t startMemAddress, uint8_t numRegisters, uint16_t* output, uint8_t slaveAddress){
+  if (_requestStatus == OctaveRequestStatus::Pending) {
     // Error code 3: Modbus channel busy
-    _lastModbusErrorCode = 3;
+    RecordBusy();
     return 3;
   }
 
-  // Get error code from called funcion
-  _lastModbusErrorCode = AwaitResponse();
-  return _lastModbusErrorCode;
+  lastUsedFunctionCode = (0x04 << 8) + startMemAddress;
+
+  _numRegisterstoRead = numRegisters;
+  _numValuesToDecode = numRegisters;
+  // Size 0 marks a raw read
+  _signedResponseSizeinBits = 0;
+  _output = output;
+  _requestField = OctaveField::Count;
+  _requestSlaveAddress = ResolveSlaveAddress(slaveAddress);
+  _requestQuantity = numRegisters;
+
+  return SendRequest();
 }
 
 
-// Write a single Modbus register in blocking mode
-uint8_t OctaveModbusWrapper::BlockingWriteSingleRegister(uint8_t memAddress, int16_t value){
+// Send a write request for a single Modbus register and return right away
+uint8_t OctaveModbusWrapper::StartWriteSingleRegister(uint8_t memAddress, int16_t value, uint8_t slaveAddress){
+  if (_requestStatus == OctaveRequestStatus::Pending) {
+    // Error code 3: Modbus channel busy
+    RecordBusy();
+    return 3;
+  }
+
   lastUsedFunctionCode = (0x06 << 8) + memAddress;
 
   // No registers need to be read for a write request
   _numRegisterstoRead = 0;
+  _numValuesToDecode = 0;
   _signedResponseSizeinBits = 16;
+  _output = nullptr;
+  _requestField = OctaveField::Count;
+  _requestSlaveAddress = ResolveSlaveAddress(slaveAddress);
+  _requestValue = value;
 
-  if (!_master.writeSingleRegister(MODBUS_SLAVE_ADDRESS, memAddress, value)) {
+  return SendRequest();
+}
+
+
+// Send a write request for a block of consecutive Modbus registers and return right away
+// The values are copied to the request frame, but must stay valid until the request finishes if it can be retried
+uint8_t OctaveModbusWrapper::StartWriteMultipleRegisters(uint8_t startMemAddress, const uint16_t* values, uint8_t numRegisters, uint8_t slaveAddress){
+  if (_requestStatus == OctaveRequestStatus::Pending) {
     // Error code 3: Modbus channel busy
-    _lastModbusErrorCode = 3;
+    RecordBusy();
     return 3;
   }
-  // Get error code from called funcion
-  _lastModbusErrorCode = AwaitResponse();
-  return _lastModbusErrorCode;
-}
 
+  lastUsedFunctionCode = (0x10 << 8) + startMemAddress;
 
-/******* Utilities ********/
+  // No registers need to be read for a write request
+  _numRegisterstoRead = 0;
+  _numValuesToDecode = 0;
+  _signedResponseSizeinBits = 16;
+  _output = nullptr;
+  _requestField = OctaveField::Count;
+  _requestSlaveAddress = ResolveSlaveAddress(slaveAddress);
+  _requestValues = values;
+  _requestQuantity = numRegisters;
 
-// Truncate 64-bit float64_t to 16 bits
-uint8_t truncateDoubleto16bits(float64_t &input, int16_t &output){
-  // Check for overflow or underflow
-  // if input > DEC16MAX
-  if (fp64_compare(input, fp64_atof(DEC16_MAX)) == 1) {
-    // Output the largest possible value to minimize the error
-    output = INT16_MAX;
-    // Error code 6: 16-bit Overflow
-    return 6;
-  }
-  // if input < DEC16MIN
-  else if (fp64_compare(input, fp64_atof(DEC16_MIN)) == -1) {
-    // Output the smallest possible value to minimize the error
-    output = INT16_MIN;
-    // Error code 7: 16-bit Underflow
-    return 7;
-  }
-  // If there were no Overflow or Underflow errors
-  else {
-    // Scale, then cast to int16
-    output = fp64_to_int16(fp64_mul(input, fp64_atof(SCALE_FACTOR)));
-    // No error
-    return 0;
-  }
+  return SendRequest();
 }
 
-// Truncate 64-bit float64_t to 32 bits
-uint8_t truncateDoubleto32bits(float64_t &input, int32_t &output){
-  // Check for overflow or underflow
-  // if input > DEC32MAX
-  if (input > strtod(DEC32_MAX, nullptr)) {
-    // Output the largest possible value to minimize the error
-    output = INT32_MAX;
-    // Error code 8: 32-bit Overflow
-    return 8;
-  }
-  // if input < DEC32MIN
-  else if (fp64_compare(input, fp64_atof(DEC32_MIN)) == -1) {
-    // Output the smallest possible value to minimize the error
-    output = INT32_MIN;
-    // Error code 9: 32-bit Underflow
-    return 9;
-  }
-  // If there were no Overflow or Underflow errors
-  else {
-    // Scale, then cast to int16
-    output = fp64_to_int32(fp64_mul(input, fp64_atof(SCALE_FACTOR)));
 
-    // Re-check for over/underflow in the sign bit, since fp64_compare doesn't work properly with
-    // numbers slightly greater/smaller than DEC32_MAX/MIN
+// Send the first attempt of the request set up by a Start function, with the policy of the request
+// Returns 0 if it was sent, or error code 3 if the Modbus master is busy
+uint8_t OctaveModbusWrapper::SendRequest(){
+  // A policy set for the next request replaces the instance's one for this request only
+  _activePolicy = _nextPolicyValid ? _nextPolicy : _policy;
+  _nextPolicyValid = false;
 
-    // If the signs match
-    if ((output > 0 && input > 0) || (output < 0 && input < 0) || (output == input)){
-      // No error
-      return 0;
-    }
+  // Non-idempotent requests are sent once, e.g. a repeated SystemReset would reset the meter twice
+  bool idempotent = lastUsedFunctionCode != OctaveRegisterMap::FunctionCode(OctaveField::SystemReset);
+  _retriesLeft = idempotent ? _activePolicy.retries : 0;
+  _retryBackoffMillis = _activePolicy.backoffMillis;
+  _waitingRetry = false;
 
-    // If the signs don't match, there was an error
-    else {
-      // If the input had a negative sign
-      if (fp64_signbit(input) != 0){
-        // If the input was -0.0, special case
-        if (fp64_compare(fp64_abs(input), fp64_atof("0.0")) == 0) {
-          // Remove the sign, the truncation is then complete
-          output = fp64_atof("0.0");
-          // No error
-          return 0;
-        }
-        // If the input was a negative number
-        else {
-          // Output the smallest possible value to minimize the error
-          output = INT32_MIN;
-          // Error code 9: 32-bit Underflow
-          return 9;
-        }
-      }
-      // If the input had a "positive" sign
-      else {
-        // Output the largest possible value to minimize the error
-        output = INT32_MAX;
-        // Error code 8: 32-bit Overflow
-        return 8;
-      }
-    }
+  if (!TransmitRequest()) {
+    // Error code 3: Modbus channel busy
+    _lastModbusErrorCode = 3;
+    RecordBusy();
+    return 3;
   }
+
+  _requestStatus = OctaveRequestStatus::Pending;
+  return 0;
 }
 
 
-/****** Octave Modbus Requests ******/
-// Parameter format: start address in the Modbus memory map, number of values to request, signed value size in bits
-uint8_t OctaveModbusWrapper::ReadAlarms(int16_t* output) {
-  uint8_t result = BlockingReadRegisters(0x0, 1, 16);
-  *output = int16Buffer[0];
-  return result;
-}
+// Send the frame of the current request after the inter-frame gap, for the first attempt or a retry
+// Returns false if the Modbus master is busy
+bool OctaveModbusWrapper::TransmitRequest(){
+  // Modbus RTU frames must be separated by a silent interval
+  uint32_t gapMicros = _activePolicy.interFrameGapMicros == OCTAVE_GAP_AUTO ? _autoGapMicros : _activePolicy.interFrameGapMicros;
+  uint32_t silentMicros = micros() - _lastFrameEndMicros;
+  if (silentMicros < gapMicros) {
+    // delayMicroseconds() takes 16 bits on the AVR, and is only accurate up to 16383 us
+    uint32_t waitMicros = gapMicros - silentMicros;
+    delay(waitMicros / 1000);
+    delayMicroseconds(waitMicros % 1000);
+  }
 
-uint8_t OctaveModbusWrapper::SerialNumber(int16_t* output) {
-  uint8_t result = BlockingReadRegisters(0x1, 16, 16);
-  memcpy(output, int16Buffer, 16 * sizeof(int16_t));
-  return result;
-}
+  _master.setTimeout(_activePolicy.responseTimeoutMillis);
+
+  uint8_t memAddress = lastUsedFunctionCode & 0xFF;
+  bool sent;
+  // Size of the request frame, with the slave address, function code, address, quantity or value and CRC
+  uint8_t frameBytes = 8;
+  switch (lastUsedFunctionCode >> 8){
+    case 0x04:
+      sent = _master.readInputRegisters(_requestSlaveAddress, memAddress, _requestQuantity);
+      break;
+    case 0x06:
+      sent = _master.writeSingleRegister(_requestSlaveAddress, memAddress, _requestValue);
+      break;
+    default: // 0x10
+      sent = _master.writeMultipleRegisters(_requestSlaveAddress, memAddress, _requestValues, _requestQuantity);
+      // Plus the byte count and the values
+      frameBytes = 9 + 2 * _requestQuantity;
+      break;
+  }
 
-uint8_t OctaveModbusWrapper::ReadWeekday(int16_t* output) {
-  uint8_t result = BlockingReadRegisters(0x11, 1, 16);
-  *output = int16Buffer[0];
-  return result;
+  if (sent) RecordRequest(frameBytes);
+  return sent;
 }
 
-uint8_t OctaveModbusWrapper::ReadDay(int16_t* output) {
-  uint8_t result = BlockingReadRegisters(0x12, 1, 16);
-  *output = int16Buffer[0];
-  return result;
-}
 
-uint8_t OctaveModbusWrapper::ReadMonth(int16_t* output) {
-	uint8_t result = BlockingReadRegisters(0x13, 1, 16);
-  *output = int16Buffer[0];
-  return result;
+// Read a field in blocking mode, the value is then available with LastValue()
+uint8_t OctaveModbusWrapper::BlockingRead(OctaveField field, uint8_t slaveAddress){
+  return BlockingReadInto(field, &_lastValue, slaveAddress);
 }
 
-uint8_t OctaveModbusWrapper::ReadYear(int16_t* output) {
-	uint8_t result = BlockingReadRegisters(0x14, 1, 16);
-  *output = int16Buffer[0];
-  return result;
-}
 
-uint8_t OctaveModbusWrapper::ReadHours(int16_t* output) {
-	uint8_t result = BlockingReadRegisters(0x15, 1, 16);
-  *output = int16Buffer[0];
-  return result;
-}
+// Read a field in blocking mode, decoding the value straight into output
+uint8_t OctaveModbusWrapper::BlockingReadInto(OctaveField field, void* output, uint8_t slaveAddress){
+  uint8_t result = StartReadInto(field, output, slaveAddress);
+  if (result != 0) return result;
 
-uint8_t OctaveModbusWrapper::ReadMinutes(int16_t* output) {
-	uint8_t result = BlockingReadRegisters(0x16, 1, 16);
-  *output = int16Buffer[0];
-  return result;
+  // Get error code from called funcion
+  return AwaitResponse();
 }
 
-uint8_t OctaveModbusWrapper::VolumeUnit(int16_t* output) {
-	uint8_t result = BlockingReadRegisters(0x17, 1, 16);
-  *output = int16Buffer[0];
-  return result;
-}
 
-uint8_t OctaveModbusWrapper::ForwardVolume_uint32(uint32_t* output){
-  uint8_t result = BlockingReadRegisters(0x36, 1, 32);
-  *output = uint32Buffer;
-  return result;
-}
+// Write a field in blocking mode
+uint8_t OctaveModbusWrapper::BlockingWrite(OctaveField field, int16_t value, uint8_t slaveAddress){
+  uint8_t result = StartWrite(field, value, slaveAddress);
+  if (result != 0) return result;
 
-uint8_t OctaveModbusWrapper::ForwardVolume_double(float64_t* output){
-  // unsignedValueSizeinBits == -64, all 64-bit (float64_t) values are signed
-  uint8_t result = BlockingReadRegisters(0x18, 1, -64);
-  *output = doubleBuffer;
-  return result;
+  // Get error code from called funcion
+  return AwaitResponse();
 }
 
-uint8_t OctaveModbusWrapper::ReverseVolume_uint32(uint32_t* output){
-  uint8_t result = BlockingReadRegisters(0x3A, 1, 32);
-  *output = uint32Buffer;
-  return result;
-}
 
-uint8_t OctaveModbusWrapper::ReverseVolume_double(float64_t* output){
-  // unsignedValueSizeinBits == -64, all 64-bit (float64_t) values are signed
-  uint8_t result = BlockingReadRegisters(0x20, 1, -64);
-  *output = doubleBuffer;
-  return result;
+// Read one or more Modbus registers in blocking mode
+uint8_t OctaveModbusWrapper::BlockingReadRegisters(uint8_t startMemAddress, uint8_t numValues, int8_t signedValueSizeinBits, uint8_t slaveAddress){
+  uint8_t result = StartReadRegisters(startMemAddress, numValues, signedValueSizeinBits, slaveAddress);
+  if (result != 0) return result;
+
+  // Get error code from called funcion
+  return AwaitResponse();
 }
 
 
-uint8_t OctaveModbusWrapper::ReadVolumeResIndex(int16_t* output){
-	uint8_t result = BlockingReadRegisters(0x28, 1, 16);
-  *output = int16Buffer[0];
-  return result;
-}
+// Write a single Modbus register in blocking mode
+uint8_t OctaveModbusWrapper::BlockingWriteSingleRegister(uint8_t memAddress, int16_t value, uint8_t slaveAddress){
+  uint8_t result = StartWriteSingleRegister(memAddress, value, slaveAddress);
+  if (result != 0) return result;
 
-uint8_t OctaveModbusWrapper::SignedCurrentFlow_int32(int32_t* output){
-  uint8_t result = BlockingReadRegisters(0x3E, 1, -32);
-  *output = int32Buffer;
-  return result;
+  // Get error code from called funcion
+  return AwaitResponse();
 }
 
-uint8_t OctaveModbusWrapper::SignedCurrentFlow_double(float64_t* output){
-  // unsignedValueSizeinBits == -64, all 64-bit (float64_t) values are signed
-  uint8_t result = BlockingReadRegisters(0x29, 1, -64);
-  *output = doubleBuffer;
-  return result;
-}
 
-uint8_t OctaveModbusWrapper::ReadFlowResIndex(int16_t* output){
-	uint8_t result = BlockingReadRegisters(0x31, 1, 16);
-  *output = int16Buffer[0];
-  return result;
-}
+// Read a block of consecutive registers in blocking mode, without decoding them
+// output must have room for numRegisters values
+uint8_t OctaveModbusWrapper::BlockingReadRawRegisters(uint8_t startMemAddress, uint8_t numRegisters, uint16_t* output, uint8_t slaveAddress){
+  uint8_t result = StartReadRawRegisters(startMemAddress, numRegisters, output, slaveAddress);
+  if (result != 0) return result;
 
-uint8_t OctaveModbusWrapper::FlowUnit(int16_t* output){
-	uint8_t result = BlockingReadRegisters(0x32, 1, 16);
-  *output = int16Buffer[0];
-  return result;
+  // Get error code from called funcion
+  return AwaitResponse();
 }
 
-uint8_t OctaveModbusWrapper::FlowDirection(int16_t* output){
-	uint8_t result = BlockingReadRegisters(0x33, 1, 16);
-  *output = int16Buffer[0];
-  return result;
-}
 
-uint8_t OctaveModbusWrapper::TemperatureValue(int16_t* output){
-	uint8_t result = BlockingReadRegisters(0x34, 1, 16);
-  *output = int16Buffer[0];
-  return result;
-}
+// Write a block of consecutive Modbus registers in blocking mode
+uint8_t OctaveModbusWrapper::BlockingWriteMultipleRegisters(uint8_t startMemAddress, const uint16_t* values, uint8_t numRegisters, uint8_t slaveAddress){
+  uint8_t result = StartWriteMultipleRegisters(startMemAddress, values, numRegisters, slaveAddress);
+  if (result != 0) return result;
 
-uint8_t OctaveModbusWrapper::TemperatureUnit(int16_t* output){
-	uint8_t result = BlockingReadRegisters(0x35, 1, 16);
-  *output = int16Buffer[0];
-  return result;
+  // Get error code from called funcion
+  return AwaitResponse();
 }
 
-uint8_t OctaveModbusWrapper::NetSignedVolume_int32(int32_t* output){
-  uint8_t result = BlockingReadRegisters(0x52, 1, -32);
-  *output = int32Buffer;
-  return result;
-}
 
-uint8_t OctaveModbusWrapper::NetSignedVolume_double(float64_t* output){
-  // unsignedValueSizeinBits == -64, all 64-bit (float64_t) values are signed
-  uint8_t result = BlockingReadRegisters(0x42, 1, -64);
-  *output = doubleBuffer;
-  return result;
-}
+/******* Utilities ********/
 
-uint8_t OctaveModbusWrapper::NetUnsignedVolume_uint32(uint32_t* output){
-  uint8_t result = BlockingReadRegisters(0x56, 1, 32);
-  *output = uint32Buffer;
-  return result;
+// Truncate 64-bit float64_t to 16 bits
+// The limits and scale factor are parsed at compile time, and the input is scaled on its IEEE-754 bits
+uint8_t truncateDoubleto16bits(float64_t &input, int16_t &output){
+  // fp64lib values are the IEEE-754 bits themselves
+  uint64_t bits = input;
+  int32_t scaled;
+
+  switch (ScaleAndTruncate(bits, scaleFactorValue, dec16MinScaled, dec16MaxScaled, scaled)) {
+    case TruncationResult::Overflow:
+      // Output the largest possible value to minimize the error
+      output = INT16_MAX;
+      // Error code 6: 16-bit Overflow
+      return 6;
+    case TruncationResult::Underflow:
+      // Output the smallest possible value to minimize the error
+      output = INT16_MIN;
+      // Error code 7: 16-bit Underflow
+      return 7;
+    default:
+      output = static_cast<int16_t>(scaled);
+      // No error
+      return 0;
+  }
 }
 
-uint8_t OctaveModbusWrapper::NetUnsignedVolume_double(float64_t* output){
-  // unsignedValueSizeinBits == -64, all 64-bit (float64_t) values are signed
-  uint8_t result = BlockingReadRegisters(0x4A, 1, -64);
-  *output = doubleBuffer;
-  return result;
+// Truncate 64-bit float64_t to 32 bits
+// The limits and scale factor are parsed at compile time, and the input is scaled on its IEEE-754 bits
+uint8_t truncateDoubleto32bits(float64_t &input, int32_t &output){
+  // fp64lib values are the IEEE-754 bits themselves
+  uint64_t bits = input;
+
+  switch (ScaleAndTruncate(bits, scaleFactorValue, dec32MinScaled, dec32MaxScaled, output)) {
+    case TruncationResult::Overflow:
+      // Output the largest possible value to minimize the error
+      output = INT32_MAX;
+      // Error code 8: 32-bit Overflow
+      return 8;
+    case TruncationResult::Underflow:
+      // Output the smallest possible value to minimize the error
+      output = INT32_MIN;
+      // Error code 9: 32-bit Underflow
+      return 9;
+    default:
+      // No error
+      return 0;
+  }
 }
 
-uint8_t OctaveModbusWrapper::SystemReset(){
-	return BlockingWriteSingleRegister(0x0, 0x1);
+
+/****** Octave Modbus Requests ******/
+// The rest of the requests are generated from the register map in the header
+
+// value must be within 0 to 8, see table
+uint8_t OctaveModbusWrapper::WriteVolumeResIndex(uint8_t value){
+  if (value > 8) {
+    return 10; // Error code 10: Invalid Resolution Index
+  }
+	return Write<OctaveField::WriteVolumeResIndex>(value);
 }
 
-// value must be within 1 to 7
-uint8_t OctaveModbusWrapper::WriteWeekday(uint8_t value){
-	return BlockingWriteSingleRegister(0x1, value);
+// value must be within 0 to 8, see table
+uint8_t OctaveModbusWrapper::WriteFlowResIndex(uint8_t value){
+  if (value > 8) {
+    return 10; // Error code 10: Invalid Resolution Index
+  }
+	return Write<OctaveField::WriteFlowResIndex>(value);
 }
 
-// value must be within 1 to 31
-uint8_t OctaveModbusWrapper::WriteDay(uint8_t value){
-	return BlockingWriteSingleRegister(0x2, value);
+
+// Read the whole meter clock in a single Read Input Registers request
+uint8_t OctaveModbusWrapper::ReadClock(OctaveDateTime* output, uint8_t slaveAddress){
+  uint8_t result = BlockingRead(OctaveField::ReadClock, slaveAddress);
+  if (result != 0) return result;
+
+  // Registers 0x11 to 0x16
+  output->weekday = _lastValue.int16[0];
+  output->day = _lastValue.int16[1];
+  output->month = _lastValue.int16[2];
+  output->year = _lastValue.int16[3];
+  output->hours = _lastValue.int16[4];
+  output->minutes = _lastValue.int16[5];
+  return 0;
 }
 
-// value must be within 1 to 12
-uint8_t OctaveModbusWrapper::WriteMonth(uint8_t value){
-	return BlockingWriteSingleRegister(0x3, value);
+
+// Write the whole meter clock in a single Write Multiple Registers request
+uint8_t OctaveModbusWrapper::WriteClock(const OctaveDateTime &dateTime, uint8_t slaveAddress){
+  // Validate everything before sending, so the clock is never left half-written
+  if (!IsValidDateTime(dateTime)) {
+    return 11; // Error code 11: Invalid Date or Time
+  }
+
+  // Holding registers 0x1 to 0x6
+  const uint16_t values[6] = {
+    static_cast<uint16_t>(dateTime.weekday), static_cast<uint16_t>(dateTime.day),
+    static_cast<uint16_t>(dateTime.month), static_cast<uint16_t>(dateTime.year),
+    static_cast<uint16_t>(dateTime.hours), static_cast<uint16_t>(dateTime.minutes)
+  };
+  uint8_t result = StartWriteMultiple(OctaveField::WriteClock, values, slaveAddress);
+  if (result != 0) return result;
+
+  // Get error code from called funcion
+  return AwaitResponse();
 }
 
-// value must be within 14 to 99
-uint8_t OctaveModbusWrapper::WriteYear(uint8_t value){
-	return BlockingWriteSingleRegister(0x4, value);
+
+// Check the date and time against the ranges of the clock registers
+// The day must also exist in the month, years 14 to 99 are 2014 to 2099
+bool OctaveModbusWrapper::IsValidDateTime(const OctaveDateTime &dateTime){
+  static const uint8_t daysInMonth[12] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+  if (dateTime.weekday < 1 || dateTime.weekday > 7) return false;
+  if (dateTime.month < 1 || dateTime.month > 12) return false;
+  if (dateTime.year < 14 || dateTime.year > 99) return false;
+  if (dateTime.hours < 0 || dateTime.hours > 23) return false;
+  if (dateTime.minutes < 0 || dateTime.minutes > 59) return false;
+
+  // Every 4th year is a leap year within 2014 to 2099
+  uint8_t days = daysInMonth[dateTime.month - 1];
+  if (dateTime.month == 2 && dateTime.year % 4 != 0) days = 28;
+  return dateTime.day >= 1 && dateTime.day <= days;
 }
 
-// value must be within 0 to 23
-uint8_t OctaveModbusWrapper::WriteHours(uint8_t value){
-	return BlockingWriteSingleRegister(0x5, value);
+
+// Read and decode every input register of the meter
+// The register range is split into as few requests as the frame size allows,
+// usually a single one
+uint8_t OctaveModbusWrapper::ReadSnapshot(OctaveSnapshot* output, uint8_t slaveAddress){
+  uint16_t registers[SNAPSHOT_NUM_REGISTERS];
+
+  for (uint8_t offset = 0; offset < SNAPSHOT_NUM_REGISTERS; offset += MODBUS_MAX_READ_REGISTERS){
+    uint8_t numRegisters = SNAPSHOT_NUM_REGISTERS - offset;
+    if (numRegisters > MODBUS_MAX_READ_REGISTERS) numRegisters = MODBUS_MAX_READ_REGISTERS;
+
+    uint8_t result = BlockingReadRawRegisters(SNAPSHOT_START_ADDRESS + offset, numRegisters, registers + offset, slaveAddress);
+    if (result != 0) return result;
+  }
+
+  DecodeSnapshot(registers, output);
+  return 0;
 }
 
-// value must be within 0 to 59
-uint8_t OctaveModbusWrapper::WriteMinutes(uint8_t value){
-	return BlockingWriteSingleRegister(0x6, value);
+
+// Decode a snapshot from the SNAPSHOT_NUM_REGISTERS raw registers starting at SNAPSHOT_START_ADDRESS
+void OctaveModbusWrapper::DecodeSnapshot(const uint16_t* registers, OctaveSnapshot* output){
+  // Decode every value from its offset in the memory map
+  output->alarms = registers[0x00];
+  memcpy(output->serialNumber, &registers[0x01], 16 * sizeof(int16_t));
+  output->weekday = registers[0x11];
+  output->day = registers[0x12];
+  output->month = registers[0x13];
+  output->year = registers[0x14];
+  output->hours = registers[0x15];
+  output->minutes = registers[0x16];
+  output->volumeUnit = registers[0x17];
+  output->forwardVolume = DecodeHGFEDCBA(&registers[0x18]);
+  output->reverseVolume = DecodeHGFEDCBA(&registers[0x20]);
+  output->volumeResIndex = registers[0x28];
+  output->signedCurrentFlow = DecodeHGFEDCBA(&registers[0x29]);
+  output->flowResIndex = registers[0x31];
+  output->flowUnit = registers[0x32];
+  output->flowDirection = registers[0x33];
+  output->temperatureValue = registers[0x34];
+  output->temperatureUnit = registers[0x35];
+  output->forwardVolume_uint32 = DecodeABCD(&registers[0x36]);
+  output->reverseVolume_uint32 = DecodeABCD(&registers[0x3A]);
+  output->signedCurrentFlow_int32 = static_cast<int32_t>(DecodeABCD(&registers[0x3E]));
+  output->netSignedVolume = DecodeHGFEDCBA(&registers[0x42]);
+  output->netUnsignedVolume = DecodeHGFEDCBA(&registers[0x4A]);
+  output->netSignedVolume_int32 = static_cast<int32_t>(DecodeABCD(&registers[0x52]));
+  output->netUnsignedVolume_uint32 = DecodeABCD(&registers[0x56]);
 }
 
-// value must be within 0 to 8, see table
-uint8_t OctaveModbusWrapper::WriteVolumeResIndex(uint8_t value){
-  if (value > 8) {
-    return 10; // Error code 10: Invalid Resolution Index
+
+// Decode numSnapshots raw snapshots stored back to back, e.g. one per meter of a bus
+void OctaveModbusWrapper::DecodeSnapshots(const uint16_t* registers, OctaveSnapshot* output, uint16_t numSnapshots){
+  for (uint16_t i = 0; i < numSnapshots; i++){
+    DecodeSnapshot(&registers[i * SNAPSHOT_NUM_REGISTERS], &output[i]);
   }
-	return BlockingWriteSingleRegister(0x7, value);
 }
 
-// value must be within 0 to 8, see table
-uint8_t OctaveModbusWrapper::WriteFlowResIndex(uint8_t value){
-  if (value > 8) {
-    return 10; // Error code 10: Invalid Resolution Index
+
+// Decode the value of a readable field from its raw registers, e.g. from a block read with StartReadRawRegisters
+void OctaveModbusWrapper::DecodeField(OctaveField field, const uint16_t* registers, OctaveValue* output){
+  const OctaveRegister reg = OctaveRegisterMap::Get(field);
+
+  switch (reg.signedValueSizeinBits){
+    case 16:
+      for (uint8_t i = 0; i < reg.numValues; i++) DecodeValue(&registers[i], &output->int16[i]);
+      break;
+    case 32:
+      DecodeValue(registers, &output->uint32);
+      break;
+    case -32:
+      DecodeValue(registers, &output->int32);
+      break;
+    default: // -64
+      DecodeValue(registers, &output->float64);
+      break;
   }
-	return BlockingWriteSingleRegister(0x8, value);
-}
\ No newline at end of file
+}
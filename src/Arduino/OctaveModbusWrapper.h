@@ -4,17 +4,71 @@
 #include <Arduino.h>
 #include "../IndustrialShields/ModbusRTUMaster.h"
 #include <stdint.h>
-#include <ArduinoSTL.h>
-#include <map>
 #include "ParamTables.h"
+#include "RegisterDecoding.h"
+#include "FixedPoint.h"
 #include <fp64lib.h>
 
 /****** Settings ******/
+// Default slave address, can be changed per instance or per request
 #define MODBUS_SLAVE_ADDRESS 1
 
+// Placeholder for the slaveAddress parameter of the requests, selects the instance's address
+// 255 is outside the valid slave address range
+#define INSTANCE_SLAVE_ADDRESS 0xFF
+
 // Bit indices to check for alarms
 const uint8_t alarmsIndices[] = {0, 5, 7, 11, 12, 13};
 
+// Cache decoded values per field, see SetCacheTTL()
+// Disabled by default on AVR, since it takes about 1 kB of RAM
+#ifndef OCTAVE_FIELD_CACHE
+#define OCTAVE_FIELD_CACHE 0
+#endif
+// Cache TTL that keeps values until they are invalidated by a write
+#define CACHE_TTL_FOREVER 0xFFFFFFFF
+
+// Count requests, errors and bytes on the bus and keep round-trip latency histograms, see BusStats()
+// With 0, the statistics and the code that updates them are compiled out
+// Disabled by default on AVR, since they take about 250 bytes of RAM per instance
+#ifndef OCTAVE_BUS_STATS
+#define OCTAVE_BUS_STATS 0
+#endif
+// Round-trip latency histograms: the first bucket counts responses under OCTAVE_LATENCY_FIRST_BUCKET_MICROS,
+// each next bucket doubles the bound, and the last one counts the rest, i.e. 1 ms, 2 ms, 4 ms... up to 1 s and over
+#define OCTAVE_LATENCY_BUCKETS 12
+#define OCTAVE_LATENCY_FIRST_BUCKET_MICROS 1000
+// Function codes with their own latency histogram: 04, 06 and 16 (0x10)
+#define OCTAVE_STATS_FUNCTION_CODES 3
+
+// Default request policy, see OctaveRequestPolicy and SetRequestPolicy()
+#ifndef OCTAVE_RESPONSE_TIMEOUT_MS
+#define OCTAVE_RESPONSE_TIMEOUT_MS 1000
+#endif
+#ifndef OCTAVE_REQUEST_RETRIES
+#define OCTAVE_REQUEST_RETRIES 0
+#endif
+#ifndef OCTAVE_RETRY_BACKOFF_MS
+#define OCTAVE_RETRY_BACKOFF_MS 50
+#endif
+// Inter-frame gap computed from the baud rate given to begin(): 3.5 characters, or 1750 us above 19200 baud
+#define OCTAVE_GAP_AUTO 0xFFFF
+
+// Line settings probed by AutoBaud(), after the current rate, every rate at each parity
+#define OCTAVE_AUTOBAUD_RATES 2400, 4800, 9600, 19200, 38400, 57600, 115200
+#define OCTAVE_AUTOBAUD_CONFIGS SERIAL_8N1, SERIAL_8E1, SERIAL_8O1, SERIAL_8N2
+// Response timeout and retries of each probe
+#ifndef OCTAVE_AUTOBAUD_TIMEOUT_MS
+#define OCTAVE_AUTOBAUD_TIMEOUT_MS 100
+#endif
+#define OCTAVE_AUTOBAUD_RETRIES 1
+
+// Also copy decoded reads to the int16Buffer, int32Buffer, uint32Buffer and doubleBuffer members,
+// for code written against older versions. Reads decode straight into the caller's storage otherwise
+#ifndef OCTAVE_LEGACY_BUFFERS
+#define OCTAVE_LEGACY_BUFFERS 0
+#endif
+
 // Scale factor for two decimal places
 // Used for number compression
 #define SCALE_FACTOR "100.0"
@@ -26,106 +80,479 @@ const uint8_t alarmsIndices[] = {0, 5, 7, 11, 12, 13};
 #define DEC32_MAX "21474836.47"
 #define DEC32_MIN "-21474836.48"
 
+// Settings above, parsed at compile time
+constexpr int64_t scaleFactorValue = ParseScaledDecimal(SCALE_FACTOR, 1);
+constexpr int64_t dec16MaxScaled = ParseScaledDecimal(DEC16_MAX, scaleFactorValue);
+constexpr int64_t dec16MinScaled = ParseScaledDecimal(DEC16_MIN, scaleFactorValue);
+constexpr int64_t dec32MaxScaled = ParseScaledDecimal(DEC32_MAX, scaleFactorValue);
+constexpr int64_t dec32MinScaled = ParseScaledDecimal(DEC32_MIN, scaleFactorValue);
+static_assert(IsExactScaledDecimal(SCALE_FACTOR, 1) && scaleFactorValue > 0 && scaleFactorValue <= MAX_FIXED_POINT_SCALE,
+              "SCALE_FACTOR must be a positive integer up to MAX_FIXED_POINT_SCALE");
+static_assert(IsExactScaledDecimal(DEC16_MAX, scaleFactorValue) && IsExactScaledDecimal(DEC16_MIN, scaleFactorValue)
+              && IsExactScaledDecimal(DEC32_MAX, scaleFactorValue) && IsExactScaledDecimal(DEC32_MIN, scaleFactorValue),
+              "The limits must have no more decimal places than SCALE_FACTOR");
+static_assert(dec16MinScaled >= INT16_MIN && dec16MaxScaled <= INT16_MAX, "DEC16 limits must fit in 16 bits once scaled");
+static_assert(dec32MinScaled >= INT32_MIN && dec32MaxScaled <= INT32_MAX, "DEC32 limits must fit in 32 bits once scaled");
+
+// Maximum number of registers per Read Input Registers (04) request,
+// limited by the 256-byte Modbus RTU frame
+#define MODBUS_MAX_READ_REGISTERS 125
+
+// Input register range covered by a snapshot read, from the alarms (0x00)
+// to the end of the 32-bit net unsigned volume (0x59)
+#define SNAPSHOT_START_ADDRESS 0x00
+#define SNAPSHOT_NUM_REGISTERS 90
+
+// Number compression: multiply by SCALE_FACTOR and truncate toward zero
+// Return error codes 6 and 7, or 8 and 9, if the truncated input is above the DEC*_MAX or below the DEC*_MIN limits,
+// with the largest or smallest possible output
+uint8_t truncateDoubleto16bits(float64_t &input, int16_t &output);
+uint8_t truncateDoubleto32bits(float64_t &input, int32_t &output);
+
+// Decoded copy of every input register of the meter, read in as few requests as possible
+struct OctaveSnapshot {
+    int16_t alarms;
+    int16_t serialNumber[16];
+    int16_t weekday;
+    int16_t day;
+    int16_t month;
+    int16_t year;
+    int16_t hours;
+    int16_t minutes;
+    int16_t volumeUnit;
+    float64_t forwardVolume;
+    float64_t reverseVolume;
+    int16_t volumeResIndex;
+    float64_t signedCurrentFlow;
+    int16_t flowResIndex;
+    int16_t flowUnit;
+    int16_t flowDirection;
+    int16_t temperatureValue;
+    int16_t temperatureUnit;
+    uint32_t forwardVolume_uint32;
+    uint32_t reverseVolume_uint32;
+    int32_t signedCurrentFlow_int32;
+    float64_t netSignedVolume;
+    float64_t netUnsignedVolume;
+    int32_t netSignedVolume_int32;
+    uint32_t netUnsignedVolume_uint32;
+};
+
+// Date and time of the meter clock, in the order of its registers
+struct OctaveDateTime {
+    int16_t weekday;    // 1 to 7
+    int16_t day;        // 1 to 31, must exist in the month
+    int16_t month;      // 1 to 12
+    int16_t year;       // 14 to 99, for 2014 to 2099
+    int16_t hours;      // 0 to 23
+    int16_t minutes;    // 0 to 59
+};
+
+// Decoded value of an asynchronous read, the member in use depends on the field
+union OctaveValue {
+    int16_t int16[16];
+    int32_t int32;
+    uint32_t uint32;
+    float64_t float64;
+};
+
+// Round-trip latency of the responses to one Modbus function code, from the request to the end of its response
+struct OctaveLatencyStats {
+    uint8_t functionCode;
+    // Responses received, including exceptions, timeouts aren't responses
+    uint32_t responses;
+    uint32_t minMicros;
+    uint32_t maxMicros;
+    uint64_t totalMicros;
+    // See OctaveModbusWrapper::LatencyBucketMicros()
+    uint32_t histogram[OCTAVE_LATENCY_BUCKETS];
+};
+
+// Bus statistics of an OctaveModbusWrapper, see BusStats()
+struct OctaveBusStats {
+    // Requests sent on the bus, cached reads aren't sent
+    uint32_t requests;
+    // Requests without a valid response, error code 5, including the attempts that were retried
+    uint32_t timeouts;
+    // Requests sent again after a timeout, each one is also counted in requests
+    uint32_t retries;
+    // Exception responses, exceptions[0] counts code 1 (Illegal Function) to exceptions[3] for code 4 (Slave Device Failure)
+    uint32_t exceptions[4];
+    // Requests refused with error code 3 because another one was on the bus
+    uint32_t busyRejections;
+    // Bytes of the request and response frames, including addresses and CRCs
+    uint32_t bytesSent;
+    uint32_t bytesReceived;
+    // One entry per function code, 04, 06 and 16 (0x10) in that order
+    OctaveLatencyStats latency[OCTAVE_STATS_FUNCTION_CODES];
+};
+
+// How a request is sent and retried, see SetRequestPolicy() and SetNextRequestPolicy()
+// Only timeouts are retried, since an exception response would be the same again,
+// and non-idempotent requests, i.e. SystemReset, are never retried
+struct OctaveRequestPolicy {
+    // Time to wait for the response, or for the rest of it, before the attempt times out
+    uint16_t responseTimeoutMillis = OCTAVE_RESPONSE_TIMEOUT_MS;
+    // Minimum silence on the bus before a request frame, or OCTAVE_GAP_AUTO
+    uint16_t interFrameGapMicros = OCTAVE_GAP_AUTO;
+    // Attempts after the first one, 0 to never retry
+    uint8_t retries = OCTAVE_REQUEST_RETRIES;
+    // Wait before the first retry, doubled before each next one
+    uint16_t backoffMillis = OCTAVE_RETRY_BACKOFF_MS;
+};
+
+// Result of AutoBaud(), with the report of a migration to a target baud rate
+// The Octave's line settings can only be changed with the NFC reader, the report tells whether the
+// meter can be moved to the target rate and what it would gain
+struct OctaveAutoBaudResult {
+    // Line settings the meter answered at, or the ones restored if it never answered
+    uint32_t baudrate;
+    uint32_t config;
+    // Probe frames sent, including retries
+    uint8_t probes;
+
+    // Target rate, 0 if none was given
+    uint32_t targetBaudrate;
+    // The meter answered, and the target is one of OCTAVE_AUTOBAUD_RATES, above the current rate
+    bool canMigrate;
+    // Line time of a snapshot read, request and response, at the current rate and at the target rate
+    uint32_t snapshotLineMicros;
+    uint32_t targetSnapshotLineMicros;
+};
+
+// Restarts the Modbus serial port with other line settings, for AutoBaud()
+typedef void (*OctaveLineSettingsCallback)(uint32_t baudrate, uint32_t config, void *context);
+
+// State of the current Modbus request
+enum class OctaveRequestStatus : uint8_t {
+    Idle,       // No request was started
+    Pending,    // Waiting for the slave response
+    Done        // Finished, the error code and value are available
+};
+
+// Writes telemetry records, see Telemetry.h
+class TelemetryEncoder;
+
+// Called when an asynchronous read finishes, value is only valid if errorCode is 0
+typedef void (*OctaveReadCallback)(OctaveField field, uint8_t errorCode, const OctaveValue &value, void *context);
+
 class OctaveModbusWrapper {
     public:
         // Initializer
-        explicit OctaveModbusWrapper(HardwareSerial &modbusSerial);
+        explicit OctaveModbusWrapper(HardwareSerial &modbusSerial, uint8_t slaveAddress = MODBUS_SLAVE_ADDRESS);
 
+        // Only starts the Modbus master, the name tables are constant, so a wake from deep sleep
+        // can read right away
         void begin(uint32_t baudrate = 2400);
-        // Initialize all name-to-code mappings
-        void InitMaps();
+
+        // Slave address used by requests that don't specify one
+        void SetSlaveAddress(uint8_t slaveAddress) { _slaveAddress = slaveAddress; }
+        uint8_t SlaveAddress() const { return _slaveAddress; }
+        // Slave address of the current request, or of the last one once it finished, e.g. in a read callback
+        uint8_t RequestSlaveAddress() const { return _requestSlaveAddress; }
 
         // Read the Modbus channel in blocking mode until a response is received or an error occurs
         uint8_t AwaitResponse();
-        // Processes the raw register values from the slave response and saves them to the buffers
+        // Decodes the registers of the slave response straight into the output of the current request
         void ProcessResponse(ModbusResponse *response);
         // Read one or more Modbus registers in blocking mode
-        uint8_t BlockingReadRegisters(uint8_t startMemAddress, uint8_t numValues, int8_t signedValueSizeinBits);
+        uint8_t BlockingReadRegisters(uint8_t startMemAddress, uint8_t numValues, int8_t signedValueSizeinBits, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
         // Write a single Modbus register in blocking mode
-        uint8_t BlockingWriteSingleRegister(uint8_t memAddress, int16_t value);
+        uint8_t BlockingWriteSingleRegister(uint8_t memAddress, int16_t value, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Read a block of consecutive registers in blocking mode, without decoding them
+        uint8_t BlockingReadRawRegisters(uint8_t startMemAddress, uint8_t numRegisters, uint16_t* output, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Write a block of consecutive Modbus registers in blocking mode
+        uint8_t BlockingWriteMultipleRegisters(uint8_t startMemAddress, const uint16_t* values, uint8_t numRegisters, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+
+        /****** Non-blocking requests ******/
+        // Send a read request for a field and return right away
+        uint8_t StartRead(OctaveField field, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Same, but the value is decoded straight into output, which must hold the field's value type
+        // and stay valid until the request finishes
+        uint8_t StartReadInto(OctaveField field, void* output, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        template <OctaveField Field>
+        uint8_t StartRead(typename OctaveFieldTraits<Field>::type* output, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS) {
+            static_assert(OctaveFieldTraits<Field>::readable, "Field is not readable");
+            return StartReadInto(Field, output, slaveAddress);
+        }
+        // Send a write request for a field and return right away
+        uint8_t StartWrite(OctaveField field, int16_t value, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Send a write request for a Write Multiple Registers field and return right away
+        uint8_t StartWriteMultiple(OctaveField field, const uint16_t* values, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Send a read, raw read, write or multiple write request and return right away
+        uint8_t StartReadRegisters(uint8_t startMemAddress, uint8_t numValues, int8_t signedValueSizeinBits, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        uint8_t StartReadRawRegisters(uint8_t startMemAddress, uint8_t numRegisters, uint16_t* output, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        uint8_t StartWriteSingleRegister(uint8_t memAddress, int16_t value, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        uint8_t StartWriteMultipleRegisters(uint8_t startMemAddress, const uint16_t* values, uint8_t numRegisters, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Check for the response of the current request without blocking
+        OctaveRequestStatus Poll();
+        // Set a function to call when a request started with StartRead(field) finishes
+        // Reads into the caller's storage don't notify it
+        void SetReadCallback(OctaveReadCallback callback, void *context = nullptr);
+
+        /****** Request policy ******/
+        // Timeout, inter-frame gap and retries of every request, blocking or not
+        void SetRequestPolicy(const OctaveRequestPolicy &policy) { _policy = policy; }
+        const OctaveRequestPolicy &RequestPolicy() const { return _policy; }
+
+        /****** Line settings ******/
+        // Find the baud rate and parity the meter answers at, probing them with a ReadAlarms frame,
+        // and keep the port at those settings. Returns 0, or error code 5 if no settings got an answer
+        // With a target rate, the result also reports whether the meter can be moved to it
+        uint8_t AutoBaud(OctaveAutoBaudResult* output, uint32_t targetBaudrate = 0, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Set a function to restart the port with new line settings, e.g. to keep its pins and RS-485 mode
+        // Without one, AutoBaud() calls begin(baudrate, config) on the port
+        void SetLineSettingsCallback(OctaveLineSettingsCallback callback, void *context = nullptr);
+        uint32_t Baudrate() const { return _baudrate; }
+        uint32_t LineConfig() const { return _config; }
+        // Use a policy for the next request only, e.g. a longer timeout for one slow read
+        // A read answered from the cache also uses it up
+        void SetNextRequestPolicy(const OctaveRequestPolicy &policy);
+
+        /****** Field cache ******/
+        // Reads of a field within its TTL, in ms, return the cached value without using the bus
+        // A TTL of 0 disables the cache for the field, CACHE_TTL_FOREVER keeps values until invalidated
+        // Successful writes invalidate the fields they change
+        void SetCacheTTL(OctaveField field, uint32_t ttlMillis);
+        uint32_t CacheTTL(OctaveField field) const;
+        void InvalidateCache(OctaveField field);
+        void InvalidateCache();
+
+        // Results of the last finished request
+        uint8_t LastErrorCode() const { return _lastModbusErrorCode; }
+        // Decoded value of the last read that wasn't given its own output
+        const OctaveValue &LastValue() const { return _lastValue; }
+
+        /****** Bus statistics ******/
+        // Copy the statistics gathered since the wrapper was created or since the last ResetBusStats()
+        // All zero if OCTAVE_BUS_STATS is 0
+        void BusStats(OctaveBusStats* output) const;
+        void ResetBusStats();
+        // Upper bound, in us, of a latency histogram bucket, the last bucket has none and returns UINT32_MAX
+        static uint32_t LatencyBucketMicros(uint8_t bucket);
 
         // Helper functions to print special data types
         void PrintDouble(float64_t &number, HardwareSerial &Serial);
-        void PrintSerial(int16_t registers[16], HardwareSerial &Serial);
+        void PrintSerial(const int16_t registers[16], HardwareSerial &Serial);
         void PrintAlarms(int16_t alarms, HardwareSerial &Serial);
         void PrintError(uint8_t errorCode, HardwareSerial &Serial);
+        // Names of unit, resolution and flow direction codes, and of error codes
+        // Return "Unknown" for codes that aren't defined, never allocate
+        // The names are in flash, print them as they are or copy them with strcpy_P()
+        static const __FlashStringHelper *CodeToName(OctaveDecodeKind kind, int16_t code);
+        static const __FlashStringHelper *ErrorName(uint8_t errorCode);
+        // Code of a unit, resolution or flow direction name, returns -1 if the name isn't defined for the kind
+        // The names are the ones returned by CodeToName(), and are only stored once, in flash
+        static int16_t NameToCode(OctaveDecodeKind kind, const char *name);
         // Interpret the result of a Modbus request from its error code and print it to a Serial
+        // The value is printed from the output of the request, which must still be valid
         uint8_t InterpretResult(uint8_t errorCode, HardwareSerial &Serial);
+        // Encode the result as a binary telemetry record instead, e.g. for a slow debug UART
+        // Requests that don't match a field, in address, value size and number of values, aren't encoded
+        uint8_t EncodeResult(uint8_t errorCode, TelemetryEncoder &encoder);
+
+        // Read or write any field in blocking mode, with the value type checked at compile time
+        template <OctaveField Field>
+        uint8_t Read(typename OctaveFieldTraits<Field>::type* output) {
+            static_assert(OctaveFieldTraits<Field>::readable, "Field is not readable");
+            return BlockingReadInto(Field, output);
+        }
+        template <OctaveField Field>
+        uint8_t Write(int16_t value) {
+            static_assert(OctaveFieldTraits<Field>::writable, "Field is not writable");
+            return BlockingWrite(Field, value);
+        }
+        // Read a field in blocking mode, the value is then available with LastValue()
+        uint8_t BlockingRead(OctaveField field, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Read a field in blocking mode, decoding the value straight into output
+        uint8_t BlockingReadInto(OctaveField field, void* output, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Write a field in blocking mode
+        uint8_t BlockingWrite(OctaveField field, int16_t value, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
 
         // Octave Modbus Requests
-        uint8_t ReadAlarms(int16_t* output);
-        uint8_t SerialNumber(int16_t* output);
-        uint8_t ReadWeekday(int16_t* output);
-        uint8_t ReadDay(int16_t* output);
-        uint8_t ReadMonth(int16_t* output);
-        uint8_t ReadYear(int16_t* output);
-        uint8_t ReadHours(int16_t* output);
-        uint8_t ReadMinutes(int16_t* output);
-        uint8_t VolumeUnit(int16_t* output);
-        uint8_t ForwardVolume_uint32(uint32_t* output);
-        uint8_t ForwardVolume_double(float64_t* output);
-        uint8_t ReverseVolume_uint32(uint32_t* output);
-        uint8_t ReverseVolume_double(float64_t* output);
-        uint8_t ReadVolumeResIndex(int16_t* output);
-        uint8_t SignedCurrentFlow_int32(int32_t* output);
-        uint8_t SignedCurrentFlow_double(float64_t* output);
-        uint8_t ReadFlowResIndex(int16_t* output);
-        uint8_t FlowUnit(int16_t* output);
-        uint8_t FlowDirection(int16_t* output);
-        uint8_t TemperatureValue(int16_t* output);
-        uint8_t TemperatureUnit(int16_t* output);
-        uint8_t NetSignedVolume_int32(int32_t* output);
-        uint8_t NetSignedVolume_double(float64_t* output);
-        uint8_t NetUnsignedVolume_uint32(uint32_t* output);
-        uint8_t NetUnsignedVolume_double(float64_t* output);
-        uint8_t SystemReset();
-        uint8_t WriteWeekday(uint8_t value);
-        uint8_t WriteDay(uint8_t value);
-        uint8_t WriteMonth(uint8_t value);
-        uint8_t WriteYear(uint8_t value);
-        uint8_t WriteHours(uint8_t value);
-        uint8_t WriteMinutes(uint8_t value);
+        uint8_t ReadAlarms(int16_t* output) { return Read<OctaveField::ReadAlarms>(output); }
+        uint8_t SerialNumber(int16_t* output) { return Read<OctaveField::SerialNumber>(output); }
+        uint8_t ReadWeekday(int16_t* output) { return Read<OctaveField::ReadWeekday>(output); }
+        uint8_t ReadDay(int16_t* output) { return Read<OctaveField::ReadDay>(output); }
+        uint8_t ReadMonth(int16_t* output) { return Read<OctaveField::ReadMonth>(output); }
+        uint8_t ReadYear(int16_t* output) { return Read<OctaveField::ReadYear>(output); }
+        uint8_t ReadHours(int16_t* output) { return Read<OctaveField::ReadHours>(output); }
+        uint8_t ReadMinutes(int16_t* output) { return Read<OctaveField::ReadMinutes>(output); }
+        uint8_t VolumeUnit(int16_t* output) { return Read<OctaveField::VolumeUnit>(output); }
+        uint8_t ForwardVolume_uint32(uint32_t* output) { return Read<OctaveField::ForwardVolume_uint32>(output); }
+        uint8_t ForwardVolume_double(float64_t* output) { return Read<OctaveField::ForwardVolume_double>(output); }
+        uint8_t ReverseVolume_uint32(uint32_t* output) { return Read<OctaveField::ReverseVolume_uint32>(output); }
+        uint8_t ReverseVolume_double(float64_t* output) { return Read<OctaveField::ReverseVolume_double>(output); }
+        uint8_t ReadVolumeResIndex(int16_t* output) { return Read<OctaveField::ReadVolumeResIndex>(output); }
+        uint8_t SignedCurrentFlow_int32(int32_t* output) { return Read<OctaveField::SignedCurrentFlow_int32>(output); }
+        uint8_t SignedCurrentFlow_double(float64_t* output) { return Read<OctaveField::SignedCurrentFlow_double>(output); }
+        uint8_t ReadFlowResIndex(int16_t* output) { return Read<OctaveField::ReadFlowResIndex>(output); }
+        uint8_t FlowUnit(int16_t* output) { return Read<OctaveField::FlowUnit>(output); }
+        uint8_t FlowDirection(int16_t* output) { return Read<OctaveField::FlowDirection>(output); }
+        uint8_t TemperatureValue(int16_t* output) { return Read<OctaveField::TemperatureValue>(output); }
+        uint8_t TemperatureUnit(int16_t* output) { return Read<OctaveField::TemperatureUnit>(output); }
+        uint8_t NetSignedVolume_int32(int32_t* output) { return Read<OctaveField::NetSignedVolume_int32>(output); }
+        uint8_t NetSignedVolume_double(float64_t* output) { return Read<OctaveField::NetSignedVolume_double>(output); }
+        uint8_t NetUnsignedVolume_uint32(uint32_t* output) { return Read<OctaveField::NetUnsignedVolume_uint32>(output); }
+        uint8_t NetUnsignedVolume_double(float64_t* output) { return Read<OctaveField::NetUnsignedVolume_double>(output); }
+        uint8_t SystemReset() { return Write<OctaveField::SystemReset>(0x1); }
+        // value must be within 1 to 7
+        uint8_t WriteWeekday(uint8_t value) { return Write<OctaveField::WriteWeekday>(value); }
+        // value must be within 1 to 31
+        uint8_t WriteDay(uint8_t value) { return Write<OctaveField::WriteDay>(value); }
+        // value must be within 1 to 12
+        uint8_t WriteMonth(uint8_t value) { return Write<OctaveField::WriteMonth>(value); }
+        // value must be within 14 to 99
+        uint8_t WriteYear(uint8_t value) { return Write<OctaveField::WriteYear>(value); }
+        // value must be within 0 to 23
+        uint8_t WriteHours(uint8_t value) { return Write<OctaveField::WriteHours>(value); }
+        // value must be within 0 to 59
+        uint8_t WriteMinutes(uint8_t value) { return Write<OctaveField::WriteMinutes>(value); }
         uint8_t WriteVolumeResIndex(uint8_t value);
         uint8_t WriteFlowResIndex(uint8_t value);
 
+        // Read or write the whole meter clock in a single request, so the minute can't roll over in between
+        uint8_t ReadClock(OctaveDateTime* output, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Returns error code 11 without sending anything if the date or time is out of range
+        uint8_t WriteClock(const OctaveDateTime &dateTime, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Check the date and time against the ranges of the clock registers
+        static bool IsValidDateTime(const OctaveDateTime &dateTime);
+
+        // Read and decode every input register of the meter
+        uint8_t ReadSnapshot(OctaveSnapshot* output, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Decode a snapshot from the SNAPSHOT_NUM_REGISTERS raw registers starting at SNAPSHOT_START_ADDRESS
+        static void DecodeSnapshot(const uint16_t* registers, OctaveSnapshot* output);
+        // Decode numSnapshots raw snapshots stored back to back, e.g. one per meter of a bus
+        static void DecodeSnapshots(const uint16_t* registers, OctaveSnapshot* output, uint16_t numSnapshots);
+        // Decode the value of a readable field from its raw registers, e.g. from a block read with StartReadRawRegisters
+        // registers must point to the register at the field's start address
+        static void DecodeField(OctaveField field, const uint16_t* registers, OctaveValue* output);
+
+#if OCTAVE_LEGACY_BUFFERS
         /****** Modbus response buffers ******/
         int16_t int16Buffer[16];
         int32_t int32Buffer;
         uint32_t uint32Buffer;
         float64_t doubleBuffer;
-
-        /****** Parameter maps ********/
-        std::map<String, uint8_t> flowUnitNameToCode;
-        std::map<uint8_t, String> flowUnitCodeToName;
-        std::map<String, uint8_t> volumeUnitNameToCode;
-        std::map<uint8_t, String> volumeUnitCodeToName;
-        std::map<String, uint8_t> temperatureUnitNameToCode;
-        std::map<uint8_t, String> temperatureUnitCodeToName;
-        std::map<String, uint8_t> flowDirectionNameToCode;
-        std::map<uint8_t, String> flowDirectionCodeToName;
-        std::map<String, uint8_t> resolutiontNameToCode;
-        std::map<uint8_t, String> resolutionCodeToName;
-        std::map<uint8_t, String> alarmCodeToName;
-
-        /****** Function name map *******/
-        std::map<String, uint16_t> functionNameToCode;
-        std::map<uint16_t, String> functionCodeToName;
-
-        std::map<uint8_t, String> errorCodeToName;
+#endif
 
         uint16_t lastUsedFunctionCode = 0;
 
     private:
         ModbusRTUMaster _master;
+        HardwareSerial &_serial;
+        uint8_t _slaveAddress;
+
+        // Use the instance's address unless a per-request address was given
+        uint8_t ResolveSlaveAddress(uint8_t slaveAddress) const {
+            return slaveAddress == INSTANCE_SLAVE_ADDRESS ? _slaveAddress : slaveAddress;
+        }
 
         /****** Parameters for the Modbus requests ******/
         // Number of registers to read for a Modbus request, is 0 for a write request
         uint8_t _numRegisterstoRead = 0;
         // Size, in bits, of the slave response values, is -32 for int32 and 32 for uint32
+        // and 0 for raw reads
         int8_t _signedResponseSizeinBits = 16;
+        // Number of values decoded from the response, is 0 for a write request
+        uint8_t _numValuesToDecode = 0;
+        // Destination of the decoded values of the current or last read request,
+        // either the caller's storage, _lastValue or the buffer of a raw read
+        void* _output = nullptr;
         // Storage variable for the Modbus error code, which is also returned with each request
         // Doesn't update when non-Modbus errors occur, i.e. when truncating a float64_t
         uint8_t _lastModbusErrorCode = 0;
+
+        /****** Non-blocking request state ******/
+        OctaveRequestStatus _requestStatus = OctaveRequestStatus::Idle;
+        // Field of the current or last request, is OctaveField::Count if it wasn't started from a field
+        OctaveField _requestField = OctaveField::Count;
+        // Resolved slave address of the current or last request
+        uint8_t _requestSlaveAddress = 0;
+        // Decoded value of the last read request without its own output
+        OctaveValue _lastValue;
+        OctaveReadCallback _readCallback = nullptr;
+        void *_readCallbackContext = nullptr;
+
+        // Count the result of the current request on the bus, then end it
+        void CompleteRequest(uint8_t errorCode);
+        // Store the result of the current request and notify the read callback, without counting it
+        void EndRequest(uint8_t errorCode);
+
+        /****** Request policy and retries ******/
+        OctaveRequestPolicy _policy;
+        OctaveRequestPolicy _nextPolicy;
+        bool _nextPolicyValid = false;
+        // Policy of the current or last request
+        OctaveRequestPolicy _activePolicy;
+        // Inter-frame gap for OCTAVE_GAP_AUTO, 3.5 characters at 9600 baud until begin()
+        // 32 bits, since it is over 65535 us below 588 baud, e.g. 128333 us at 300 baud
+        uint32_t _autoGapMicros = 4010;
+        // Line settings of the port, the config is only known once AutoBaud() restarted it
+        uint32_t _baudrate = 9600;
+        uint32_t _config = SERIAL_8N1;
+        OctaveLineSettingsCallback _lineSettingsCallback = nullptr;
+        void *_lineSettingsContext = nullptr;
+        // Start the master at a baud rate and update the inter-frame gap
+        void SetBaudrate(uint32_t baudrate);
+        // Restart the port and the master with new line settings
+        void ApplyLineSettings(uint32_t baudrate, uint32_t config);
+        // Send a ReadAlarms frame, returns true if the meter answered, even with an exception
+        bool ProbeLineSettings(uint8_t slaveAddress, uint8_t* probes);
+        // When the last response, or timeout, ended the previous frame
+        uint32_t _lastFrameEndMicros = 0;
+        // Frame of the current request, kept to send it again
+        uint8_t _requestQuantity = 0;
+        int16_t _requestValue = 0;
+        const uint16_t* _requestValues = nullptr;
+        uint8_t _retriesLeft = 0;
+        // Waiting for the backoff to end before the next attempt
+        bool _waitingRetry = false;
+        uint32_t _retryStartMillis = 0;
+        uint32_t _retryBackoffMillis = 0;
+        // Send the first attempt of the request set up by a Start function
+        uint8_t SendRequest();
+        // Send the frame of the current request after the inter-frame gap, returns false if the master is busy
+        bool TransmitRequest();
+
+        /****** Bus statistics ******/
+#if OCTAVE_BUS_STATS
+        OctaveBusStats _busStats;
+        // When the current request was sent
+        uint32_t _requestStartMicros = 0;
+        // Count a request sent on the bus, with the size of its frame
+        void RecordRequest(uint8_t frameBytes);
+        // Count a request refused because the channel was busy
+        void RecordBusy();
+        // Count the result of the request on the bus and its latency
+        void RecordResult(uint8_t errorCode);
+        // Count a request sent again after a timeout
+        void RecordRetry() { _busStats.retries++; }
+#else
+        void RecordRequest(uint8_t) {}
+        void RecordBusy() {}
+        void RecordResult(uint8_t) {}
+        void RecordRetry() {}
+#endif
+
+#if OCTAVE_FIELD_CACHE
+        struct CacheEntry {
+            OctaveValue value;
+            uint32_t storedMillis;
+            uint32_t ttlMillis;
+            uint8_t slaveAddress;
+            bool valid;
+        };
+        CacheEntry _cache[static_cast<uint8_t>(OctaveField::Count)];
+#endif
+        // Finish a read request with a cached value, returns false on a cache miss
+        bool CompleteFromCache(OctaveField field, void* output, uint8_t slaveAddress);
+        // Store the result of a successful field request in the cache, or invalidate the fields it changed
+        void UpdateCache(OctaveField field);
+#if OCTAVE_LEGACY_BUFFERS
+        // Copy the registers of a decoded read to the legacy buffers
+        void UpdateLegacyBuffers(ModbusResponse *response);
+#endif
 };
 
 #endif
\ No newline at end of file
@@ -1,132 +1,158 @@
-#include "ParamTables.h"
-
-// Initialize all name-to-code mappings
-// All codes were defined by Arad in the Octave Modbus memory map and are the same for all compatible meters
-void OctaveModbusWrapper::InitMaps() {
-    flowUnitNameToCode["Cubic Meters/Hour"] = 0;
-    flowUnitNameToCode["Gallons/Minute"] = 1;
-    flowUnitNameToCode["Litres/Second"] = 2;
-    flowUnitNameToCode["Imperial Gallons/ Minute"] = 3;
-    flowUnitNameToCode["Litres/Minute"] = 4;
-    flowUnitNameToCode["Barrel/Minute"] = 5;
-
-    // Code 0 is not implemented, according to the memory map
-    resolutiontNameToCode["0.001x"] = 1;
-    resolutiontNameToCode["0.01x"] = 2;
-    resolutiontNameToCode["0.1x"] = 3;
-    resolutiontNameToCode["1x"] = 4;
-    resolutiontNameToCode["10x"] = 5;
-    resolutiontNameToCode["100x"] = 6;
-    resolutiontNameToCode["1000x"] = 7;
-    resolutiontNameToCode["10000x"] = 8;
-
-    volumeUnitNameToCode["Cubic Meters"] = 0;
-    volumeUnitNameToCode["Cubic Feet"] = 1;
-    volumeUnitNameToCode["Cubic Inch"] = 2;
-    volumeUnitNameToCode["Cubic Yards"] = 3;
-    volumeUnitNameToCode["US Gallons"] = 4;
-    volumeUnitNameToCode["Imperial Gallons"] = 5;
-    volumeUnitNameToCode["Acre Feet"] = 6;
-    volumeUnitNameToCode["Kiloliters"] = 7;
-    volumeUnitNameToCode["Liters"] = 8;
-    volumeUnitNameToCode["Acre-inch"] = 9;
-    volumeUnitNameToCode["Barrel"] = 10;
-
-    // Not all codes are implemented, according to the memory map
-    alarmCodeToName[0] = "Leakage";
-    alarmCodeToName[5] = "Measurement Fail";
-    alarmCodeToName[7] = "Octave Battery";
-    alarmCodeToName[11] = "Flow Rate Cut Off";
-    alarmCodeToName[12] = "Module battery";
-    alarmCodeToName[13] = "Water meter-Module communication error";
-
-    temperatureUnitNameToCode["Not Active"] = 0;
-    temperatureUnitNameToCode["Celsius"] = 1;
-    temperatureUnitNameToCode["Fahrenheit"] = 2;
-
-    flowDirectionNameToCode["No flow"] = 0;
-    flowDirectionNameToCode["Forward flow"] = 1;
-    flowDirectionNameToCode["Backward flow"] = 2;
-
-    // Format: (Modbus function code << 8) + Start memory address
-    // The function codes are 04 for Read Input Registers and
-    // 06 for Write Single Register
-    functionNameToCode["ReadAlarms"] = 0x0400;
-    functionNameToCode["SerialNumber"] = 0x0401;
-    functionNameToCode["ReadWeekday"] = 0x0411;
-    functionNameToCode["ReadDay"] = 0x0412;
-    functionNameToCode["ReadMonth"] = 0x0413;
-    functionNameToCode["ReadYear"] = 0x0414;
-    functionNameToCode["ReadHours"] = 0x0415;
-    functionNameToCode["ReadMinutes"] = 0x0416;
-    functionNameToCode["VolumeUnit"] = 0x0417;
-    functionNameToCode["ForwardVolume_32"] = 0x0436;
-    functionNameToCode["ForwardVolume_64"] = 0x0418;
-    functionNameToCode["ReverseVolume_32"] = 0x043A;
-    functionNameToCode["ReverseVolume_64"] = 0x0420;
-    functionNameToCode["ReadVolumeResIndex"] = 0x0428;
-    functionNameToCode["SignedCurrentFlow_32"] = 0x043E;
-    functionNameToCode["SignedCurrentFlow_64"] = 0x0429;
-    functionNameToCode["ReadFlowResIndex"] = 0x0431;
-    functionNameToCode["FlowUnit"] = 0x0432;
-    functionNameToCode["FlowDirection"] = 0x0433;
-    functionNameToCode["TemperatureValue"] = 0x0434;
-    functionNameToCode["TemperatureUnit"] = 0x0435;
-    functionNameToCode["NetSignedVolume_32"] = 0x0452;
-    functionNameToCode["NetSignedVolume_64"] = 0x0442;
-    functionNameToCode["NetUnsignedVolume_32"] = 0x0456;
-    functionNameToCode["NetUnsignedVolume_64"] = 0x044A;
-    functionNameToCode["SystemReset"] = 0x0600;
-    functionNameToCode["WriteWeekday"] = 0x0601;
-    functionNameToCode["WriteDay"] = 0x0602;
-    functionNameToCode["WriteMonth"] = 0x0603;
-    functionNameToCode["WriteYear"] = 0x0604;
-    functionNameToCode["WriteHours"] = 0x0605;
-    functionNameToCode["WriteMinutes"] = 0x0606;
-    functionNameToCode["WriteVolumeResIndex"] = 0x0607;
-    functionNameToCode["WriteFlowResIndex"] = 0x0608;
+#include "OctaveModbusWrapper.h"
+#include "DoubleFormat.h"
 
+// Definition of the register map, declared constexpr in ParamTables.h
+constexpr OctaveRegister OctaveRegisterMap::registers[] PROGMEM;
+
+
+/****** Name tables ******/
+// Packed in flash, one name after the other, each one ending with its null
+// Unlike a table of pointers, neither the names nor the table take any RAM
+
+// Number of nulls from begin to end, split in halves to keep the recursion shallow
+static constexpr uint8_t CountNulls(const char *names, size_t begin, size_t end) {
+    return end - begin == 1 ? names[begin] == '\0'
+                            : CountNulls(names, begin, (begin + end) / 2) + CountNulls(names, (begin + end) / 2, end);
+}
+
+// Number of names in a packed table, the array ends with one more null
+static constexpr uint8_t CountNames(const char *names, size_t size) {
+    return CountNulls(names, 0, size) - 1;
+}
+
+// Name at an index of a packed table, nullptr if there is none
+static PGM_P PackedName(PGM_P names, uint8_t count, int16_t index) {
+    if (index < 0 || index >= count) return nullptr;
+    for (; index > 0; index--) names += strlen_P(names) + 1;
+    return pgm_read_byte(names) == '\0' ? nullptr : names;
+}
+
+static const __FlashStringHelper *FlashString(PGM_P string) {
+    return reinterpret_cast<const __FlashStringHelper*>(string);
+}
+
+// In OctaveField order
+static constexpr char fieldNames[] PROGMEM =
+#define OCTAVE_FIELD_NAME(field, name, functionCode, startMemAddress, numValues, signedValueSizeinBits, kind) name "\0"
+    OCTAVE_REGISTER_TABLE(OCTAVE_FIELD_NAME);
+#undef OCTAVE_FIELD_NAME
+static_assert(CountNames(fieldNames, sizeof(fieldNames)) == static_cast<uint8_t>(OctaveField::Count),
+              "fieldNames must have one name per field");
+
+// Find the field of a function code, returns OctaveField::Count if there is none
+OctaveField OctaveRegisterMap::FieldFromFunctionCode(uint16_t functionCode) {
+    for (uint8_t i = 0; i < static_cast<uint8_t>(OctaveField::Count); i++) {
+        if (FunctionCode(static_cast<OctaveField>(i)) == functionCode) return static_cast<OctaveField>(i);
+    }
+    return OctaveField::Count;
+}
+
+// Printable name of a field
+const __FlashStringHelper *OctaveRegisterMap::FieldName(OctaveField field) {
+    PGM_P name = PackedName(fieldNames, static_cast<uint8_t>(OctaveField::Count), static_cast<uint8_t>(field));
+    if (name == nullptr) return F("Unknown function");
+    return FlashString(name);
+}
+
+// Printable name of a function code
+const __FlashStringHelper *OctaveRegisterMap::FunctionName(uint16_t functionCode) {
+    return FieldName(FieldFromFunctionCode(functionCode));
+}
+
+
+/****** Code-to-name tables ******/
+// Indexed by the codes defined by Arad in the Octave Modbus memory map
+// The names are separate literals, so a name starting with a digit isn't read as part of an octal escape
+static constexpr char flowUnitNames[] PROGMEM =
+    "Cubic Meters/Hour\0" "Gallons/Minute\0" "Litres/Second\0" "Imperial Gallons/ Minute\0" "Litres/Minute\0"
+    "Barrel/Minute\0";
+static constexpr char volumeUnitNames[] PROGMEM =
+    "Cubic Meters\0" "Cubic Feet\0" "Cubic Inch\0" "Cubic Yards\0" "US Gallons\0" "Imperial Gallons\0"
+    "Acre Feet\0" "Kiloliters\0" "Liters\0" "Acre-inch\0" "Barrel\0";
+static constexpr char temperatureUnitNames[] PROGMEM = "Not Active\0" "Celsius\0" "Fahrenheit\0";
+static constexpr char flowDirectionNames[] PROGMEM = "No flow\0" "Forward flow\0" "Backward flow\0";
+// Code 0 is not implemented, according to the memory map
+static constexpr char resolutionNames[] PROGMEM =
+    "\0" "0.001x\0" "0.01x\0" "0.1x\0" "1x\0" "10x\0" "100x\0" "1000x\0" "10000x\0";
+// Parallel to alarmsIndices
+static constexpr char alarmNames[] PROGMEM =
+    "Leakage\0" "Measurement Fail\0" "Octave Battery\0" "Flow Rate Cut Off\0" "Module battery\0"
+    "Water meter-Module communication error\0";
+static constexpr char errorNames[] PROGMEM =
     // Modbus error codes
-    errorCodeToName[0] = "No error";
-    errorCodeToName[1] = "Illegal Modbus Function";
-    errorCodeToName[2] = "Illegal Modbus Data Address";
-    errorCodeToName[3] = "Illegal Modbus Data Value";
-    errorCodeToName[4] = "Modbus Server Device Failure";
-    errorCodeToName[5] = "Modbus Timeout";
+    "No error\0" "Illegal Modbus Function\0" "Illegal Modbus Data Address\0" "Illegal Modbus Data Value\0"
+    "Modbus Server Device Failure\0" "Modbus Timeout\0"
     // Number compression error codes
-    errorCodeToName[6] = "16-bit Overflow";
-    errorCodeToName[7] = "16-bit Underflow";
-    errorCodeToName[8] = "32-bit Overflow";
-    errorCodeToName[9] = "32-bit Underflow";
-    // Modbus error code
-    errorCodeToName[10] = "Invalid Resolution Index";
-
-    // Create the reverse mappings
-    for (const auto& entry : flowUnitNameToCode) {
-        flowUnitCodeToName[entry.second] = entry.first;
-    }
-    for (const auto& entry : volumeUnitNameToCode) {
-        volumeUnitCodeToName[entry.second] = entry.first;
-    }
-    for (const auto& entry : temperatureUnitNameToCode) {
-        temperatureUnitCodeToName[entry.second] = entry.first;
-    }
-    for (const auto& entry : flowDirectionNameToCode) {
-        flowDirectionCodeToName[entry.second] = entry.first;
-    }
-    for (const auto& entry : resolutiontNameToCode) {
-        resolutionCodeToName[entry.second] = entry.first;
-    }
-    for (const auto& entry : functionNameToCode) {
-        functionCodeToName[entry.second] = entry.first;
+    "16-bit Overflow\0" "16-bit Underflow\0" "32-bit Overflow\0" "32-bit Underflow\0"
+    // Argument error codes
+    "Invalid Resolution Index\0" "Invalid Date or Time\0";
+static_assert(CountNames(alarmNames, sizeof(alarmNames)) == sizeof(alarmsIndices) / sizeof(alarmsIndices[0]),
+              "alarmNames must have one name per alarm");
+
+struct NameTable {
+    PGM_P names;
+    uint8_t count;
+};
+#define NAME_TABLE(names) {names, CountNames(names, sizeof(names))}
+#define NO_NAME_TABLE {nullptr, 0}
+
+// Name table of each decode kind, in OctaveDecodeKind order
+static const NameTable kindNameTables[] PROGMEM = {
+    NO_NAME_TABLE,                      // Int16
+    NO_NAME_TABLE,                      // SerialNumber
+    NO_NAME_TABLE,                      // Alarms
+    NAME_TABLE(volumeUnitNames),        // VolumeUnit
+    NAME_TABLE(flowUnitNames),          // FlowUnit
+    NAME_TABLE(temperatureUnitNames),   // TemperatureUnit
+    NAME_TABLE(flowDirectionNames),     // FlowDirection
+    NAME_TABLE(resolutionNames),        // Resolution
+    NO_NAME_TABLE,                      // UInt32
+    NO_NAME_TABLE,                      // Int32
+    NO_NAME_TABLE,                      // Double
+    NO_NAME_TABLE,                      // Clock
+    NO_NAME_TABLE                       // Write
+};
+static_assert(sizeof(kindNameTables) / sizeof(kindNameTables[0]) == static_cast<uint8_t>(OctaveDecodeKind::Write) + 1,
+              "kindNameTables must have one entry per decode kind");
+
+static NameTable KindNameTable(OctaveDecodeKind kind) {
+    NameTable table;
+    memcpy_P(&table, &kindNameTables[static_cast<uint8_t>(kind)], sizeof(table));
+    return table;
+}
+
+// Name of a unit, resolution or flow direction code
+const __FlashStringHelper *OctaveModbusWrapper::CodeToName(OctaveDecodeKind kind, int16_t code) {
+    NameTable table = KindNameTable(kind);
+    PGM_P name = PackedName(table.names, table.count, code);
+    if (name == nullptr) return F("Unknown");
+    return FlashString(name);
+}
+
+// Name of an error code
+const __FlashStringHelper *OctaveModbusWrapper::ErrorName(uint8_t errorCode) {
+    PGM_P name = PackedName(errorNames, CountNames(errorNames, sizeof(errorNames)), errorCode);
+    if (name == nullptr) return F("Unknown");
+    return FlashString(name);
+}
+
+// Code of a unit, resolution or flow direction name, returns -1 if the name isn't defined for the kind
+int16_t OctaveModbusWrapper::NameToCode(OctaveDecodeKind kind, const char *name) {
+    NameTable table = KindNameTable(kind);
+    // At most 11 names per kind, a scan of the packed table is enough
+    PGM_P candidate = table.names;
+    for (uint8_t code = 0; code < table.count; code++) {
+        if (pgm_read_byte(candidate) != '\0' && strcmp_P(name, candidate) == 0) return code;
+        candidate += strlen_P(candidate) + 1;
     }
+    return -1;
 }
 
 
 /****** Utilities ******/
 
 // Convert to ASCII and print the Octave Serial Number
-void OctaveModbusWrapper::PrintSerial(int16_t registers[16], HardwareSerial &Serial) {
+void OctaveModbusWrapper::PrintSerial(const int16_t registers[16], HardwareSerial &Serial) {
     // Loop through the response and print each register
     for (int i = 0; i < 16; i++){
         // Only print printable characters (indices 48-57 of the ASCII table)
@@ -142,16 +168,16 @@ void OctaveModbusWrapper::PrintSerial(int16_t registers[16], HardwareSerial &Ser
 // Interpret and print Octave Alarms
 void OctaveModbusWrapper::PrintAlarms(int16_t alarms, HardwareSerial &Serial) {
     // Leave space for the interpretation
-    Serial.print(": ");
-    if (alarms == 0) Serial.println(alarmCodeToName[0]);
+    Serial.print(F(": "));
+    if (alarms == 0) Serial.println(FlashString(alarmNames));
     else{
         // Bit-wise error check
-        for (int j = 0; j < sizeof(alarmsIndices) / sizeof(alarmsIndices[0]); j++) {
+        for (size_t j = 0; j < sizeof(alarmsIndices) / sizeof(alarmsIndices[0]); j++) {
             // If the (j+1)-th bit is set, print the corresponding error message
             // That is, the error codes correspond to the bit indices that are set to 1
             if ((alarms & (1 << alarmsIndices[j])) != 0) {
-                Serial.print(alarmCodeToName[alarmsIndices[j]]);
-                Serial.print(" ");
+                Serial.print(FlashString(PackedName(alarmNames, CountNames(alarmNames, sizeof(alarmNames)), j)));
+                Serial.print(F(" "));
             }
         }
         Serial.println();
@@ -160,81 +186,134 @@ void OctaveModbusWrapper::PrintAlarms(int16_t alarms, HardwareSerial &Serial) {
 
 // Print a 64-bit double number
 void OctaveModbusWrapper::PrintDouble(float64_t &number, HardwareSerial &Serial) {
-    // char *fp64_to_string(float64_t x, uint8_t max_chars, uint8_t max_zeroes)
-    Serial.println(fp64_to_string(number, 12, 1));
+    char buffer[FORMAT_DOUBLE_BUFFER_SIZE];
+    FormatDouble(number, buffer);  // Shortest digits that read back as the same double
+    Serial.println(buffer);
 }
 
 // Interpret and print an Octave error code
 void OctaveModbusWrapper::PrintError(uint8_t errorCode, HardwareSerial &Serial) {
     // Print the error code and its meaning
-    Serial.print("Error code ");
+    Serial.print(F("Error code "));
     Serial.print(errorCode);
-    Serial.print(": ");
-    Serial.println(errorCodeToName[errorCode]);
+    Serial.print(F(": "));
+    Serial.println(ErrorName(errorCode));
+}
+
+// Print the value of the last request according to its decode kind
+typedef void (*ValuePrinter)(OctaveModbusWrapper &octave, OctaveDecodeKind kind, const void *value, HardwareSerial &Serial);
+
+static void PrintInt16Value(OctaveModbusWrapper &, OctaveDecodeKind, const void *value, HardwareSerial &Serial) {
+    Serial.println(*static_cast<const int16_t*>(value));
+}
+
+static void PrintSerialValue(OctaveModbusWrapper &octave, OctaveDecodeKind, const void *value, HardwareSerial &Serial) {
+    octave.PrintSerial(static_cast<const int16_t*>(value), Serial);
+}
+
+static void PrintAlarmsValue(OctaveModbusWrapper &octave, OctaveDecodeKind, const void *value, HardwareSerial &Serial) {
+    Serial.print(*static_cast<const int16_t*>(value));
+    octave.PrintAlarms(*static_cast<const int16_t*>(value), Serial);
+}
+
+// Units, resolutions and flow direction
+static void PrintCodeValue(OctaveModbusWrapper &, OctaveDecodeKind kind, const void *value, HardwareSerial &Serial) {
+    Serial.print(*static_cast<const int16_t*>(value));
+    // Leave space for the interpretation
+    Serial.print(F(": "));
+    Serial.println(OctaveModbusWrapper::CodeToName(kind, *static_cast<const int16_t*>(value)));
+}
+
+static void PrintUInt32Value(OctaveModbusWrapper &, OctaveDecodeKind, const void *value, HardwareSerial &Serial) {
+    Serial.println(*static_cast<const uint32_t*>(value));
+}
+
+static void PrintInt32Value(OctaveModbusWrapper &, OctaveDecodeKind, const void *value, HardwareSerial &Serial) {
+    Serial.println(*static_cast<const int32_t*>(value));
 }
 
+static void PrintDoubleValue(OctaveModbusWrapper &octave, OctaveDecodeKind, const void *value, HardwareSerial &Serial) {
+    float64_t number = *static_cast<const float64_t*>(value);
+    octave.PrintDouble(number, Serial);
+}
+
+// Two digits, with a leading zero
+static void PrintTwoDigits(int16_t value, HardwareSerial &Serial) {
+    if (value >= 0 && value < 10) Serial.print(F("0"));
+    Serial.print(value);
+}
+
+// Registers 0x11 to 0x16, printed as dd/mm/yy hh:mm and the weekday
+static void PrintClockValue(OctaveModbusWrapper &, OctaveDecodeKind, const void *value, HardwareSerial &Serial) {
+    const int16_t *registers = static_cast<const int16_t*>(value);
+    PrintTwoDigits(registers[1], Serial);
+    Serial.print(F("/"));
+    PrintTwoDigits(registers[2], Serial);
+    Serial.print(F("/"));
+    PrintTwoDigits(registers[3], Serial);
+    Serial.print(F(" "));
+    PrintTwoDigits(registers[4], Serial);
+    Serial.print(F(":"));
+    PrintTwoDigits(registers[5], Serial);
+    Serial.print(F(", weekday "));
+    Serial.println(registers[0]);
+}
+
+static void PrintWriteDone(OctaveModbusWrapper &, OctaveDecodeKind, const void *, HardwareSerial &Serial) {
+    Serial.println(F("Done writing"));
+}
+
+// Jump table of value printers, in OctaveDecodeKind order
+static const ValuePrinter valuePrinters[] PROGMEM = {
+    PrintInt16Value,    // Int16
+    PrintSerialValue,   // SerialNumber
+    PrintAlarmsValue,   // Alarms
+    PrintCodeValue,     // VolumeUnit
+    PrintCodeValue,     // FlowUnit
+    PrintCodeValue,     // TemperatureUnit
+    PrintCodeValue,     // FlowDirection
+    PrintCodeValue,     // Resolution
+    PrintUInt32Value,   // UInt32
+    PrintInt32Value,    // Int32
+    PrintDoubleValue,   // Double
+    PrintClockValue,    // Clock
+    PrintWriteDone      // Write
+};
+static_assert(sizeof(valuePrinters) / sizeof(valuePrinters[0]) == static_cast<uint8_t>(OctaveDecodeKind::Write) + 1,
+              "valuePrinters must have one entry per decode kind");
+
 // Interpret the result of a Modbus request from its error code and print it to a Serial
 // Returns the error code for convenience
 // The rest of the parameters needed to interpret the result are stored in the OctaveModbusWrapper object
 uint8_t OctaveModbusWrapper::InterpretResult(uint8_t errorCode, HardwareSerial &Serial) {
-    // Print the function name
-    Serial.print(functionCodeToName[lastUsedFunctionCode]);
-    Serial.print(": ");
+    OctaveDecodeKind kind;
+    // Requests started from a field carry their decode kind in the register map
+    if (_requestField != OctaveField::Count) {
+        Serial.print(OctaveRegisterMap::FieldName(_requestField));
+        kind = OctaveRegisterMap::Get(_requestField).kind;
+    }
+    // Requests started from an address are interpreted from the size of their values
+    else {
+        Serial.print(OctaveRegisterMap::FunctionName(lastUsedFunctionCode));
+        if (_numRegisterstoRead == 0) kind = OctaveDecodeKind::Write;
+        else if (_signedResponseSizeinBits == 32) kind = OctaveDecodeKind::UInt32;
+        else if (_signedResponseSizeinBits == -32) kind = OctaveDecodeKind::Int32;
+        else if (_signedResponseSizeinBits == -64) kind = OctaveDecodeKind::Double;
+        // If there is more than 1 int16 value, it means that we're reading the Serial
+        else if (_numRegisterstoRead > 1) kind = OctaveDecodeKind::SerialNumber;
+        else kind = OctaveDecodeKind::Int16;
+    }
+    Serial.print(F(": "));
+
     // If there was an error, print it
     if (errorCode != 0) PrintError(errorCode, Serial);
+    // Raw reads are decoded by the caller, i.e. snapshots
+    else if (_signedResponseSizeinBits == 0) Serial.println(F("Done reading"));
     else {
-        // If it was a write request, just print that it's done
-        if (_numRegisterstoRead == 0) Serial.println("Done writing");
-        // For read requests, print the received value
-        else {
-            // 32- and 64-bit values don't need to be interpreted, just print them
-            if (_signedResponseSizeinBits == 32) Serial.println(uint32Buffer);
-            else if (_signedResponseSizeinBits == -32) Serial.println(int32Buffer);
-            else if (_signedResponseSizeinBits == -64) PrintDouble(doubleBuffer, Serial);
-            // Interpret the value if it's 16-bits
-            else {
-                // If there is more than 1 int16 value, it means that we're reading the Serial
-                if (_numRegisterstoRead > 1) PrintSerial(int16Buffer, Serial);
-                // If only 1 int16 was requested
-                else {
-                    // Print the value
-                    Serial.print(int16Buffer[0]);
-
-                    // Print value interpretation for the functions that require it
-                    if (lastUsedFunctionCode == functionNameToCode["VolumeUnit"]){
-                        // Leave space for the interpretation
-                        Serial.print(": ");
-                        Serial.println(volumeUnitCodeToName[int16Buffer[0]]);
-                    }
-                    else if (lastUsedFunctionCode == functionNameToCode["FlowUnit"]){
-                        // Leave space for the interpretation
-                        Serial.print(": ");
-                        Serial.println(flowUnitCodeToName[int16Buffer[0]]);
-                    }
-                    else if ((lastUsedFunctionCode == functionNameToCode["ReadVolumeResIndex"]) || (lastUsedFunctionCode == functionNameToCode["ReadFlowResIndex"])){
-                        // Leave space for the interpretation
-                        Serial.print(": ");
-                        Serial.println(resolutionCodeToName[int16Buffer[0]]);
-                    }
-                    else if (lastUsedFunctionCode == functionNameToCode["TemperatureUnit"]){
-                        // Leave space for the interpretation
-                        Serial.print(": ");
-                        Serial.println(temperatureUnitCodeToName[int16Buffer[0]]);
-                    }
-                    else if (lastUsedFunctionCode == functionNameToCode["FlowDirection"]){
-                        // Leave space for the interpretation
-                        Serial.print(": ");
-                        Serial.println(flowDirectionCodeToName[int16Buffer[0]]);
-                    }
-                    else if (lastUsedFunctionCode == functionNameToCode["ReadAlarms"]){
-                        PrintAlarms(int16Buffer[0], Serial);
-                    }
-                    else Serial.println();  
-                }
-            }
-        }
+        ValuePrinter printer = reinterpret_cast<ValuePrinter>(pgm_read_ptr(&valuePrinters[static_cast<uint8_t>(kind)]));
+        printer(*this, kind, _output, Serial);
     }
 
     // Return the error code for convenience
     return errorCode;
-}
\ No newline at end of file
+}
@@ -1 +1,150 @@
-#include "OctaveModbusWrapper.h"
\ No newline at end of file
+#ifndef __ParamTables_H__
+#define __ParamTables_H__
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include <fp64lib.h>
+
+class __FlashStringHelper;
+
+// How the value of an Octave register is decoded and interpreted
+enum class OctaveDecodeKind : uint8_t {
+    Int16,              // Plain 16-bit number
+    SerialNumber,       // 16 registers with one ASCII digit each
+    Alarms,             // Bit field, see alarmsIndices
+    VolumeUnit,         // 16-bit unit and resolution codes
+    FlowUnit,
+    TemperatureUnit,
+    FlowDirection,
+    Resolution,
+    UInt32,             // AB CD unsigned 32-bit number
+    Int32,              // AB CD signed 32-bit number
+    Double,             // HG FE DC BA 64-bit double
+    Clock,              // Weekday, day, month, year, hours and minutes registers
+    Write               // Write Single or Multiple Registers, no value is read
+};
+
+// Octave Modbus functions, as defined by Arad in the Octave Modbus memory map
+// Format: field, printed name, Modbus function code, start memory address, number of values,
+// signed value size in bits, decode kind
+// The function codes are 04 for Read Input Registers, 06 for Write Single Register
+// and 16 (0x10) for Write Multiple Registers
+// Adding a line here adds the field to OctaveField, the register map and the generic Read/Write requests
+#define OCTAVE_REGISTER_TABLE(X) \
+    X(ReadAlarms,               "ReadAlarms",           0x04, 0x00, 1,  16,  Alarms) \
+    X(SerialNumber,             "SerialNumber",         0x04, 0x01, 16, 16,  SerialNumber) \
+    X(ReadWeekday,              "ReadWeekday",          0x04, 0x11, 1,  16,  Int16) \
+    X(ReadDay,                  "ReadDay",              0x04, 0x12, 1,  16,  Int16) \
+    X(ReadMonth,                "ReadMonth",            0x04, 0x13, 1,  16,  Int16) \
+    X(ReadYear,                 "ReadYear",             0x04, 0x14, 1,  16,  Int16) \
+    X(ReadHours,                "ReadHours",            0x04, 0x15, 1,  16,  Int16) \
+    X(ReadMinutes,              "ReadMinutes",          0x04, 0x16, 1,  16,  Int16) \
+    X(VolumeUnit,               "VolumeUnit",           0x04, 0x17, 1,  16,  VolumeUnit) \
+    X(ForwardVolume_uint32,     "ForwardVolume_32",     0x04, 0x36, 1,  32,  UInt32) \
+    X(ForwardVolume_double,     "ForwardVolume_64",     0x04, 0x18, 1,  -64, Double) \
+    X(ReverseVolume_uint32,     "ReverseVolume_32",     0x04, 0x3A, 1,  32,  UInt32) \
+    X(ReverseVolume_double,     "ReverseVolume_64",     0x04, 0x20, 1,  -64, Double) \
+    X(ReadVolumeResIndex,       "ReadVolumeResIndex",   0x04, 0x28, 1,  16,  Resolution) \
+    X(SignedCurrentFlow_int32,  "SignedCurrentFlow_32", 0x04, 0x3E, 1,  -32, Int32) \
+    X(SignedCurrentFlow_double, "SignedCurrentFlow_64", 0x04, 0x29, 1,  -64, Double) \
+    X(ReadFlowResIndex,         "ReadFlowResIndex",     0x04, 0x31, 1,  16,  Resolution) \
+    X(FlowUnit,                 "FlowUnit",             0x04, 0x32, 1,  16,  FlowUnit) \
+    X(FlowDirection,            "FlowDirection",        0x04, 0x33, 1,  16,  FlowDirection) \
+    X(TemperatureValue,         "TemperatureValue",     0x04, 0x34, 1,  16,  Int16) \
+    X(TemperatureUnit,          "TemperatureUnit",      0x04, 0x35, 1,  16,  TemperatureUnit) \
+    X(NetSignedVolume_int32,    "NetSignedVolume_32",   0x04, 0x52, 1,  -32, Int32) \
+    X(NetSignedVolume_double,   "NetSignedVolume_64",   0x04, 0x42, 1,  -64, Double) \
+    X(NetUnsignedVolume_uint32, "NetUnsignedVolume_32", 0x04, 0x56, 1,  32,  UInt32) \
+    X(NetUnsignedVolume_double, "NetUnsignedVolume_64", 0x04, 0x4A, 1,  -64, Double) \
+    X(ReadClock,                "ReadClock",            0x04, 0x11, 6,  16,  Clock) \
+    X(SystemReset,              "SystemReset",          0x06, 0x00, 1,  16,  Write) \
+    X(WriteWeekday,             "WriteWeekday",         0x06, 0x01, 1,  16,  Write) \
+    X(WriteDay,                 "WriteDay",             0x06, 0x02, 1,  16,  Write) \
+    X(WriteMonth,               "WriteMonth",           0x06, 0x03, 1,  16,  Write) \
+    X(WriteYear,                "WriteYear",            0x06, 0x04, 1,  16,  Write) \
+    X(WriteHours,               "WriteHours",           0x06, 0x05, 1,  16,  Write) \
+    X(WriteMinutes,             "WriteMinutes",         0x06, 0x06, 1,  16,  Write) \
+    X(WriteVolumeResIndex,      "WriteVolumeResIndex",  0x06, 0x07, 1,  16,  Write) \
+    X(WriteFlowResIndex,        "WriteFlowResIndex",    0x06, 0x08, 1,  16,  Write) \
+    X(WriteClock,               "WriteClock",           0x10, 0x01, 6,  16,  Write)
+
+// Octave fields, named after their blocking getters and setters
+enum class OctaveField : uint8_t {
+#define OCTAVE_FIELD_ENUM(field, name, functionCode, startMemAddress, numValues, signedValueSizeinBits, kind) field,
+    OCTAVE_REGISTER_TABLE(OCTAVE_FIELD_ENUM)
+#undef OCTAVE_FIELD_ENUM
+    // Number of fields, also used when a request isn't tied to a field
+    Count
+};
+
+// Location and format of an Octave register in the Modbus memory map
+// The printed names are kept apart, in flash, see FieldName()
+struct OctaveRegister {
+    uint8_t functionCode;
+    uint8_t startMemAddress;
+    uint8_t numValues;
+    // Size, in bits, of the values, is -32 for int32, 32 for uint32 and -64 for doubles
+    int8_t signedValueSizeinBits;
+    OctaveDecodeKind kind;
+};
+
+struct OctaveRegisterMap {
+    // One entry per OctaveField, in the same order
+    // In flash, so it can only be read at runtime through Get()
+    static constexpr OctaveRegister registers[] PROGMEM = {
+#define OCTAVE_REGISTER_ENTRY(field, name, functionCode, startMemAddress, numValues, signedValueSizeinBits, kind) \
+        {functionCode, startMemAddress, numValues, signedValueSizeinBits, OctaveDecodeKind::kind},
+        OCTAVE_REGISTER_TABLE(OCTAVE_REGISTER_ENTRY)
+#undef OCTAVE_REGISTER_ENTRY
+    };
+
+    // Entry of a field in constant expressions only, e.g. OctaveFieldTraits
+    static constexpr const OctaveRegister &Entry(OctaveField field) {
+        return registers[static_cast<uint8_t>(field)];
+    }
+
+    // Copy of the entry of a field, read from flash
+    static OctaveRegister Get(OctaveField field) {
+        OctaveRegister entry;
+        memcpy_P(&entry, &registers[static_cast<uint8_t>(field)], sizeof(entry));
+        return entry;
+    }
+
+    // Format: (Modbus function code << 8) + Start memory address, as stored in lastUsedFunctionCode
+    static uint16_t FunctionCode(OctaveField field) {
+        OctaveRegister entry = Get(field);
+        return (static_cast<uint16_t>(entry.functionCode) << 8) + entry.startMemAddress;
+    }
+
+    // Size, in bytes, of the decoded value of a field
+    static uint8_t ValueSize(OctaveField field) {
+        OctaveRegister entry = Get(field);
+        return entry.numValues * (entry.signedValueSizeinBits < 0 ? -entry.signedValueSizeinBits : entry.signedValueSizeinBits) / 8;
+    }
+
+    // Find the field of a function code, returns OctaveField::Count if there is none
+    static OctaveField FieldFromFunctionCode(uint16_t functionCode);
+    // Printable names of a field and of a function code, in flash
+    static const __FlashStringHelper *FieldName(OctaveField field);
+    static const __FlashStringHelper *FunctionName(uint16_t functionCode);
+};
+
+static_assert(sizeof(OctaveRegisterMap::registers) / sizeof(OctaveRegister) == static_cast<uint8_t>(OctaveField::Count),
+              "The register map must have one entry per field");
+
+// C++ type of the values of each decode kind
+template <OctaveDecodeKind Kind> struct OctaveValueType { typedef int16_t type; };
+template <> struct OctaveValueType<OctaveDecodeKind::UInt32> { typedef uint32_t type; };
+template <> struct OctaveValueType<OctaveDecodeKind::Int32> { typedef int32_t type; };
+template <> struct OctaveValueType<OctaveDecodeKind::Double> { typedef float64_t type; };
+
+// Compile-time properties of a field, used by the generic Read and Write requests
+template <OctaveField Field> struct OctaveFieldTraits {
+    static constexpr OctaveDecodeKind kind = OctaveRegisterMap::Entry(Field).kind;
+    static constexpr uint8_t numValues = OctaveRegisterMap::Entry(Field).numValues;
+    static constexpr bool readable = OctaveRegisterMap::Entry(Field).functionCode == 0x04;
+    static constexpr bool writable = OctaveRegisterMap::Entry(Field).functionCode == 0x06;
+    typedef typename OctaveValueType<kind>::type type;
+};
+
+#endif
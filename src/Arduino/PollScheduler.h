@@ -0,0 +1,103 @@
+#ifndef __PollScheduler_H__
+#define __PollScheduler_H__
+
+#include "OctaveModbusWrapper.h"
+
+/****** Settings ******/
+// Maximum number of fields polled by a PollScheduler
+#ifndef POLL_SCHEDULER_MAX_FIELDS
+#define POLL_SCHEDULER_MAX_FIELDS 12
+#endif
+
+// Maximum number of unused registers read to merge two fields into one request
+// Every request costs an 8-byte query, a 5-byte response header and the response latency of the meter,
+// as much line time as about 6 registers plus the latency
+#ifndef POLL_SCHEDULER_MAX_GAP_REGISTERS
+#define POLL_SCHEDULER_MAX_GAP_REGISTERS 8
+#endif
+
+// Period of the fields that are read only once, e.g. the units at boot
+#define POLL_PERIOD_ONCE 0xFFFFFFFF
+
+// Polls the input registers of one meter, each at its own period and priority
+// Due fields are read highest priority first, then longest due first, and fields that fall due together
+// are merged into one register range read. A new request is sent as soon as the previous one finishes,
+// so the bus only carries reads of fields that are due
+class PollScheduler {
+    public:
+        explicit PollScheduler(OctaveModbusWrapper &octave, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+
+        // Read a field every periodMillis, or once with POLL_PERIOD_ONCE, starting on the next Poll()
+        // A higher priority is read first when several fields are due. Adding a field again changes its period and priority
+        // Returns false if the field isn't readable or POLL_SCHEDULER_MAX_FIELDS fields are already scheduled
+        bool AddField(OctaveField field, uint32_t periodMillis, uint8_t priority = 0);
+        // Stop reading a field, returns false if it wasn't scheduled
+        bool RemoveField(OctaveField field);
+
+        // Set a function to call with every value read, or with the error code of its request
+        void SetCallback(OctaveReadCallback callback, void *context = nullptr);
+
+        // Advance the schedule without blocking, call it as often as possible from loop()
+        // Returns the number of fields whose read just finished
+        uint8_t Poll();
+
+        /****** Deadlines ******/
+        // A field misses a deadline when it isn't read before its next read is due,
+        // i.e. when more than one period late. Each period skipped counts as one
+        uint32_t MissedDeadlines(OctaveField field) const;
+        uint32_t MissedDeadlines() const { return _missedDeadlines; }
+        // Worst delay between a field falling due and the request that read it
+        uint32_t MaxLatenessMillis() const { return _maxLatenessMillis; }
+
+        /****** Statistics ******/
+        // Number of requests sent, each one may read several fields
+        uint32_t Requests() const { return _requests; }
+        // Number of finished field reads, including failed ones
+        uint32_t FieldReads() const { return _fieldReads; }
+        void ResetStats();
+
+    private:
+        struct ScheduledField {
+            uint32_t periodMillis;
+            uint32_t dueMillis;
+            uint32_t missedDeadlines;
+            OctaveField field;
+            uint8_t priority;
+            // Read by the pending request
+            bool inRequest;
+            // Fields read once are done after their first successful read
+            bool done;
+        };
+
+        OctaveModbusWrapper &_octave;
+        uint8_t _slaveAddress;
+        OctaveReadCallback _callback = nullptr;
+        void *_callbackContext = nullptr;
+
+        ScheduledField _fields[POLL_SCHEDULER_MAX_FIELDS];
+        uint8_t _numFields = 0;
+
+        // Raw registers of the pending request, every input register is within the snapshot range
+        uint16_t _registers[SNAPSHOT_NUM_REGISTERS];
+        uint8_t _requestStartAddress = 0;
+        // Size of the register range on the bus, is 0 when no request is pending
+        uint8_t _pendingRegisters = 0;
+
+        /****** Statistics ******/
+        uint32_t _missedDeadlines = 0;
+        uint32_t _maxLatenessMillis = 0;
+        uint32_t _requests = 0;
+        uint32_t _fieldReads = 0;
+
+        // Index of a scheduled field, or -1
+        int8_t Find(OctaveField field) const;
+        bool IsDue(const ScheduledField &scheduled, uint32_t now) const;
+        // Pick the due fields of the next request, merge their ranges and send it
+        void StartNextRequest();
+        // Move the due time of a field that is being read past now, counting the deadlines it missed
+        void Reschedule(ScheduledField &scheduled, uint32_t now);
+        // Decode and report the fields of the finished request, returns their number
+        uint8_t FinishRequest(uint8_t errorCode);
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef __ReadingLog_H__
+#define __ReadingLog_H__
+
+#include "OctaveModbusWrapper.h"
+
+// Largest encoded entry: two 5-byte varints
+#define READING_LOG_MAX_ENTRY_BYTES 10
+// Largest drained stream header: a 5-byte varint for each of the value, timestamp and interval
+#define READING_LOG_MAX_HEADER_BYTES 15
+
+// One sample of a ReadingLog
+struct ReadingLogSample {
+    uint32_t millis;        // Timestamp given to Append()
+    int32_t scaledValue;    // Value multiplied by SCALE_FACTOR, see truncateDoubleto32bits()
+};
+
+// Value, timestamp and sampling interval of a sample, the state that the next entry is encoded against
+struct ReadingLogState {
+    int32_t scaledValue;
+    uint32_t millis;
+    uint32_t interval;
+};
+
+// Time series of one field in a fixed byte buffer, i.e. between uplinks
+// Values are compressed to SCALE_FACTOR fixed point and every entry stores, as zigzag varints,
+// the value delta and the change of the sampling interval against the previous sample,
+// so a slowly changing value sampled at a steady rate takes 2 bytes per sample
+// When the buffer is full, the oldest samples are evicted to make room
+class ReadingLog {
+    public:
+        // storage must outlive the ReadingLog, capacity is its size in bytes, at least READING_LOG_MAX_ENTRY_BYTES
+        ReadingLog(uint8_t *storage, uint16_t capacity);
+
+        // Compress a value with truncateDoubleto32bits and append it, in O(1)
+        // Returns the truncation error code, values out of range are appended clamped
+        uint8_t Append(float64_t value, uint32_t millis);
+        void AppendScaled(int32_t scaledValue, uint32_t millis);
+        void Clear();
+
+        // Number of samples and bytes in the log
+        uint16_t Size() const { return _size; }
+        uint16_t UsedBytes() const { return _usedBytes; }
+        uint16_t Capacity() const { return _capacity; }
+        // Number of samples evicted to make room for newer ones
+        uint32_t Evicted() const { return _evicted; }
+
+        // Iterate over the samples, oldest first
+        struct Iterator {
+            ReadingLogState state;
+            uint16_t position;
+            uint16_t remaining;
+        };
+        Iterator Begin() const;
+        // Returns false after the newest sample
+        bool Next(Iterator &iterator, ReadingLogSample *sample) const;
+
+        // Move the oldest samples to output as a self-contained stream, see ReadingLogReader,
+        // and remove them from the log. Only whole samples are moved
+        // Returns the number of bytes written, 0 if the log is empty or no sample fits in maxBytes
+        uint16_t Drain(uint8_t *output, uint16_t maxBytes);
+
+    private:
+        uint8_t *_storage;
+        uint16_t _capacity;
+
+        // Ring buffer of encoded entries, from _head to _head + _usedBytes
+        uint16_t _head = 0;
+        uint16_t _usedBytes = 0;
+        uint16_t _size = 0;
+        uint32_t _evicted = 0;
+
+        // Sample before the oldest entry, and newest sample
+        ReadingLogState _headState;
+        ReadingLogState _tailState;
+        bool _started = false;
+
+        // Length of the entry at a position of the ring buffer
+        uint16_t EntryLength(uint16_t position) const;
+        // Decode the entry at a position into state, returns the position of the next entry
+        uint16_t DecodeEntry(uint16_t position, ReadingLogState &state) const;
+        // Remove the oldest entry
+        void EvictOldest();
+};
+
+// Decoder of the streams written by ReadingLog::Drain(), i.e. on the uplink receiver
+class ReadingLogReader {
+    public:
+        ReadingLogReader(const uint8_t *bytes, uint16_t length);
+
+        // Returns false after the last sample, or if the stream is truncated
+        bool Next(ReadingLogSample *sample);
+
+    private:
+        const uint8_t *_bytes;
+        uint16_t _length;
+        uint16_t _position = 0;
+        ReadingLogState _state;
+        bool _valid;
+};
+
+#endif
@@ -0,0 +1,31 @@
+#include "RegisterDecoding.h"
+
+// The back-to-back case is a separate loop with a constant stride,
+// which the compiler can unroll and vectorize on wider targets
+
+void DecodeUInt32Array(const uint16_t* registers, size_t stride, uint32_t* output, size_t count){
+  if (stride == 2) {
+    for (size_t i = 0; i < count; i++) output[i] = DecodeABCD(&registers[2 * i]);
+  }
+  else {
+    for (size_t i = 0; i < count; i++) output[i] = DecodeABCD(&registers[stride * i]);
+  }
+}
+
+void DecodeInt32Array(const uint16_t* registers, size_t stride, int32_t* output, size_t count){
+  if (stride == 2) {
+    for (size_t i = 0; i < count; i++) output[i] = static_cast<int32_t>(DecodeABCD(&registers[2 * i]));
+  }
+  else {
+    for (size_t i = 0; i < count; i++) output[i] = static_cast<int32_t>(DecodeABCD(&registers[stride * i]));
+  }
+}
+
+void DecodeDoubleArray(const uint16_t* registers, size_t stride, float64_t* output, size_t count){
+  if (stride == 4) {
+    for (size_t i = 0; i < count; i++) output[i] = DecodeHGFEDCBA(&registers[4 * i]);
+  }
+  else {
+    for (size_t i = 0; i < count; i++) output[i] = DecodeHGFEDCBA(&registers[stride * i]);
+  }
+}
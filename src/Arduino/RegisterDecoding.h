@@ -0,0 +1,38 @@
+#ifndef __RegisterDecoding_H__
+#define __RegisterDecoding_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <fp64lib.h>
+
+// Decoders of the byte orders of the Octave memory map, see Octave Memory Map.md
+// Registers are the 16-bit values returned by the Modbus master, most significant byte first
+
+// 32-bit values are stored in 2 registers with AB CD byte order
+inline uint32_t DecodeABCD(const uint16_t* registers) {
+    return (static_cast<uint32_t>(registers[0]) << 16) | registers[1];
+}
+
+// 64-bit values are stored in 4 registers with HG FE DC BA byte order,
+// i.e. the least significant register first, with the bytes of each register swapped
+inline uint64_t DecodeHGFEDCBABits(const uint16_t* registers) {
+    return (static_cast<uint64_t>(__builtin_bswap16(registers[3])) << 48)
+         | (static_cast<uint64_t>(__builtin_bswap16(registers[2])) << 32)
+         | (static_cast<uint64_t>(__builtin_bswap16(registers[1])) << 16)
+         | static_cast<uint64_t>(__builtin_bswap16(registers[0]));
+}
+
+// fp64lib values are the IEEE-754 bits themselves
+inline float64_t DecodeHGFEDCBA(const uint16_t* registers) {
+    return DecodeHGFEDCBABits(registers);
+}
+
+// Batch decoders of count values, the first one at registers[0] and each one stride registers after the previous one
+// A stride of 2 or 4 decodes values stored back to back, a stride of SNAPSHOT_NUM_REGISTERS decodes
+// the same value from consecutive raw snapshots of many meters
+void DecodeUInt32Array(const uint16_t* registers, size_t stride, uint32_t* output, size_t count);
+void DecodeInt32Array(const uint16_t* registers, size_t stride, int32_t* output, size_t count);
+void DecodeDoubleArray(const uint16_t* registers, size_t stride, float64_t* output, size_t count);
+
+#endif
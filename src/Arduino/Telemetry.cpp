@@ -0,0 +1,236 @@
+#include "Telemetry.h"
+#include "Varint.h"
+#include "ConsumptionAggregator.h"
+#include <stddef.h>
+
+/****** Doubles as decimals ******/
+// Find k and d such that the double is the nearest double to k / 10^d, with the smallest d
+bool TelemetryDoubleToDecimal(uint64_t bits, int64_t &k, uint8_t &d){
+  static const uint16_t powersOf10[TELEMETRY_MAX_DECIMALS + 1] = {1, 10, 100, 1000};
+
+  bool negative = (bits >> 63) != 0;
+  int16_t exponent = (bits >> 52) & 0x7FF;
+  uint64_t fraction = bits & 0xFFFFFFFFFFFFFULL;
+
+  // Infinities and NaN
+  if (exponent == 0x7FF) return false;
+  // Zero, except -0 and subnormals, which are sent raw
+  if (exponent == 0) {
+    if (negative || fraction != 0) return false;
+    k = 0;
+    d = 0;
+    return true;
+  }
+
+  // The value is mantissa / 2^shift
+  uint64_t mantissa = fraction | (1ULL << 52);
+  int16_t shift = 1075 - exponent;
+
+  if (shift <= 0) {
+    // Integers of 2^52 and above, up to 2^61 so the zigzag varint doesn't overflow
+    if (shift < -8) return false;
+    k = static_cast<int64_t>(mantissa << -shift);
+    if (negative) k = -k;
+    d = 0;
+    return true;
+  }
+  // Values too small for 3 decimals
+  if (shift > 62) return false;
+
+  uint64_t unit = 1ULL << shift;
+  for (d = 0; d <= TELEMETRY_MAX_DECIMALS; d++) {
+    // At most 2^53 * 1000, within 64 bits
+    uint64_t scaled = mantissa * powersOf10[d];
+    // Round to the nearest k, keeping the distance to it in units of 2^-shift / 10^d
+    uint64_t quotient = scaled >> shift;
+    uint64_t residual = scaled & (unit - 1);
+    if (residual >= unit - residual) {
+      quotient++;
+      residual = unit - residual;
+    }
+    // k must convert to a double exactly for the decoder's division to be correctly rounded
+    if (quotient > (1ULL << 53)) return false;
+
+    // The value is the nearest double if k / 10^d is within half an ulp of it, i.e. 2 * residual < 10^d
+    // At a power of 2 the next double below is half an ulp away, so be conservative there
+    uint64_t bound = fraction == 0 ? 4 * residual : 2 * residual;
+    if (bound < powersOf10[d]) {
+      k = negative ? -static_cast<int64_t>(quotient) : static_cast<int64_t>(quotient);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+/****** TelemetryEncoder ******/
+TelemetryEncoder::TelemetryEncoder(uint8_t *buffer, uint16_t capacity) : _buffer(buffer), _capacity(capacity) {}
+
+
+bool TelemetryEncoder::Append(const uint8_t *record, uint8_t length){
+  if (length > _capacity - _length) return false;
+  memcpy(&_buffer[_length], record, length);
+  _length += length;
+  return true;
+}
+
+
+bool TelemetryEncoder::Header(uint8_t slaveAddress, uint32_t millis){
+  uint8_t record[TELEMETRY_MAX_HEADER_BYTES];
+  record[0] = (TELEMETRY_FORM_HEADER << 6) | TELEMETRY_HEADER_METER;
+  record[1] = slaveAddress;
+  uint8_t length = 2 + WriteVarint(&record[2], millis);
+  return Append(record, length);
+}
+
+
+bool TelemetryEncoder::Reading(OctaveField field, uint8_t errorCode, const void *value){
+  uint8_t record[TELEMETRY_MAX_READING_BYTES];
+  return Append(record, EncodeReading(record, field, errorCode, value));
+}
+
+
+// Encode a record into output, which has room for TELEMETRY_MAX_READING_BYTES, returns its length
+uint8_t TelemetryEncoder::EncodeReading(uint8_t *output, OctaveField field, uint8_t errorCode, const void *value){
+  uint8_t index = static_cast<uint8_t>(field);
+  if (errorCode != 0) {
+    output[0] = (TELEMETRY_FORM_ERROR << 6) | index;
+    output[1] = errorCode;
+    return 2;
+  }
+
+  output[0] = (TELEMETRY_FORM_VALUE << 6) | index;
+  uint8_t length = 1;
+  const OctaveRegister info = OctaveRegisterMap::Get(field);
+  switch (info.kind){
+    case OctaveDecodeKind::SerialNumber: {
+      const int16_t *digits = static_cast<const int16_t*>(value);
+      for (uint8_t i = 0; i < 16; i += 2) {
+        uint8_t high = digits[i] >= '0' && digits[i] <= '9' ? digits[i] - '0' : 0xF;
+        uint8_t low = digits[i + 1] >= '0' && digits[i + 1] <= '9' ? digits[i + 1] - '0' : 0xF;
+        output[length++] = (high << 4) | low;
+      }
+      break;
+    }
+    case OctaveDecodeKind::Clock:
+      for (uint8_t i = 0; i < 6; i++) length += WriteVarint(&output[length], ZigzagEncode(static_cast<const int16_t*>(value)[i]));
+      break;
+    case OctaveDecodeKind::UInt32:
+      length += WriteVarint(&output[length], *static_cast<const uint32_t*>(value));
+      break;
+    case OctaveDecodeKind::Int32:
+      length += WriteVarint(&output[length], ZigzagEncode(*static_cast<const int32_t*>(value)));
+      break;
+    case OctaveDecodeKind::Double: {
+      // Both double and float64_t hold the IEEE-754 bits
+      uint64_t bits;
+      memcpy(&bits, value, sizeof(bits));
+      int64_t k;
+      uint8_t d;
+      // The decimal form is only used if it's shorter than the raw bytes
+      if (TelemetryDoubleToDecimal(bits, k, d) && VarintLength((ZigzagEncode(k) << 2) | d) < 8) {
+        length += WriteVarint(&output[length], (ZigzagEncode(k) << 2) | d);
+      }
+      else {
+        output[0] = (TELEMETRY_FORM_RAW << 6) | index;
+        for (uint8_t i = 0; i < 8; i++) output[length++] = static_cast<uint8_t>(bits >> (8 * i));
+      }
+      break;
+    }
+    case OctaveDecodeKind::Write:
+      break;
+    default:
+      // Every other kind is a single int16 value
+      length += WriteVarint(&output[length], ZigzagEncode(*static_cast<const int16_t*>(value)));
+      break;
+  }
+  return length;
+}
+
+
+// Fields of a snapshot, in the order they are encoded, with the offset of their value
+struct TelemetrySnapshotField {
+  OctaveField field;
+  uint8_t offset;
+};
+
+static const TelemetrySnapshotField snapshotFields[] = {
+  {OctaveField::ReadAlarms, offsetof(OctaveSnapshot, alarms)},
+  {OctaveField::SerialNumber, offsetof(OctaveSnapshot, serialNumber)},
+  // Weekday to minutes, in the order of their registers
+  {OctaveField::ReadClock, offsetof(OctaveSnapshot, weekday)},
+  {OctaveField::VolumeUnit, offsetof(OctaveSnapshot, volumeUnit)},
+  {OctaveField::ForwardVolume_double, offsetof(OctaveSnapshot, forwardVolume)},
+  {OctaveField::ReverseVolume_double, offsetof(OctaveSnapshot, reverseVolume)},
+  {OctaveField::ReadVolumeResIndex, offsetof(OctaveSnapshot, volumeResIndex)},
+  {OctaveField::SignedCurrentFlow_double, offsetof(OctaveSnapshot, signedCurrentFlow)},
+  {OctaveField::ReadFlowResIndex, offsetof(OctaveSnapshot, flowResIndex)},
+  {OctaveField::FlowUnit, offsetof(OctaveSnapshot, flowUnit)},
+  {OctaveField::FlowDirection, offsetof(OctaveSnapshot, flowDirection)},
+  {OctaveField::TemperatureValue, offsetof(OctaveSnapshot, temperatureValue)},
+  {OctaveField::TemperatureUnit, offsetof(OctaveSnapshot, temperatureUnit)},
+  {OctaveField::ForwardVolume_uint32, offsetof(OctaveSnapshot, forwardVolume_uint32)},
+  {OctaveField::ReverseVolume_uint32, offsetof(OctaveSnapshot, reverseVolume_uint32)},
+  {OctaveField::SignedCurrentFlow_int32, offsetof(OctaveSnapshot, signedCurrentFlow_int32)},
+  {OctaveField::NetSignedVolume_double, offsetof(OctaveSnapshot, netSignedVolume)},
+  {OctaveField::NetUnsignedVolume_double, offsetof(OctaveSnapshot, netUnsignedVolume)},
+  {OctaveField::NetSignedVolume_int32, offsetof(OctaveSnapshot, netSignedVolume_int32)},
+  {OctaveField::NetUnsignedVolume_uint32, offsetof(OctaveSnapshot, netUnsignedVolume_uint32)},
+};
+
+
+bool TelemetryEncoder::Snapshot(uint8_t slaveAddress, uint32_t millis, const OctaveSnapshot &snapshot){
+  // Written as a whole or not at all
+  uint16_t start = _length;
+  bool written = Header(slaveAddress, millis);
+  const uint8_t *base = reinterpret_cast<const uint8_t*>(&snapshot);
+  for (uint8_t i = 0; i < sizeof(snapshotFields) / sizeof(snapshotFields[0]) && written; i++) {
+    written = Reading(snapshotFields[i].field, 0, &base[snapshotFields[i].offset]);
+  }
+  if (!written) _length = start;
+  return written;
+}
+
+
+bool TelemetryEncoder::Summary(const ConsumptionSummary &summary){
+  uint8_t record[TELEMETRY_MAX_SUMMARY_BYTES];
+  record[0] = (TELEMETRY_FORM_HEADER << 6) | TELEMETRY_HEADER_SUMMARY;
+  record[1] = summary.slaveAddress;
+  uint8_t length = 2;
+  length += WriteVarint(&record[length], summary.startMillis);
+  length += WriteVarint(&record[length], summary.durationMillis);
+  length += WriteVarint(&record[length], ZigzagEncode(summary.forwardVolume));
+  length += WriteVarint(&record[length], ZigzagEncode(summary.reverseVolume));
+  length += WriteVarint(&record[length], summary.flowSamples);
+  length += WriteVarint(&record[length], summary.reverseFlowSamples);
+  length += WriteVarint(&record[length], ZigzagEncode(summary.minFlow));
+  length += WriteVarint(&record[length], ZigzagEncode(summary.maxFlow));
+  length += WriteVarint(&record[length], ZigzagEncode(summary.meanFlow));
+  length += WriteVarint(&record[length], summary.flowVariance);
+  return Append(record, length);
+}
+
+
+/****** OctaveModbusWrapper ******/
+// Encode the result of the last request as a telemetry record, instead of printing it
+// Returns the error code for convenience
+uint8_t OctaveModbusWrapper::EncodeResult(uint8_t errorCode, TelemetryEncoder &encoder){
+  // Requests started from an address are encoded as the field at that address, if there is one
+  OctaveField field = _requestField != OctaveField::Count ? _requestField : OctaveRegisterMap::FieldFromFunctionCode(lastUsedFunctionCode);
+  if (field == OctaveField::Count) return errorCode;
+
+  // Raw reads are decoded by the caller, i.e. snapshots, only their errors are encoded
+  if (errorCode == 0 && _signedResponseSizeinBits == 0) return errorCode;
+  // A read from an address must have the size and number of values of its field, or its value would be
+  // encoded as another type, e.g. an int16 read at 0x18 as ForwardVolume_double
+  if (_requestField == OctaveField::Count && _signedResponseSizeinBits != 0) {
+    const OctaveRegister &info = OctaveRegisterMap::Get(field);
+    bool sameShape = info.kind == OctaveDecodeKind::Write ||
+                     (info.signedValueSizeinBits == _signedResponseSizeinBits && info.numValues == _numValuesToDecode);
+    if (!sameShape) return errorCode;
+  }
+  encoder.Reading(field, errorCode, _output);
+
+  // Return the error code for convenience
+  return errorCode;
+}
@@ -0,0 +1,242 @@
+#include "BusOwner.h"
+
+/****** MpscQueue ******/
+
+MpscQueue::MpscQueue() : _head(&_stub), _tail(&_stub) {
+  _stub.next = nullptr;
+}
+
+
+// Add a node from any task, it must stay alive until it is popped
+void MpscQueue::Push(MpscNode *node){
+  node->next.store(nullptr, std::memory_order_relaxed);
+  // Claim the head, then link the previous head to the node
+  // Between both steps the node is queued but can't be reached from the tail yet
+  MpscNode *previous = _head.exchange(node, std::memory_order_acq_rel);
+  previous->next.store(node, std::memory_order_release);
+}
+
+
+// Remove the oldest node, only from the consumer task
+MpscNode *MpscQueue::Pop(){
+  MpscNode *tail = _tail;
+  MpscNode *next = tail->next.load(std::memory_order_acquire);
+
+  // Skip the placeholder
+  if (tail == &_stub) {
+    if (next == nullptr) return nullptr;
+    _tail = next;
+    tail = next;
+    next = next->next.load(std::memory_order_acquire);
+  }
+
+  if (next != nullptr) {
+    _tail = next;
+    return tail;
+  }
+
+  // The tail is the last linked node. If it isn't the head, a Push() is halfway through
+  if (tail != _head.load(std::memory_order_acquire)) return nullptr;
+
+  // Queue the placeholder behind the tail, so the tail can be removed
+  Push(&_stub);
+  next = tail->next.load(std::memory_order_acquire);
+  if (next != nullptr) {
+    _tail = next;
+    return tail;
+  }
+  return nullptr;
+}
+
+
+/****** OctaveRequest ******/
+
+// Decode a readable field into output, which must be large enough for its value
+void OctaveRequest::Read(OctaveField field, void *output, uint8_t slaveAddress){
+  _type = Type::Read;
+  _field = field;
+  _output = output;
+  _slaveAddress = slaveAddress;
+}
+
+
+void OctaveRequest::Write(OctaveField field, int16_t value, uint8_t slaveAddress){
+  _type = Type::Write;
+  _field = field;
+  _value = value;
+  _slaveAddress = slaveAddress;
+}
+
+
+// Write a Write Multiple Registers field, values must have one register per value of the field
+void OctaveRequest::WriteMultiple(OctaveField field, const uint16_t *values, uint8_t slaveAddress){
+  _type = Type::WriteMultiple;
+  _field = field;
+  _values = values;
+  _slaveAddress = slaveAddress;
+}
+
+
+// Copy a range of input registers to output without decoding them
+void OctaveRequest::ReadRawRegisters(uint8_t startMemAddress, uint8_t numRegisters, uint16_t *output, uint8_t slaveAddress){
+  _type = Type::ReadRawRegisters;
+  _field = OctaveField::Count;
+  _startMemAddress = startMemAddress;
+  _numRegisters = numRegisters;
+  _output = output;
+  _slaveAddress = slaveAddress;
+}
+
+
+void OctaveRequest::SetCallback(OctaveRequestCallback callback, void *context){
+  _callback = callback;
+  _callbackContext = context;
+}
+
+
+// Block the calling task until the request finishes, returns its error code
+uint8_t OctaveRequest::Wait() const {
+  while (_state != State::Done) delay(BUS_OWNER_POLL_DELAY_MS);
+  return _errorCode;
+}
+
+
+/****** BusOwner ******/
+
+BusOwner::BusOwner(OctaveModbusWrapper &octave) : _octave(octave), _running(false) {
+  for (uint8_t i = 0; i < OCTAVE_REQUEST_PRIORITIES; i++) _completed[i] = 0;
+}
+
+
+// Queue a request from any task, returns false if it is already queued
+bool BusOwner::Submit(OctaveRequest &request){
+  // Only the task that owns the request, or its callback, submits it, so this can't race with another Submit()
+  if (request._state == OctaveRequest::State::Queued) return false;
+
+  request._state = OctaveRequest::State::Queued;
+  _queues[static_cast<uint8_t>(request._priority)].Push(&request);
+  return true;
+}
+
+
+// Finish the request on the bus and start the next one, without blocking
+bool BusOwner::Poll(){
+  bool finished = false;
+
+  if (_active != nullptr) {
+    // Still waiting for the current request
+    if (_octave.Poll() == OctaveRequestStatus::Pending) return false;
+
+    OctaveRequest &request = *_active;
+    _active = nullptr;
+    Complete(request, _octave.LastErrorCode());
+    finished = true;
+  }
+
+  // Send the next request right away to keep the bus busy
+  StartNext();
+  return finished;
+}
+
+
+// Start the highest priority queued request, finishing right away the ones that can't be sent
+void BusOwner::StartNext(){
+  while (_active == nullptr) {
+    MpscNode *node = nullptr;
+    for (int8_t priority = OCTAVE_REQUEST_PRIORITIES - 1; priority >= 0 && node == nullptr; priority--) {
+      node = _queues[priority].Pop();
+    }
+    if (node == nullptr) return;
+
+    OctaveRequest &request = *static_cast<OctaveRequest*>(node);
+    uint8_t result = Send(request);
+    if (result == 0) _active = &request;
+    else Complete(request, result);
+  }
+}
+
+
+// Send a request, returns its error code if it couldn't be sent
+uint8_t BusOwner::Send(OctaveRequest &request){
+  if (request._hasPolicy) _octave.SetNextRequestPolicy(request._policy);
+  switch (request._type){
+    case OctaveRequest::Type::Read:
+      return _octave.StartReadInto(request._field, request._output, request._slaveAddress);
+    case OctaveRequest::Type::Write:
+      return _octave.StartWrite(request._field, request._value, request._slaveAddress);
+    case OctaveRequest::Type::WriteMultiple:
+      return _octave.StartWriteMultiple(request._field, request._values, request._slaveAddress);
+    default: // ReadRawRegisters
+      return _octave.StartReadRawRegisters(request._startMemAddress, request._numRegisters,
+                                           static_cast<uint16_t*>(request._output), request._slaveAddress);
+  }
+}
+
+
+// Report the result of a request and hand it back to its task
+void BusOwner::Complete(OctaveRequest &request, uint8_t errorCode){
+  request._errorCode = errorCode;
+  _completed[static_cast<uint8_t>(request._priority)]++;
+  request._state = OctaveRequest::State::Completing;
+  if (request._callback != nullptr) request._callback(request, request._callbackContext);
+
+  // Last, since the task that submitted the request may reuse or destroy it once it is done
+  // Unless the callback submitted it again
+  OctaveRequest::State completing = OctaveRequest::State::Completing;
+  request._state.compare_exchange_strong(completing, OctaveRequest::State::Done);
+}
+
+
+// Run Poll() in a task of its own, pinned to core 0 or 1, or on BUS_OWNER_ANY_CORE
+bool BusOwner::Start(uint8_t core){
+  if (_running) return true;
+  _running = true;
+
+#if defined(ESP32)
+  _finished = false;
+  BaseType_t result = xTaskCreatePinnedToCore(TaskEntry, "OctaveBusOwner", BUS_OWNER_TASK_STACK_SIZE, this,
+                                              BUS_OWNER_TASK_PRIORITY, nullptr,
+                                              core == BUS_OWNER_ANY_CORE ? tskNO_AFFINITY : core);
+  if (result != pdPASS) {
+    _running = false;
+    return false;
+  }
+#else
+  // Host threads aren't pinned, the OS picks the core
+  (void)core;
+  _thread = std::thread(&BusOwner::Run, this);
+#endif
+  return true;
+}
+
+
+// Stop the task after its current poll, requests left in the queues stay queued
+void BusOwner::Stop(){
+  if (!_running) return;
+  _running = false;
+
+#if defined(ESP32)
+  while (!_finished) delay(BUS_OWNER_POLL_DELAY_MS);
+#else
+  if (_thread.joinable()) _thread.join();
+#endif
+}
+
+
+// Body of the bus-owner task, polls until Stop()
+void BusOwner::Run(){
+  while (_running) {
+    Poll();
+    delay(BUS_OWNER_POLL_DELAY_MS);
+  }
+}
+
+
+#if defined(ESP32)
+void BusOwner::TaskEntry(void *owner){
+  BusOwner &self = *static_cast<BusOwner*>(owner);
+  self.Run();
+  self._finished = true;
+  vTaskDelete(nullptr);
+}
+#endif
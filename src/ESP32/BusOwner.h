@@ -0,0 +1,184 @@
+#ifndef __BusOwner_H__
+#define __BusOwner_H__
+
+#include <atomic>
+#include "OctaveModbusWrapper.h"
+
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+// Host build, a thread stands in for the FreeRTOS task
+#include <thread>
+#endif
+
+/****** Settings ******/
+// Stack size, in bytes, and priority of the bus-owner task
+// It should run above the producer tasks, so their requests never wait for the CPU
+#ifndef BUS_OWNER_TASK_STACK_SIZE
+#define BUS_OWNER_TASK_STACK_SIZE 4096
+#endif
+#ifndef BUS_OWNER_TASK_PRIORITY
+#define BUS_OWNER_TASK_PRIORITY 2
+#endif
+
+// Time the bus-owner task, and the tasks waiting for a request, sleep between two checks
+#define BUS_OWNER_POLL_DELAY_MS 1
+
+// Core of a bus-owner task that can run on either core
+#define BUS_OWNER_ANY_CORE 0xFF
+
+// Node of an MpscQueue, embedded in the queued objects
+struct MpscNode {
+    std::atomic<MpscNode*> next;
+};
+
+// Intrusive lock-free queue with any number of producers and a single consumer
+// Push() is wait-free, so a producer is never blocked by another one or by the consumer
+class MpscQueue {
+    public:
+        MpscQueue();
+
+        // Add a node from any task, it must stay alive until it is popped
+        void Push(MpscNode *node);
+        // Remove the oldest node, only from the consumer task
+        // Returns nullptr if the queue is empty, or if the oldest node is halfway through a Push() and
+        // can't be reached yet, in which case it can be popped a moment later
+        MpscNode *Pop();
+
+    private:
+        // Producers push at the head, the consumer pops at the tail
+        std::atomic<MpscNode*> _head;
+        MpscNode *_tail;
+        // Placeholder node, keeps the queue from ever being empty
+        MpscNode _stub;
+};
+
+enum class OctaveRequestPriority : uint8_t {
+    Normal,     // Background polling
+    High        // Sent before any normal request, e.g. alarms
+};
+#define OCTAVE_REQUEST_PRIORITIES 2
+
+class OctaveRequest;
+// Called from the bus-owner task when a request finishes, with the request's context
+typedef void (*OctaveRequestCallback)(OctaveRequest &request, void *context);
+
+// A request submitted to a BusOwner, owned by the task that submits it
+// Set it up with one of Read(), Write(), WriteMultiple() or ReadRawRegisters(), then submit it
+// and wait for it with Wait() or Done(), or with a callback. It can be reused once it is done
+class OctaveRequest : private MpscNode {
+    public:
+        OctaveRequest() { next = nullptr; }
+
+        // Decode a readable field into output, which must be large enough for its value
+        void Read(OctaveField field, void *output, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Write a Write Single Register field
+        void Write(OctaveField field, int16_t value, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Write a Write Multiple Registers field, values must have one register per value of the field
+        void WriteMultiple(OctaveField field, const uint16_t *values, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+        // Copy a range of input registers to output without decoding them
+        void ReadRawRegisters(uint8_t startMemAddress, uint8_t numRegisters, uint16_t *output, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS);
+
+        void SetPriority(OctaveRequestPriority priority) { _priority = priority; }
+        OctaveRequestPriority Priority() const { return _priority; }
+        // Send the request with its own timeout and retries instead of the wrapper's policy
+        void SetPolicy(const OctaveRequestPolicy &policy) { _policy = policy; _hasPolicy = true; }
+        void ClearPolicy() { _hasPolicy = false; }
+        // Set a function to call from the bus-owner task when the request finishes
+        // The callback may submit the request again, e.g. to poll a value continuously
+        void SetCallback(OctaveRequestCallback callback, void *context = nullptr);
+
+        // True once the request finished, its error code and output are then available
+        bool Done() const { return _state == State::Done; }
+        // Same error codes as the blocking requests
+        uint8_t ErrorCode() const { return _errorCode; }
+        // Block the calling task until the request finishes, returns its error code
+        uint8_t Wait() const;
+
+        // Field of the request, OctaveField::Count for raw register reads
+        OctaveField Field() const { return _field; }
+
+    private:
+        friend class BusOwner;
+
+        enum class Type : uint8_t { Read, Write, WriteMultiple, ReadRawRegisters };
+        // Completing while its callback runs, which may submit it again
+        enum class State : uint8_t { Idle, Queued, Completing, Done };
+
+        Type _type = Type::Read;
+        OctaveField _field = OctaveField::Count;
+        uint8_t _slaveAddress = INSTANCE_SLAVE_ADDRESS;
+        // Register range of raw reads
+        uint8_t _startMemAddress = 0;
+        uint8_t _numRegisters = 0;
+        int16_t _value = 0;
+        const uint16_t *_values = nullptr;
+        void *_output = nullptr;
+        OctaveRequestPriority _priority = OctaveRequestPriority::Normal;
+        OctaveRequestPolicy _policy;
+        bool _hasPolicy = false;
+        OctaveRequestCallback _callback = nullptr;
+        void *_callbackContext = nullptr;
+
+        // Written by the bus-owner task, read from the submitting task
+        std::atomic<State> _state{State::Idle};
+        uint8_t _errorCode = 0;
+};
+
+// Owns the OctaveModbusWrapper of a bus, so requests from any number of tasks never overlap
+// Every other task submits OctaveRequests, which the owner sends one at a time, high priority first
+// The latency of a high priority request is bounded by the line time and response timeout of the request
+// already on the bus, plus those of the high priority requests queued before it, whatever the number
+// of normal requests queued
+// Once a BusOwner is used, only its task may call the OctaveModbusWrapper
+class BusOwner {
+    public:
+        explicit BusOwner(OctaveModbusWrapper &octave);
+        ~BusOwner() { Stop(); }
+
+        // Queue a request from any task, returns false if it is already queued
+        bool Submit(OctaveRequest &request);
+
+        // Finish the request on the bus and start the next one, without blocking
+        // Call it from the bus-owner task only, e.g. from loop() when Start() isn't used
+        // Returns true if a request just finished
+        bool Poll();
+
+        // Run Poll() in a task of its own, pinned to core 0 or 1, or on BUS_OWNER_ANY_CORE
+        // Returns false if the task couldn't be created
+        bool Start(uint8_t core = BUS_OWNER_ANY_CORE);
+        // Stop the task after its current poll, requests left in the queues stay queued
+        void Stop();
+        bool Running() const { return _running; }
+
+        // Number of finished requests of a priority, including failed ones
+        uint32_t Completed(OctaveRequestPriority priority) const { return _completed[static_cast<uint8_t>(priority)]; }
+
+    private:
+        OctaveModbusWrapper &_octave;
+        // One queue per priority
+        MpscQueue _queues[OCTAVE_REQUEST_PRIORITIES];
+        // Request on the bus, or nullptr
+        OctaveRequest *_active = nullptr;
+        std::atomic<uint32_t> _completed[OCTAVE_REQUEST_PRIORITIES];
+
+        std::atomic<bool> _running;
+#if defined(ESP32)
+        std::atomic<bool> _finished;
+        static void TaskEntry(void *owner);
+#else
+        std::thread _thread;
+#endif
+
+        // Start the highest priority queued request, finishing right away the ones that can't be sent
+        void StartNext();
+        // Send a request, returns its error code if it couldn't be sent
+        uint8_t Send(OctaveRequest &request);
+        // Report the result of a request and hand it back to its task
+        void Complete(OctaveRequest &request, uint8_t errorCode);
+        // Body of the bus-owner task, polls until Stop()
+        void Run();
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include "ChangeFilter.h"
+#include <string.h>
+
+/****** Deadband arithmetic ******/
+
+// Whether value moved from last by more than absolute, or by more than relative times last
+static bool ExceedsDeadband(double value, double last, double absolute, double relative){
+  if (value != value || last != last) return true; // NaN
+  double threshold = relative * (last < 0.0 ? -last : last);
+  if (threshold < absolute) threshold = absolute;
+  double delta = value - last;
+  return (delta < 0.0 ? -delta : delta) > threshold;
+}
+
+
+// Value of a field with a deadband, as the bits of a double
+static uint64_t RealValue(OctaveDecodeKind kind, const OctaveValue &value){
+  double real;
+  switch (kind){
+    case OctaveDecodeKind::UInt32: real = value.uint32; break;
+    case OctaveDecodeKind::Int32: real = value.int32; break;
+    case OctaveDecodeKind::Double: real = value.float64; break;
+    default: real = value.int16[0]; // Int16
+  }
+  uint64_t bits;
+  memcpy(&bits, &real, sizeof(bits));
+  return bits;
+}
+
+static double BitsToReal(uint64_t bits){
+  double real;
+  memcpy(&real, &bits, sizeof(real));
+  return real;
+}
+
+
+// Whether a field has a deadband, i.e. is a single number
+static bool HasDeadband(OctaveField field){
+  OctaveDecodeKind kind = OctaveRegisterMap::Get(field).kind;
+  return kind == OctaveDecodeKind::Int16 || kind == OctaveDecodeKind::UInt32 ||
+         kind == OctaveDecodeKind::Int32 || kind == OctaveDecodeKind::Double;
+}
+
+
+// FNV-1a hash of the registers of a field without a deadband, any change of the value changes it
+static uint64_t HashValue(OctaveField field, const OctaveValue &value){
+  const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&value);
+  uint32_t hash = 2166136261UL;
+  for (uint8_t i = 0; i < OctaveRegisterMap::ValueSize(field); i++) {
+    hash ^= bytes[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+
+/****** ChangeFilter ******/
+
+bool ChangeFilter::SetDeadband(OctaveField field, double absolute, double relative, uint32_t heartbeatMillis){
+  if (field >= OctaveField::Count || OctaveRegisterMap::Get(field).functionCode != 0x04) return false;
+
+  int8_t index = Find(field);
+  if (index < 0) index = Add(field);
+  if (index < 0) return false;
+
+  TrackedField &tracked = _fields[index];
+  tracked.absolute = absolute;
+  tracked.relative = relative;
+  tracked.heartbeatMillis = heartbeatMillis;
+  tracked.configured = true;
+  return true;
+}
+
+
+bool ChangeFilter::RemoveDeadband(OctaveField field){
+  int8_t index = Find(field);
+  if (index < 0 || !_fields[index].configured) return false;
+
+  // The order of the fields doesn't matter, move the last one to the gap
+  _fields[index] = _fields[--_numFields];
+  return true;
+}
+
+
+// Forget the last reported readings, so the next reading of every field is reported
+void ChangeFilter::Reset(){
+  for (uint8_t i = 0; i < _numFields; i++) _fields[i].reported = false;
+}
+
+
+// Whether a reading must be reported. If so, it becomes the last reported reading of its field
+bool ChangeFilter::Update(OctaveField field, uint8_t errorCode, const OctaveValue &value, uint32_t nowMillis){
+  _received++;
+
+  int8_t index = Find(field);
+  if (index < 0) index = Add(field);
+  // No room to track it, report every reading
+  if (index < 0) {
+    _reported++;
+    return true;
+  }
+
+  TrackedField &tracked = _fields[index];
+  bool deadband = HasDeadband(field);
+  uint64_t current = 0;
+  if (errorCode == 0) current = deadband ? RealValue(OctaveRegisterMap::Get(field).kind, value) : HashValue(field, value);
+
+  bool report;
+  if (!tracked.reported || errorCode != tracked.lastErrorCode) report = true;
+  else if (tracked.heartbeatMillis != CHANGE_FILTER_NO_HEARTBEAT && nowMillis - tracked.lastMillis >= tracked.heartbeatMillis) report = true;
+  // Repeated errors are only reported by the heartbeat
+  else if (errorCode != 0 || current == tracked.lastValue) report = false;
+  else if (!deadband) report = true;
+  else report = ExceedsDeadband(BitsToReal(current), BitsToReal(tracked.lastValue), tracked.absolute, tracked.relative);
+
+  if (report) {
+    tracked.lastMillis = nowMillis;
+    tracked.lastErrorCode = errorCode;
+    // Keep the last good value through errors, so the next good one is compared to it
+    if (errorCode == 0) tracked.lastValue = current;
+    tracked.reported = true;
+    _reported++;
+  }
+  return report;
+}
+
+
+void ChangeFilter::SetCallback(OctaveReadCallback callback, void *context){
+  _callback = callback;
+  _callbackContext = context;
+}
+
+
+// OctaveReadCallback to give to the source of readings, with the ChangeFilter as its context
+void ChangeFilter::Forward(OctaveField field, uint8_t errorCode, const OctaveValue &value, void *context){
+  ChangeFilter &self = *static_cast<ChangeFilter*>(context);
+  // A reading of another meter would be compared with this meter's last reported one
+  uint8_t slaveAddress = self._slaveAddress == INSTANCE_SLAVE_ADDRESS ? self._octave.SlaveAddress() : self._slaveAddress;
+  if (self._octave.RequestSlaveAddress() != slaveAddress) return;
+  if (self.Update(field, errorCode, value, millis()) && self._callback != nullptr) {
+    self._callback(field, errorCode, value, self._callbackContext);
+  }
+}
+
+
+int8_t ChangeFilter::Find(OctaveField field) const {
+  for (uint8_t i = 0; i < _numFields; i++) {
+    if (_fields[i].field == field) return i;
+  }
+  return -1;
+}
+
+
+// Start tracking a field with no deadband, returns its index or -1 if there is no room
+int8_t ChangeFilter::Add(OctaveField field){
+  if (_numFields >= CHANGE_FILTER_MAX_FIELDS) return -1;
+
+  TrackedField &tracked = _fields[_numFields];
+  tracked.field = field;
+  tracked.absolute = 0.0;
+  tracked.relative = 0.0;
+  tracked.heartbeatMillis = CHANGE_FILTER_NO_HEARTBEAT;
+  tracked.lastMillis = 0;
+  tracked.lastValue = 0;
+  tracked.lastErrorCode = 0;
+  tracked.reported = false;
+  tracked.configured = false;
+  return _numFields++;
+}
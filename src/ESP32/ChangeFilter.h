@@ -0,0 +1,95 @@
+#ifndef __ChangeFilter_H__
+#define __ChangeFilter_H__
+
+#include "OctaveModbusWrapper.h"
+
+/****** Settings ******/
+// Maximum number of fields tracked by a ChangeFilter
+#ifndef CHANGE_FILTER_MAX_FIELDS
+#define CHANGE_FILTER_MAX_FIELDS 12
+#endif
+
+// Heartbeat of the fields that are only reported when they change
+#define CHANGE_FILTER_NO_HEARTBEAT 0
+
+// Reports a reading only when it moved past the deadband of its field, when its error code changed,
+// or when the field was silent for its heartbeat interval, so unchanged values aren't sent upstream
+// Readings are compared to the last reported one, so a slow drift is reported once it adds up to the deadband
+// Sits between a source of readings, e.g. a PollScheduler or the wrapper's read callback, and the uplink:
+//   ChangeFilter filter(octave, slaveAddress);
+//   scheduler.SetCallback(ChangeFilter::Forward, &filter);
+//   filter.SetCallback(SendUpstream);
+// The readings of a field are compared with each other whatever meter they come from, so use one ChangeFilter per meter
+class ChangeFilter {
+    public:
+        // Filter the readings of one meter of octave. Forward() ignores the readings of the other meters,
+        // so the filter can sit on the read callback of a wrapper that serves several
+        explicit ChangeFilter(const OctaveModbusWrapper &octave, uint8_t slaveAddress = INSTANCE_SLAVE_ADDRESS)
+            : _octave(octave), _slaveAddress(slaveAddress) {}
+
+        // Report a field once it moves by more than absolute, in the unit of the field, or by more than
+        // relative times its last reported value, whichever is larger, and at least every heartbeatMillis
+        // Fields without a deadband are reported on any change, without heartbeat
+        // Only the Int16, UInt32, Int32 and Double fields have a deadband, codes, alarms, the serial number
+        // and the clock are reported on any change
+        // Returns false if the field isn't readable or CHANGE_FILTER_MAX_FIELDS fields are already tracked
+        bool SetDeadband(OctaveField field, double absolute, double relative = 0.0, uint32_t heartbeatMillis = CHANGE_FILTER_NO_HEARTBEAT);
+        // Go back to reporting a field on any change, returns false if it had no deadband
+        bool RemoveDeadband(OctaveField field);
+        // Forget the last reported readings, so the next reading of every field is reported
+        void Reset();
+
+        // Whether a reading must be reported, in O(1). If so, it becomes the last reported reading of its field
+        // The reading must be of the filter's meter, Update() doesn't check it
+        // Readings of untracked fields are always reported once CHANGE_FILTER_MAX_FIELDS fields are tracked
+        bool Update(OctaveField field, uint8_t errorCode, const OctaveValue &value, uint32_t nowMillis);
+
+        // Set a function to call with the readings to report, from Forward()
+        void SetCallback(OctaveReadCallback callback, void *context = nullptr);
+        // OctaveReadCallback to give to the source of readings, with the ChangeFilter as its context
+        // Calls Update() with millis() and forwards the readings to report to the callback
+        // Readings of requests to other meters are dropped, they are neither counted nor forwarded
+        static void Forward(OctaveField field, uint8_t errorCode, const OctaveValue &value, void *context);
+
+        /****** Statistics ******/
+        // Readings given to Update(), and readings reported
+        uint32_t Received() const { return _received; }
+        uint32_t Reported() const { return _reported; }
+        void ResetStats() { _received = 0; _reported = 0; }
+
+    private:
+        struct TrackedField {
+            double absolute;
+            double relative;
+            uint32_t heartbeatMillis;
+            // Last reported reading: its time, error code and value. The value is the bits of a double
+            // for the fields with a deadband, and a hash of the registers for the others
+            uint32_t lastMillis;
+            uint64_t lastValue;
+            uint8_t lastErrorCode;
+            OctaveField field;
+            // Whether a reading was reported since Reset()
+            bool reported;
+            // Added by SetDeadband(), not just by a reading
+            bool configured;
+        };
+
+        const OctaveModbusWrapper &_octave;
+        uint8_t _slaveAddress;
+
+        TrackedField _fields[CHANGE_FILTER_MAX_FIELDS];
+        uint8_t _numFields = 0;
+
+        OctaveReadCallback _callback = nullptr;
+        void *_callbackContext = nullptr;
+
+        uint32_t _received = 0;
+        uint32_t _reported = 0;
+
+        // Index of a tracked field, or -1
+        int8_t Find(OctaveField field) const;
+        // Start tracking a field with no deadband, returns its index or -1 if there is no room
+        int8_t Add(OctaveField field);
+};
+
+#endif
@@ -0,0 +1,275 @@
+#include "DoubleFormat.h"
+#include <string.h>
+
+// Grisu2, from Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers", PLDI 2010
+// Integer operations only, so it runs on the IEEE-754 bits of both double and float64_t
+
+/****** Do-it-yourself floating point ******/
+// f * 2^e, with a 64-bit significand
+struct DiyFp {
+  uint64_t f;
+  int16_t e;
+};
+
+#define DIY_HIDDEN_BIT 0x0010000000000000ULL
+#define DIY_FRACTION_MASK 0x000FFFFFFFFFFFFFULL
+
+// Shift the significand left until its top bit is set
+static DiyFp Normalize(DiyFp x){
+  while ((x.f & 0x8000000000000000ULL) == 0) {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+}
+
+// Product of the significands, rounded to the upper 64 bits, without 128-bit integers
+static DiyFp Multiply(DiyFp a, DiyFp b){
+  uint64_t aHigh = a.f >> 32, aLow = a.f & 0xFFFFFFFF;
+  uint64_t bHigh = b.f >> 32, bLow = b.f & 0xFFFFFFFF;
+  uint64_t highHigh = aHigh * bHigh;
+  uint64_t lowHigh = aLow * bHigh;
+  uint64_t highLow = aHigh * bLow;
+  uint64_t lowLow = aLow * bLow;
+  // Middle 32 bits, plus half of the dropped part, to round
+  uint64_t middle = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + (lowHigh & 0xFFFFFFFF) + (1ULL << 31);
+
+  DiyFp product;
+  product.f = highHigh + (highLow >> 32) + (lowHigh >> 32) + (middle >> 32);
+  product.e = a.e + b.e + 64;
+  return product;
+}
+
+// Boundaries of the interval of reals that round to the value, normalized to the same exponent
+static void Boundaries(DiyFp v, DiyFp &minus, DiyFp &plus){
+  plus.f = (v.f << 1) + 1;
+  plus.e = v.e - 1;
+  plus = Normalize(plus);
+  // At a power of 2, the next double below is closer
+  if (v.f == DIY_HIDDEN_BIT) {
+    minus.f = (v.f << 2) - 1;
+    minus.e = v.e - 2;
+  }
+  else {
+    minus.f = (v.f << 1) - 1;
+    minus.e = v.e - 1;
+  }
+  minus.f <<= minus.e - plus.e;
+  minus.e = plus.e;
+}
+
+// Cached powers of ten, 10^-348 to 10^340 in steps of 8, as normalized 64-bit significands and binary exponents
+static const uint64_t cachedPowersF[] = {
+  0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+  0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+  0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+  0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+  0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+  0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+  0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+  0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+  0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+  0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+  0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+  0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+  0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+  0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+  0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+  0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+  0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+  0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+  0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+  0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+  0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+  0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+static const int16_t cachedPowersE[] = {
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+  -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+  -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+  -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+  56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+  375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+  694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+  1013, 1039, 1066
+};
+
+static DiyFp CachedPower(uint8_t index){
+  DiyFp power;
+  power.f = cachedPowersF[index];
+  power.e = cachedPowersE[index];
+  return power;
+}
+
+// Cached power that brings a binary exponent e into [-60, -32], returns it with its decimal exponent, negated
+static DiyFp CachedPowerFor(int16_t e, int16_t &decimalExponent){
+  // ceil((-61 - e) * log10(2)) + 347, with log10(2) as 78913 / 2^18, exact for these exponents
+  int32_t k = -((static_cast<int32_t>(e + 61) * 78913) >> 18) + 347;
+  uint8_t index = static_cast<uint8_t>((k >> 3) + 1);
+  decimalExponent = -(-348 + static_cast<int16_t>(index) * 8);
+  return CachedPower(index);
+}
+
+
+/****** Digit generation ******/
+static const uint32_t powersOf10_32[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+static uint8_t CountDecimalDigits(uint32_t n){
+  uint8_t digits = 1;
+  while (digits < 10 && n >= powersOf10_32[digits]) digits++;
+  return digits;
+}
+
+// Move the last digit down while the result gets closer to the value and stays within the interval
+static void Round(char *buffer, uint8_t length, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance){
+  while (rest < distance && delta - rest >= tenKappa &&
+         (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance)) {
+    buffer[length - 1]--;
+    rest += tenKappa;
+  }
+}
+
+// Generate the shortest digits of high within delta of it, i.e. within the rounding interval
+// w is the scaled value, its distance to high picks the closest digits. Returns the number of digits
+static uint8_t GenerateDigits(DiyFp w, DiyFp high, uint64_t delta, char *buffer, int16_t &decimalExponent){
+  const uint8_t shift = static_cast<uint8_t>(-high.e);
+  const uint64_t one = 1ULL << shift;
+  const uint64_t distance = high.f - w.f;
+  // Integral and fractional parts of high
+  uint32_t integral = static_cast<uint32_t>(high.f >> shift);
+  uint64_t fractional = high.f & (one - 1);
+  int8_t kappa = static_cast<int8_t>(CountDecimalDigits(integral));
+  uint8_t length = 0;
+
+  while (kappa > 0) {
+    uint32_t divisor = powersOf10_32[kappa - 1];
+    uint8_t digit = static_cast<uint8_t>(integral / divisor);
+    integral %= divisor;
+    if (digit != 0 || length != 0) buffer[length++] = '0' + digit;
+    kappa--;
+    uint64_t rest = (static_cast<uint64_t>(integral) << shift) + fractional;
+    if (rest <= delta) {
+      decimalExponent += kappa;
+      Round(buffer, length, delta, rest, static_cast<uint64_t>(powersOf10_32[kappa]) << shift, distance);
+      return length;
+    }
+  }
+
+  // Fractional digits, the distance grows with each digit
+  uint64_t unitScale = 1;
+  for (;;) {
+    fractional *= 10;
+    delta *= 10;
+    unitScale *= 10;
+    uint8_t digit = static_cast<uint8_t>(fractional >> shift);
+    if (digit != 0 || length != 0) buffer[length++] = '0' + digit;
+    fractional &= one - 1;
+    kappa--;
+    if (fractional < delta) {
+      decimalExponent += kappa;
+      Round(buffer, length, delta, fractional, one, distance * unitScale);
+      return length;
+    }
+  }
+}
+
+
+/****** Formatting ******/
+// Write digits with the decimal point placed for a decimal exponent, in fixed or scientific notation
+static uint8_t Layout(char *output, const char *digits, uint8_t length, int16_t decimalExponent){
+  // Position of the decimal point from the first digit
+  int16_t point = length + decimalExponent;
+  uint8_t position = 0;
+
+  if (point >= -3 && point <= 17) {
+    if (point <= 0) {
+      // 0.000ddd
+      output[position++] = '0';
+      output[position++] = '.';
+      for (int16_t i = point; i < 0; i++) output[position++] = '0';
+      memcpy(&output[position], digits, length);
+      position += length;
+    }
+    else if (point >= length) {
+      // ddd000, integers without a decimal point
+      memcpy(&output[position], digits, length);
+      position += length;
+      for (int16_t i = length; i < point; i++) output[position++] = '0';
+    }
+    else {
+      // dd.ddd
+      memcpy(&output[position], digits, point);
+      position += point;
+      output[position++] = '.';
+      memcpy(&output[position], &digits[point], length - point);
+      position += length - point;
+    }
+  }
+  else {
+    // d.ddde+XX, with at least 2 exponent digits like printf
+    output[position++] = digits[0];
+    if (length > 1) {
+      output[position++] = '.';
+      memcpy(&output[position], &digits[1], length - 1);
+      position += length - 1;
+    }
+    int16_t exponent = point - 1;
+    output[position++] = 'e';
+    output[position++] = exponent < 0 ? '-' : '+';
+    if (exponent < 0) exponent = -exponent;
+    if (exponent >= 100) output[position++] = '0' + exponent / 100;
+    output[position++] = '0' + exponent / 10 % 10;
+    output[position++] = '0' + exponent % 10;
+  }
+  output[position] = '\0';
+  return position;
+}
+
+
+// Write the shortest decimal that reads back as the same value
+uint8_t FormatDouble(double value, char *output){
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  bool negative = (bits >> 63) != 0;
+  int16_t biasedExponent = static_cast<int16_t>((bits >> 52) & 0x7FF);
+  uint64_t fraction = bits & DIY_FRACTION_MASK;
+
+  uint8_t position = 0;
+  if (biasedExponent == 0x7FF) {
+    if (fraction != 0) {
+      memcpy(output, "nan", 4);
+      return 3;
+    }
+    if (negative) output[position++] = '-';
+    memcpy(&output[position], "inf", 4);
+    return position + 3;
+  }
+  if (negative) output[position++] = '-';
+  if (biasedExponent == 0 && fraction == 0) {
+    output[position++] = '0';
+    output[position] = '\0';
+    return position;
+  }
+
+  // Subnormals have no hidden bit and the exponent of the smallest normals. Their boundaries are taken
+  // before normalizing, from the unshifted fraction, since their interval is 2^-1075 on both sides, even
+  // at a power of 2. Normalizing first would narrow it and give longer digits, e.g. for 5e-324
+  DiyFp v;
+  v.f = biasedExponent != 0 ? fraction | DIY_HIDDEN_BIT : fraction;
+  v.e = biasedExponent != 0 ? biasedExponent - 1075 : -1074;
+
+  DiyFp minus, plus;
+  Boundaries(v, minus, plus);
+  int16_t decimalExponent;
+  DiyFp power = CachedPowerFor(plus.e, decimalExponent);
+  DiyFp w = Multiply(Normalize(v), power);
+  DiyFp high = Multiply(plus, power);
+  DiyFp low = Multiply(minus, power);
+  // Stay inside the interval despite the rounding of the products
+  low.f++;
+  high.f--;
+
+  char digits[18];
+  uint8_t length = GenerateDigits(w, high, high.f - low.f, digits, decimalExponent);
+  return position + Layout(&output[position], digits, length, decimalExponent);
+}
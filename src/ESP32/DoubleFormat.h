@@ -0,0 +1,15 @@
+#ifndef __DoubleFormat_H__
+#define __DoubleFormat_H__
+
+#include <stdint.h>
+
+// Size of the buffers written by FormatDouble(), e.g. "-1.2345678901234567e-308" and its terminator
+#define FORMAT_DOUBLE_BUFFER_SIZE 25
+
+// Write the shortest decimal that reads back as the same double, like printf's "%g" with as many digits as needed
+// Uses Grisu2, which is shortest for all but a few values, and then only one digit longer, and never allocates
+// Fixed notation from 1e-4 to 1e17, scientific notation otherwise, "nan", "inf" and "-inf" for special values
+// output must have room for FORMAT_DOUBLE_BUFFER_SIZE chars, returns the length without the terminator
+uint8_t FormatDouble(double value, char *output);
+
+#endif
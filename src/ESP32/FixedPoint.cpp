@@ -0,0 +1,49 @@
+#include "FixedPoint.h"
+
+// Multiply a double, given as its IEEE-754 bits, by scale and truncate it toward zero
+TruncationResult ScaleAndTruncate(uint64_t bits, uint16_t scale, int32_t minScaled, int32_t maxScaled, int32_t &output){
+  const bool negative = (bits >> 63) != 0;
+  const uint16_t exponent = (bits >> 52) & 0x7FF;
+  const uint64_t fraction = bits & 0xFFFFFFFFFFFFFULL;
+  // Largest magnitude allowed for the sign of the input
+  const uint32_t limit = negative ? static_cast<uint32_t>(-static_cast<int64_t>(minScaled)) : static_cast<uint32_t>(maxScaled);
+
+  // NaN
+  if (exponent == 0x7FF && fraction != 0) return TruncationResult::Overflow;
+  // Zero and subnormal numbers, the scaled value is below 1
+  if (exponent == 0) {
+    output = 0;
+    return TruncationResult::Ok;
+  }
+
+  // |input| = mantissa * 2^-shift, with the implicit leading 1
+  const uint64_t mantissa = fraction | (1ULL << 52);
+  int16_t shift = 1075 - static_cast<int16_t>(exponent);
+  // Integers of 2^52 and above, and infinity, are beyond any 32-bit limit
+  if (shift <= 0) return negative ? TruncationResult::Underflow : TruncationResult::Overflow;
+
+  // The product fits in 64 bits, since scale is at most MAX_FIXED_POINT_SCALE
+  uint64_t product = mantissa * scale;
+
+  // Round the product to 53 significant bits, to nearest with ties to even,
+  // so the result matches a double multiplication followed by a cast
+  // The product is at least 2^52, so it isn't 0
+  const uint8_t productBits = 64 - __builtin_clzll(product);
+  const uint8_t dropped = productBits > 53 ? productBits - 53 : 0;
+  if (dropped > 0) {
+    const uint64_t remainder = product & ((1ULL << dropped) - 1);
+    const uint64_t half = 1ULL << (dropped - 1);
+    product >>= dropped;
+    if (remainder > half || (remainder == half && (product & 1) != 0)) product++;
+    shift -= dropped;
+    // 53 significant bits or more with no fractional part left, beyond any 32-bit limit
+    if (shift <= 0) return negative ? TruncationResult::Underflow : TruncationResult::Overflow;
+  }
+
+  // Truncate toward zero
+  const uint64_t magnitude = shift < 64 ? product >> shift : 0;
+  if (magnitude > limit) return negative ? TruncationResult::Underflow : TruncationResult::Overflow;
+
+  output = negative ? static_cast<int32_t>(-static_cast<int64_t>(magnitude)) : static_cast<int32_t>(magnitude);
+  return TruncationResult::Ok;
+}
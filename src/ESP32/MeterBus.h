@@ -0,0 +1,61 @@
+#ifndef __MeterBus_H__
+#define __MeterBus_H__
+
+#include "OctaveModbusWrapper.h"
+
+// Round-robin snapshot poller for several meters sharing one RS-485 bus
+// Every meter is read with the same OctaveModbusWrapper, changing the slave address per request,
+// and a new request is sent as soon as the previous one finishes to keep the bus busy
+class MeterBus {
+    public:
+        // slaveAddresses, snapshots and errorCodes must have numMeters elements and outlive the MeterBus
+        // snapshots[i] and errorCodes[i] hold the last snapshot and error code of the meter at slaveAddresses[i]
+        MeterBus(OctaveModbusWrapper &octave, const uint8_t *slaveAddresses, uint8_t numMeters,
+                 OctaveSnapshot *snapshots, uint8_t *errorCodes);
+
+        // Advance the poll cycle without blocking, call it as often as possible from loop()
+        // Returns the index of the meter whose snapshot just finished, or -1 if none did
+        int16_t Poll();
+
+        uint8_t NumMeters() const { return _numMeters; }
+        uint8_t SlaveAddress(uint8_t meter) const { return _slaveAddresses[meter]; }
+        // Last snapshot and error code of a meter, also in the snapshots and errorCodes arrays
+        const OctaveSnapshot &Snapshot(uint8_t meter) const { return _snapshotOutputs[meter]; }
+        uint8_t ErrorCode(uint8_t meter) const { return _errorCodes[meter]; }
+        // Raw registers of the snapshot that Poll() just finished, valid until the next Poll()
+        const uint16_t *Registers() const { return _registers; }
+
+        // Number of finished Modbus transactions, including failed ones
+        uint32_t Transactions() const { return _transactions; }
+        // Number of finished snapshots, including failed ones
+        uint32_t Snapshots() const { return _snapshots; }
+        // Aggregate bus throughput since the first Poll() or the last ResetStats()
+        float TransactionsPerSecond() const;
+        void ResetStats();
+
+    private:
+        OctaveModbusWrapper &_octave;
+        const uint8_t *_slaveAddresses;
+        uint8_t _numMeters;
+        OctaveSnapshot *_snapshotOutputs;
+        uint8_t *_errorCodes;
+
+        // Raw registers of the snapshot in progress
+        uint16_t _registers[SNAPSHOT_NUM_REGISTERS];
+        // Index of the meter being read and offset of the next register block
+        uint8_t _currentMeter = 0;
+        uint8_t _registerOffset = 0;
+        // Size of the register block on the bus, is 0 when no request is pending
+        uint8_t _pendingRegisters = 0;
+
+        /****** Statistics ******/
+        uint32_t _transactions = 0;
+        uint32_t _snapshots = 0;
+        uint32_t _statsStartMillis = 0;
+        bool _statsStarted = false;
+
+        // Send the request for the next register block of the current meter
+        void StartNextRequest();
+};
+
+#endif
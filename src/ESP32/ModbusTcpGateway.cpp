@@ -0,0 +1,198 @@
+#include "ModbusTcpGateway.h"
+
+// Big-endian 16-bit field of a frame
+static uint16_t ReadWord(const uint8_t *bytes){
+  return (static_cast<uint16_t>(bytes[0]) << 8) | bytes[1];
+}
+
+static void WriteWord(uint8_t *bytes, uint16_t value){
+  bytes[0] = value >> 8;
+  bytes[1] = value & 0xFF;
+}
+
+
+ModbusTcpGateway::ModbusTcpGateway(MeterBus &bus, RegisterMirror *mirrors)
+  : _bus(bus), _mirrors(mirrors), _server(MODBUS_TCP_PORT, MODBUS_TCP_MAX_CLIENTS) {
+  for (uint8_t i = 0; i < bus.NumMeters(); i++) {
+    _mirrors[i].valid = false;
+    // Not read yet, same as a meter that doesn't answer
+    _mirrors[i].errorCode = 5;
+    _mirrors[i].updatedMillis = 0;
+  }
+  for (uint8_t i = 0; i < MODBUS_TCP_MAX_CLIENTS; i++) _clients[i].length = 0;
+}
+
+
+// Start listening, returns false if the port couldn't be opened
+bool ModbusTcpGateway::begin(uint16_t port){
+  _server.begin(port);
+  return static_cast<bool>(_server);
+}
+
+
+void ModbusTcpGateway::end(){
+  for (uint8_t i = 0; i < MODBUS_TCP_MAX_CLIENTS; i++) _clients[i].socket.stop();
+  _server.end();
+}
+
+
+// Refresh the mirror and answer the clients without blocking
+uint8_t ModbusTcpGateway::Poll(){
+  int16_t meter = _bus.Poll();
+  if (meter >= 0) Refresh(meter);
+
+  Accept();
+  uint8_t answered = 0;
+  for (uint8_t i = 0; i < MODBUS_TCP_MAX_CLIENTS; i++) {
+    if (_clients[i].socket) answered += Serve(_clients[i]);
+  }
+  return answered;
+}
+
+
+// Copy the registers of a meter whose read just finished to its mirror
+void ModbusTcpGateway::Refresh(uint8_t meter){
+  RegisterMirror &mirror = _mirrors[meter];
+  mirror.errorCode = _bus.ErrorCode(meter);
+  // Keep the last good registers of a meter that stopped answering
+  if (mirror.errorCode != 0) return;
+
+  memcpy(mirror.registers, _bus.Registers(), sizeof(mirror.registers));
+  mirror.updatedMillis = millis();
+  mirror.valid = true;
+}
+
+
+// Take the pending connections, closing the ones there is no room for
+void ModbusTcpGateway::Accept(){
+  for (;;) {
+    WiFiClient connection = _server.available();
+    if (!connection) return;
+
+    Client *slot = nullptr;
+    for (uint8_t i = 0; i < MODBUS_TCP_MAX_CLIENTS && slot == nullptr; i++) {
+      if (!_clients[i].socket) slot = &_clients[i];
+    }
+    if (slot == nullptr) {
+      connection.stop();
+      continue;
+    }
+    slot->socket = connection;
+    slot->length = 0;
+  }
+}
+
+
+uint8_t ModbusTcpGateway::ConnectedClients() const {
+  uint8_t connected = 0;
+  for (uint8_t i = 0; i < MODBUS_TCP_MAX_CLIENTS; i++) {
+    // connected() isn't const on the ESP32
+    if (const_cast<WiFiClient&>(_clients[i].socket).connected()) connected++;
+  }
+  return connected;
+}
+
+
+// Read what a client sent and answer its complete frames, returns the number of requests answered
+uint8_t ModbusTcpGateway::Serve(Client &client){
+  uint8_t answered = 0;
+  uint8_t response[MODBUS_TCP_MAX_FRAME_BYTES];
+
+  int available = client.socket.available();
+  while (available > 0) {
+    // Frames may arrive split over several segments, or several in one segment
+    uint16_t room = MODBUS_TCP_MAX_FRAME_BYTES - client.length;
+    int received = client.socket.read(client.frame + client.length, available < room ? static_cast<uint16_t>(available) : room);
+    if (received <= 0) break;
+    client.length += received;
+    available -= received;
+
+    while (client.length >= MODBUS_TCP_HEADER_BYTES) {
+      // The length field counts the unit identifier and the PDU
+      uint16_t frameLength = 6 + ReadWord(&client.frame[4]);
+      if (frameLength < MODBUS_TCP_HEADER_BYTES + 1 || frameLength > MODBUS_TCP_MAX_FRAME_BYTES) {
+        // Not Modbus, there is no way to find the next frame
+        client.socket.stop();
+        client.length = 0;
+        return answered;
+      }
+      if (client.length < frameLength) break;
+
+      uint16_t responseLength = HandleFrame(client.frame, frameLength, response);
+      if (responseLength == 0) {
+        client.socket.stop();
+        client.length = 0;
+        return answered;
+      }
+      client.socket.write(response, responseLength);
+      answered++;
+
+      client.length -= frameLength;
+      memmove(client.frame, client.frame + frameLength, client.length);
+    }
+  }
+
+  if (!client.socket.connected()) {
+    client.socket.stop();
+    client.length = 0;
+  }
+  return answered;
+}
+
+
+// Answer a Modbus TCP request frame from the mirror
+uint16_t ModbusTcpGateway::HandleFrame(const uint8_t *request, uint16_t length, uint8_t *response){
+  // The protocol identifier is 0 for Modbus
+  if (length < MODBUS_TCP_HEADER_BYTES + 1 || ReadWord(&request[2]) != 0) return 0;
+  if (6 + ReadWord(&request[4]) != length) return 0;
+  _requests++;
+
+  const uint8_t unitId = request[6];
+  const uint8_t *pdu = &request[MODBUS_TCP_HEADER_BYTES];
+  const uint16_t pduLength = length - MODBUS_TCP_HEADER_BYTES;
+
+  int16_t meter = -1;
+  for (uint8_t i = 0; i < _bus.NumMeters() && meter < 0; i++) {
+    if (_bus.SlaveAddress(i) == unitId) meter = i;
+  }
+  if (meter < 0) return Exception(request, MODBUS_EXCEPTION_GATEWAY_TARGET_FAILED, response);
+
+  if (pdu[0] != 0x04) return Exception(request, MODBUS_EXCEPTION_ILLEGAL_FUNCTION, response);
+  if (pduLength != 5) return Exception(request, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+
+  uint16_t startAddress = ReadWord(&pdu[1]);
+  uint16_t numRegisters = ReadWord(&pdu[3]);
+  if (numRegisters == 0 || numRegisters > MODBUS_MAX_READ_REGISTERS) {
+    return Exception(request, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+  }
+  // The mirror starts at register 0, so only the end of the request is checked
+  static_assert(SNAPSHOT_START_ADDRESS == 0, "The mirrored registers must start at address 0");
+  if (static_cast<uint32_t>(startAddress) + numRegisters > SNAPSHOT_START_ADDRESS + SNAPSHOT_NUM_REGISTERS) {
+    return Exception(request, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+  }
+
+  const RegisterMirror &mirror = _mirrors[meter];
+  bool stale = mirror.errorCode != 0 && MODBUS_TCP_MAX_AGE_MS != 0 && millis() - mirror.updatedMillis > MODBUS_TCP_MAX_AGE_MS;
+  if (!mirror.valid || stale) return Exception(request, MODBUS_EXCEPTION_GATEWAY_TARGET_FAILED, response);
+
+  // Same transaction, protocol and unit identifiers
+  memcpy(response, request, MODBUS_TCP_HEADER_BYTES);
+  WriteWord(&response[4], 3 + 2 * numRegisters);
+  response[7] = 0x04;
+  response[8] = 2 * numRegisters;
+  for (uint16_t i = 0; i < numRegisters; i++) {
+    WriteWord(&response[9 + 2 * i], mirror.registers[startAddress - SNAPSHOT_START_ADDRESS + i]);
+  }
+  return 9 + 2 * numRegisters;
+}
+
+
+// Write an exception response to a request, returns its length
+uint16_t ModbusTcpGateway::Exception(const uint8_t *request, uint8_t exceptionCode, uint8_t *response){
+  _exceptions++;
+  memcpy(response, request, MODBUS_TCP_HEADER_BYTES);
+  WriteWord(&response[4], 3);
+  response[7] = request[MODBUS_TCP_HEADER_BYTES] | 0x80;
+  response[8] = exceptionCode;
+  return 9;
+}
@@ -0,0 +1,101 @@
+#ifndef __ModbusTcpGateway_H__
+#define __ModbusTcpGateway_H__
+
+#include <WiFi.h>
+#include "MeterBus.h"
+
+/****** Settings ******/
+#define MODBUS_TCP_PORT 502
+
+// Maximum number of upstream clients connected at once, more connections are closed right away
+#ifndef MODBUS_TCP_MAX_CLIENTS
+#define MODBUS_TCP_MAX_CLIENTS 4
+#endif
+
+// Age after which the mirror of a meter that stopped answering isn't served anymore, 0 to serve it at any age
+#ifndef MODBUS_TCP_MAX_AGE_MS
+#define MODBUS_TCP_MAX_AGE_MS 60000
+#endif
+
+// MBAP header: transaction, protocol, length and unit identifier
+#define MODBUS_TCP_HEADER_BYTES 7
+// Largest Modbus TCP frame, the header and a 253-byte PDU
+#define MODBUS_TCP_MAX_FRAME_BYTES 260
+
+// Modbus exception codes sent upstream
+#define MODBUS_EXCEPTION_ILLEGAL_FUNCTION 0x01
+#define MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS 0x02
+#define MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE 0x03
+#define MODBUS_EXCEPTION_GATEWAY_TARGET_FAILED 0x0B
+
+// Input registers of one meter, as last read from the bus
+struct RegisterMirror {
+    uint16_t registers[SNAPSHOT_NUM_REGISTERS];
+    // millis() of the last good read
+    uint32_t updatedMillis;
+    // Error code of the last read, the registers are from the last good one
+    uint8_t errorCode;
+    // Whether the registers were read at least once
+    bool valid;
+};
+
+// Modbus TCP server answering Read Input Registers (04) from a mirror of the input registers of the meters
+// A MeterBus reads the registers of every meter round robin, as fast as the bus allows, and the upstream
+// clients are answered from the mirror without touching the bus, so the bus load doesn't depend on the
+// number of clients nor on how often they poll. The unit identifier of a request is the meter's slave address
+// A meter that stopped answering is served from its last good read for MODBUS_TCP_MAX_AGE_MS, then answered
+// with a Gateway Target Device Failed to Respond exception, like one that was never read
+class ModbusTcpGateway {
+    public:
+        // mirrors must have one element per meter of the bus and outlive the gateway
+        ModbusTcpGateway(MeterBus &bus, RegisterMirror *mirrors);
+
+        // Start listening, returns false if the port couldn't be opened
+        bool begin(uint16_t port = MODBUS_TCP_PORT);
+        // Close the clients and stop listening
+        void end();
+
+        // Refresh the mirror and answer the clients without blocking, call it as often as possible from loop()
+        // Returns the number of requests answered
+        uint8_t Poll();
+
+        // Answer a Modbus TCP request frame from the mirror, response must have room for MODBUS_TCP_MAX_FRAME_BYTES
+        // Returns the length of the response, 0 if the frame isn't Modbus and must be dropped
+        uint16_t HandleFrame(const uint8_t *request, uint16_t length, uint8_t *response);
+
+        const RegisterMirror &Mirror(uint8_t meter) const { return _mirrors[meter]; }
+        uint8_t ConnectedClients() const;
+
+        /****** Statistics ******/
+        // Requests answered, including exceptions, and exceptions sent
+        uint32_t Requests() const { return _requests; }
+        uint32_t Exceptions() const { return _exceptions; }
+        void ResetStats() { _requests = 0; _exceptions = 0; }
+
+    private:
+        // Upstream connection and its partial frame
+        struct Client {
+            WiFiClient socket;
+            uint8_t frame[MODBUS_TCP_MAX_FRAME_BYTES];
+            uint16_t length;
+        };
+
+        MeterBus &_bus;
+        RegisterMirror *_mirrors;
+        WiFiServer _server;
+        Client _clients[MODBUS_TCP_MAX_CLIENTS];
+
+        uint32_t _requests = 0;
+        uint32_t _exceptions = 0;
+
+        // Copy the registers of a meter whose read just finished to its mirror
+        void Refresh(uint8_t meter);
+        // Take the pending connections, closing the ones there is no room for
+        void Accept();
+        // Read what a client sent and answer its complete frames, returns the number of requests answered
+        uint8_t Serve(Client &client);
+        // Write an exception response to a request, returns its length
+        uint16_t Exception(const uint8_t *request, uint8_t exceptionCode, uint8_t *response);
+};
+
+#endif
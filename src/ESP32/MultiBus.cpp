@@ -0,0 +1,170 @@
+#include "MultiBus.h"
+
+/****** SnapshotStore ******/
+
+SnapshotStore::SnapshotStore(SnapshotStoreEntry *entries, uint16_t numEntries)
+  : _entries(entries), _numEntries(numEntries) {
+  for (uint16_t i = 0; i < numEntries; i++) {
+    _entries[i].updates = 0;
+    // No snapshot yet, same as a meter that doesn't answer
+    _entries[i].errorCode = 5;
+  }
+#if defined(ESP32)
+  _mutex = xSemaphoreCreateMutex();
+#endif
+}
+
+
+SnapshotStore::~SnapshotStore(){
+#if defined(ESP32)
+  vSemaphoreDelete(_mutex);
+#endif
+}
+
+
+// Store the snapshot and error code of a meter, snapshot is ignored if errorCode isn't 0
+void SnapshotStore::Publish(uint16_t index, const OctaveSnapshot &snapshot, uint8_t errorCode){
+  if (index >= _numEntries) return;
+
+  Lock();
+  // Keep the last good snapshot of a meter that stopped answering
+  if (errorCode == 0) _entries[index].snapshot = snapshot;
+  _entries[index].errorCode = errorCode;
+  _entries[index].updates++;
+  Unlock();
+}
+
+
+bool SnapshotStore::Read(uint16_t index, SnapshotStoreEntry *output) const {
+  if (index >= _numEntries) return false;
+
+  Lock();
+  *output = _entries[index];
+  Unlock();
+  return true;
+}
+
+
+void SnapshotStore::Lock() const {
+#if defined(ESP32)
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+#else
+  _mutex.lock();
+#endif
+}
+
+
+void SnapshotStore::Unlock() const {
+#if defined(ESP32)
+  xSemaphoreGive(_mutex);
+#else
+  _mutex.unlock();
+#endif
+}
+
+
+/****** MultiBus ******/
+
+MultiBus::MultiBus(SnapshotStore &store) : _store(store), _running(false) {}
+
+
+// Add a bus, polled by its own task on core 0 or 1, or on MULTI_BUS_ANY_CORE
+bool MultiBus::AddBus(MeterBus &bus, uint16_t firstEntry, uint8_t core){
+  if (_running || _numBuses >= MULTI_BUS_MAX_BUSES) return false;
+  if (firstEntry + bus.NumMeters() > _store.Size()) return false;
+
+  Pipeline &pipeline = _pipelines[_numBuses++];
+  pipeline.owner = this;
+  pipeline.bus = &bus;
+  pipeline.firstEntry = firstEntry;
+  pipeline.core = core;
+  pipeline.snapshots = 0;
+  pipeline.elapsedMillis = 0;
+  return true;
+}
+
+
+// Start one task per bus, returns false if a task couldn't be created
+bool MultiBus::Start(){
+  if (_running) return true;
+  _running = true;
+
+  for (uint8_t i = 0; i < _numBuses; i++) {
+    Pipeline &pipeline = _pipelines[i];
+    pipeline.snapshots = 0;
+    pipeline.elapsedMillis = 0;
+#if defined(ESP32)
+    pipeline.finished = false;
+    BaseType_t result = xTaskCreatePinnedToCore(TaskEntry, "OctaveBus", MULTI_BUS_TASK_STACK_SIZE, &pipeline,
+                                                MULTI_BUS_TASK_PRIORITY, &pipeline.task,
+                                                pipeline.core == MULTI_BUS_ANY_CORE ? tskNO_AFFINITY : pipeline.core);
+    if (result != pdPASS) {
+      // Stop the tasks that did start
+      pipeline.finished = true;
+      for (uint8_t j = i + 1; j < _numBuses; j++) _pipelines[j].finished = true;
+      Stop();
+      return false;
+    }
+#else
+    // Host threads aren't pinned, the OS spreads them over the cores
+    pipeline.thread = std::thread(&MultiBus::RunPipeline, this, std::ref(pipeline));
+#endif
+  }
+  return true;
+}
+
+
+// Stop the tasks, waiting for each one to finish its current poll
+void MultiBus::Stop(){
+  if (!_running) return;
+  _running = false;
+
+  for (uint8_t i = 0; i < _numBuses; i++) {
+#if defined(ESP32)
+    while (!_pipelines[i].finished) delay(MULTI_BUS_POLL_DELAY_MS);
+#else
+    if (_pipelines[i].thread.joinable()) _pipelines[i].thread.join();
+#endif
+  }
+}
+
+
+float MultiBus::SnapshotsPerSecond(uint8_t bus) const {
+  uint32_t elapsedMillis = _pipelines[bus].elapsedMillis;
+  if (elapsedMillis == 0) return 0.0;
+  return _pipelines[bus].snapshots * 1000.0 / elapsedMillis;
+}
+
+
+float MultiBus::SnapshotsPerSecond() const {
+  float total = 0.0;
+  for (uint8_t i = 0; i < _numBuses; i++) total += SnapshotsPerSecond(i);
+  return total;
+}
+
+
+// Body of the bus tasks, polls the bus until Stop()
+void MultiBus::RunPipeline(Pipeline &pipeline){
+  // Each task keeps its own time, the host clock is per thread
+  uint32_t startMillis = millis();
+
+  while (_running) {
+    int16_t meter = pipeline.bus->Poll();
+    if (meter >= 0) {
+      _store.Publish(pipeline.firstEntry + meter, pipeline.bus->Snapshot(meter), pipeline.bus->ErrorCode(meter));
+      pipeline.snapshots++;
+      pipeline.elapsedMillis = millis() - startMillis;
+    }
+    delay(MULTI_BUS_POLL_DELAY_MS);
+  }
+}
+
+
+#if defined(ESP32)
+void MultiBus::TaskEntry(void *pipeline){
+  Pipeline &self = *static_cast<Pipeline*>(pipeline);
+  self.owner->RunPipeline(self);
+  self.finished = true;
+  vTaskDelete(nullptr);
+}
+#endif
@@ -0,0 +1,128 @@
+#ifndef __MultiBus_H__
+#define __MultiBus_H__
+
+#include <atomic>
+#include "MeterBus.h"
+
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#else
+// Host build, threads stand in for the FreeRTOS tasks
+#include <mutex>
+#include <thread>
+#endif
+
+/****** Settings ******/
+// Maximum number of buses of a MultiBus, the ESP32 has three UARTs
+#ifndef MULTI_BUS_MAX_BUSES
+#define MULTI_BUS_MAX_BUSES 3
+#endif
+
+// Stack size, in bytes, and priority of the bus tasks
+#ifndef MULTI_BUS_TASK_STACK_SIZE
+#define MULTI_BUS_TASK_STACK_SIZE 4096
+#endif
+#ifndef MULTI_BUS_TASK_PRIORITY
+#define MULTI_BUS_TASK_PRIORITY 1
+#endif
+
+// Time each bus task sleeps between two polls of its bus, so lower priority tasks of its core can run
+#define MULTI_BUS_POLL_DELAY_MS 1
+
+// Core of the bus tasks that can run on either core
+#define MULTI_BUS_ANY_CORE 0xFF
+
+// Last snapshot of a meter in a SnapshotStore
+struct SnapshotStoreEntry {
+    OctaveSnapshot snapshot;
+    // Number of snapshots published to the entry, readers can compare it to detect new ones
+    uint32_t updates;
+    uint8_t errorCode;
+};
+
+// Last snapshot of every meter of a gateway, published by the bus tasks and read from any task
+// Every access copies a whole entry under a mutex, so readers never see half of a snapshot
+class SnapshotStore {
+    public:
+        // entries must have numEntries elements and outlive the store
+        SnapshotStore(SnapshotStoreEntry *entries, uint16_t numEntries);
+        ~SnapshotStore();
+
+        // Store the snapshot and error code of a meter, snapshot is ignored if errorCode isn't 0
+        void Publish(uint16_t index, const OctaveSnapshot &snapshot, uint8_t errorCode);
+        // Copy an entry, returns false if index is out of range
+        bool Read(uint16_t index, SnapshotStoreEntry *output) const;
+        uint16_t Size() const { return _numEntries; }
+
+    private:
+        SnapshotStoreEntry *_entries;
+        uint16_t _numEntries;
+#if defined(ESP32)
+        SemaphoreHandle_t _mutex;
+#else
+        mutable std::mutex _mutex;
+#endif
+
+        void Lock() const;
+        void Unlock() const;
+};
+
+// Polls several RS-485 buses in parallel, one MeterBus per UART, each in its own task
+// pinned to a core, and publishes every snapshot to a shared SnapshotStore
+// Each bus is bound by its own line time, so the gateway's throughput grows with the number of buses
+class MultiBus {
+    public:
+        explicit MultiBus(SnapshotStore &store);
+        ~MultiBus() { Stop(); }
+
+        // Add a bus, polled by its own task on core 0 or 1, or on MULTI_BUS_ANY_CORE
+        // The snapshot of meter i of the bus is published to store entry firstEntry + i
+        // Every bus must use its own OctaveModbusWrapper and UART, since the tasks don't share them
+        // Returns false if the bus doesn't fit in the store, MULTI_BUS_MAX_BUSES were added, or the buses are running
+        bool AddBus(MeterBus &bus, uint16_t firstEntry, uint8_t core = MULTI_BUS_ANY_CORE);
+
+        // Start one task per bus, returns false if a task couldn't be created
+        bool Start();
+        // Stop the tasks, waiting for each one to finish its current poll
+        void Stop();
+        bool Running() const { return _running; }
+
+        uint8_t NumBuses() const { return _numBuses; }
+        // Snapshots finished by a bus, including failed ones, and its throughput since Start()
+        uint32_t Snapshots(uint8_t bus) const { return _pipelines[bus].snapshots; }
+        float SnapshotsPerSecond(uint8_t bus) const;
+        // Throughput of the whole gateway
+        float SnapshotsPerSecond() const;
+
+    private:
+        struct Pipeline {
+            MultiBus *owner;
+            MeterBus *bus;
+            uint16_t firstEntry;
+            uint8_t core;
+            // Updated by the task of the bus, read from any task
+            std::atomic<uint32_t> snapshots;
+            std::atomic<uint32_t> elapsedMillis;
+#if defined(ESP32)
+            TaskHandle_t task;
+            std::atomic<bool> finished;
+#else
+            std::thread thread;
+#endif
+        };
+
+        SnapshotStore &_store;
+        Pipeline _pipelines[MULTI_BUS_MAX_BUSES];
+        uint8_t _numBuses = 0;
+        std::atomic<bool> _running;
+
+        // Body of the bus tasks, polls the bus until Stop()
+        void RunPipeline(Pipeline &pipeline);
+#if defined(ESP32)
+        static void TaskEntry(void *pipeline);
+#endif
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "PollScheduler.h"
+
+// Number of registers of a field
+static uint8_t FieldRegisters(OctaveField field){
+  return OctaveRegisterMap::ValueSize(field) / sizeof(uint16_t);
+}
+
+
+PollScheduler::PollScheduler(OctaveModbusWrapper &octave, uint8_t slaveAddress)
+  : _octave(octave), _slaveAddress(slaveAddress) {}
+
+
+// Read a field every periodMillis, or once with POLL_PERIOD_ONCE, starting on the next Poll()
+bool PollScheduler::AddField(OctaveField field, uint32_t periodMillis, uint8_t priority){
+  if (field >= OctaveField::Count || OctaveRegisterMap::Get(field).functionCode != 0x04 || periodMillis == 0) return false;
+
+  int8_t index = Find(field);
+  if (index < 0) {
+    if (_numFields >= POLL_SCHEDULER_MAX_FIELDS) return false;
+    index = _numFields++;
+    _fields[index].field = field;
+    _fields[index].missedDeadlines = 0;
+    _fields[index].inRequest = false;
+  }
+
+  ScheduledField &scheduled = _fields[index];
+  scheduled.periodMillis = periodMillis;
+  scheduled.priority = priority;
+  scheduled.dueMillis = millis();
+  scheduled.done = false;
+  return true;
+}
+
+
+bool PollScheduler::RemoveField(OctaveField field){
+  int8_t index = Find(field);
+  if (index < 0) return false;
+
+  // The order of the fields doesn't matter, move the last one to the gap
+  _fields[index] = _fields[--_numFields];
+  return true;
+}
+
+
+void PollScheduler::SetCallback(OctaveReadCallback callback, void *context){
+  _callback = callback;
+  _callbackContext = context;
+}
+
+
+uint8_t PollScheduler::Poll(){
+  uint8_t finishedFields = 0;
+
+  if (_pendingRegisters > 0) {
+    // Still waiting for the current request
+    if (_octave.Poll() == OctaveRequestStatus::Pending) return 0;
+
+    _pendingRegisters = 0;
+    finishedFields = FinishRequest(_octave.LastErrorCode());
+  }
+
+  // Send the next request right away to keep the bus busy
+  StartNextRequest();
+  return finishedFields;
+}
+
+
+uint32_t PollScheduler::MissedDeadlines(OctaveField field) const {
+  int8_t index = Find(field);
+  return index < 0 ? 0 : _fields[index].missedDeadlines;
+}
+
+
+void PollScheduler::ResetStats(){
+  for (uint8_t i = 0; i < _numFields; i++) _fields[i].missedDeadlines = 0;
+  _missedDeadlines = 0;
+  _maxLatenessMillis = 0;
+  _requests = 0;
+  _fieldReads = 0;
+}
+
+
+int8_t PollScheduler::Find(OctaveField field) const {
+  for (uint8_t i = 0; i < _numFields; i++) {
+    if (_fields[i].field == field) return i;
+  }
+  return -1;
+}
+
+
+bool PollScheduler::IsDue(const ScheduledField &scheduled, uint32_t now) const {
+  // Signed difference, so the comparison survives the millis() overflow
+  return !scheduled.done && !scheduled.inRequest && static_cast<int32_t>(now - scheduled.dueMillis) >= 0;
+}
+
+
+// Pick the due fields of the next request, merge their ranges and send it
+void PollScheduler::StartNextRequest(){
+  uint32_t now = millis();
+
+  // The request is built around the due field with the highest priority, then the one due the longest
+  int8_t lead = -1;
+  for (uint8_t i = 0; i < _numFields; i++) {
+    if (!IsDue(_fields[i], now)) continue;
+    if (lead < 0 || _fields[i].priority > _fields[lead].priority
+        || (_fields[i].priority == _fields[lead].priority && static_cast<int32_t>(_fields[i].dueMillis - _fields[lead].dueMillis) < 0)) {
+      lead = i;
+    }
+  }
+  if (lead < 0) return;
+
+  uint8_t startAddress = OctaveRegisterMap::Get(_fields[lead].field).startMemAddress;
+  uint8_t endAddress = startAddress + FieldRegisters(_fields[lead].field);
+  _fields[lead].inRequest = true;
+
+  // Grow the range with the due field that wastes the fewest registers, until none fits
+  // Fields that aren't due yet only join if they are already inside the range, since they are read for free
+  while (true) {
+    int8_t best = -1;
+    uint8_t bestGap = POLL_SCHEDULER_MAX_GAP_REGISTERS + 1;
+
+    for (uint8_t i = 0; i < _numFields; i++) {
+      ScheduledField &candidate = _fields[i];
+      if (candidate.done || candidate.inRequest) continue;
+
+      uint8_t fieldStart = OctaveRegisterMap::Get(candidate.field).startMemAddress;
+      uint8_t fieldEnd = fieldStart + FieldRegisters(candidate.field);
+      uint8_t newStart = fieldStart < startAddress ? fieldStart : startAddress;
+      uint8_t newEnd = fieldEnd > endAddress ? fieldEnd : endAddress;
+      if (newEnd - newStart > SNAPSHOT_NUM_REGISTERS) continue;
+
+      // Registers added to the range that don't belong to the field
+      uint8_t addedRegisters = (newEnd - newStart) - (endAddress - startAddress);
+      uint8_t fieldRegisters = fieldEnd - fieldStart;
+      uint8_t gap = addedRegisters > fieldRegisters ? addedRegisters - fieldRegisters : 0;
+
+      if (IsDue(candidate, now) ? gap < bestGap : addedRegisters == 0 && bestGap > 0) {
+        best = i;
+        bestGap = gap;
+      }
+    }
+    if (best < 0) break;
+
+    uint8_t fieldStart = OctaveRegisterMap::Get(_fields[best].field).startMemAddress;
+    uint8_t fieldEnd = fieldStart + FieldRegisters(_fields[best].field);
+    if (fieldStart < startAddress) startAddress = fieldStart;
+    if (fieldEnd > endAddress) endAddress = fieldEnd;
+    _fields[best].inRequest = true;
+  }
+
+  uint8_t numRegisters = endAddress - startAddress;
+  uint8_t result = _octave.StartReadRawRegisters(startAddress, numRegisters, _registers, _slaveAddress);
+  if (result != 0) {
+    // If the channel is busy with another request, try again on the next Poll()
+    for (uint8_t i = 0; i < _numFields; i++) _fields[i].inRequest = false;
+    return;
+  }
+
+  _requestStartAddress = startAddress;
+  _pendingRegisters = numRegisters;
+  _requests++;
+  for (uint8_t i = 0; i < _numFields; i++) {
+    if (_fields[i].inRequest) Reschedule(_fields[i], now);
+  }
+}
+
+
+// Move the due time of a field that is being read past now, counting the deadlines it missed
+void PollScheduler::Reschedule(ScheduledField &scheduled, uint32_t now){
+  if (scheduled.periodMillis == POLL_PERIOD_ONCE) {
+    // Undone in FinishRequest() if the read fails
+    scheduled.done = true;
+    return;
+  }
+
+  int32_t latenessMillis = static_cast<int32_t>(now - scheduled.dueMillis);
+  if (latenessMillis < 0) {
+    // Read early along with other fields, start a new period from now
+    scheduled.dueMillis = now + scheduled.periodMillis;
+    return;
+  }
+
+  if (static_cast<uint32_t>(latenessMillis) > _maxLatenessMillis) _maxLatenessMillis = latenessMillis;
+
+  // Keep the phase of the schedule, skipping the periods that were missed entirely
+  uint32_t missed = static_cast<uint32_t>(latenessMillis) / scheduled.periodMillis;
+  scheduled.missedDeadlines += missed;
+  _missedDeadlines += missed;
+  scheduled.dueMillis += (missed + 1) * scheduled.periodMillis;
+}
+
+
+// Decode and report the fields of the finished request, returns their number
+uint8_t PollScheduler::FinishRequest(uint8_t errorCode){
+  uint8_t finishedFields = 0;
+  OctaveValue value = {};
+
+  for (uint8_t i = 0; i < _numFields; i++) {
+    ScheduledField &scheduled = _fields[i];
+    if (!scheduled.inRequest) continue;
+    scheduled.inRequest = false;
+
+    if (errorCode == 0) {
+      const OctaveRegister &reg = OctaveRegisterMap::Get(scheduled.field);
+      OctaveModbusWrapper::DecodeField(scheduled.field, &_registers[reg.startMemAddress - _requestStartAddress], &value);
+    }
+    else if (scheduled.periodMillis == POLL_PERIOD_ONCE) {
+      // Try again on the next request
+      scheduled.done = false;
+    }
+
+    if (_callback != nullptr) _callback(scheduled.field, errorCode, value, _callbackContext);
+    finishedFields++;
+  }
+
+  _fieldReads += finishedFields;
+  return finishedFields;
+}
@@ -0,0 +1,202 @@
+#include "ReadingLog.h"
+#include "Varint.h"
+
+// Encode a sample against the previous one, returns the number of bytes written
+static uint8_t EncodeEntry(uint8_t *output, const ReadingLogState &previous, int32_t scaledValue, uint32_t millis){
+  uint32_t interval = millis - previous.millis;
+  uint8_t length = WriteVarint(output, ZigzagEncode(static_cast<int64_t>(scaledValue) - previous.scaledValue));
+  length += WriteVarint(&output[length], ZigzagEncode(static_cast<int64_t>(interval) - previous.interval));
+  return length;
+}
+
+// Apply the deltas of an entry to the previous sample
+static void ApplyEntry(ReadingLogState &state, uint64_t valueDelta, uint64_t intervalDelta){
+  state.scaledValue = static_cast<int32_t>(state.scaledValue + ZigzagDecode(valueDelta));
+  state.interval = static_cast<uint32_t>(state.interval + ZigzagDecode(intervalDelta));
+  state.millis += state.interval;
+}
+
+
+/****** Ring buffer ******/
+ReadingLog::ReadingLog(uint8_t *storage, uint16_t capacity) : _storage(storage), _capacity(capacity) {}
+
+
+// Compress a value with truncateDoubleto32bits and append it
+uint8_t ReadingLog::Append(double value, uint32_t millis){
+  int32_t scaledValue;
+  uint8_t result = truncateDoubleto32bits(value, scaledValue);
+  AppendScaled(scaledValue, millis);
+  return result;
+}
+
+
+void ReadingLog::AppendScaled(int32_t scaledValue, uint32_t millis){
+  if (_capacity < READING_LOG_MAX_ENTRY_BYTES) return;
+
+  // The first sample is its own reference, so it takes 2 bytes like the rest
+  if (!_started) {
+    _tailState.scaledValue = scaledValue;
+    _tailState.millis = millis;
+    _tailState.interval = 0;
+    _headState = _tailState;
+    _started = true;
+  }
+
+  uint8_t entry[READING_LOG_MAX_ENTRY_BYTES];
+  uint8_t length = EncodeEntry(entry, _tailState, scaledValue, millis);
+
+  // Every entry takes at least 2 bytes, so this evicts at most 5 entries
+  while (_capacity - _usedBytes < length) EvictOldest();
+
+  uint16_t position = (_head + _usedBytes) % _capacity;
+  for (uint8_t i = 0; i < length; i++) {
+    _storage[position] = entry[i];
+    if (++position == _capacity) position = 0;
+  }
+  _usedBytes += length;
+  _size++;
+
+  _tailState.interval = millis - _tailState.millis;
+  _tailState.scaledValue = scaledValue;
+  _tailState.millis = millis;
+}
+
+
+void ReadingLog::Clear(){
+  _head = 0;
+  _usedBytes = 0;
+  _size = 0;
+  _started = false;
+}
+
+
+// Length of the entry at a position of the ring buffer, two varints
+uint16_t ReadingLog::EntryLength(uint16_t position) const{
+  uint16_t length = 0;
+  for (uint8_t varints = 0; varints < 2; length++) {
+    if ((_storage[position] & 0x80) == 0) varints++;
+    if (++position == _capacity) position = 0;
+  }
+  return length;
+}
+
+
+// Decode the entry at a position into state, returns the position of the next entry
+uint16_t ReadingLog::DecodeEntry(uint16_t position, ReadingLogState &state) const{
+  // Copy the entry out of the ring buffer, since it can wrap around its end
+  uint8_t entry[READING_LOG_MAX_ENTRY_BYTES];
+  uint16_t length = EntryLength(position);
+  for (uint16_t i = 0; i < length; i++) {
+    entry[i] = _storage[position];
+    if (++position == _capacity) position = 0;
+  }
+
+  uint64_t valueDelta, intervalDelta;
+  uint8_t valueLength = ReadVarint(entry, length, valueDelta);
+  ReadVarint(&entry[valueLength], length - valueLength, intervalDelta);
+  ApplyEntry(state, valueDelta, intervalDelta);
+  return position;
+}
+
+
+// Remove the oldest entry, its sample becomes the reference of the next one
+void ReadingLog::EvictOldest(){
+  uint16_t length = EntryLength(_head);
+  DecodeEntry(_head, _headState);
+  _head = (_head + length) % _capacity;
+  _usedBytes -= length;
+  _size--;
+  _evicted++;
+}
+
+
+ReadingLog::Iterator ReadingLog::Begin() const{
+  Iterator iterator;
+  iterator.state = _headState;
+  iterator.position = _head;
+  iterator.remaining = _size;
+  return iterator;
+}
+
+
+bool ReadingLog::Next(Iterator &iterator, ReadingLogSample *sample) const{
+  if (iterator.remaining == 0) return false;
+
+  iterator.position = DecodeEntry(iterator.position, iterator.state);
+  iterator.remaining--;
+  sample->scaledValue = iterator.state.scaledValue;
+  sample->millis = iterator.state.millis;
+  return true;
+}
+
+
+// Stream format: the sample before the first entry, as zigzag varint value, varint timestamp
+// and varint interval, followed by the entries as they are stored in the log
+uint16_t ReadingLog::Drain(uint8_t *output, uint16_t maxBytes){
+  if (_size == 0) return 0;
+
+  uint8_t header[READING_LOG_MAX_HEADER_BYTES];
+  uint8_t headerLength = WriteVarint(header, ZigzagEncode(_headState.scaledValue));
+  headerLength += WriteVarint(&header[headerLength], _headState.millis);
+  headerLength += WriteVarint(&header[headerLength], _headState.interval);
+  if (headerLength + EntryLength(_head) > maxBytes) return 0;
+
+  memcpy(output, header, headerLength);
+  uint16_t written = headerLength;
+
+  // Copy whole entries while they fit
+  while (_size > 0) {
+    uint16_t length = EntryLength(_head);
+    if (written + length > maxBytes) break;
+
+    for (uint16_t i = 0; i < length; i++) output[written + i] = _storage[(_head + i) % _capacity];
+    written += length;
+
+    DecodeEntry(_head, _headState);
+    _head = (_head + length) % _capacity;
+    _usedBytes -= length;
+    _size--;
+  }
+  return written;
+}
+
+
+/****** Stream decoder ******/
+ReadingLogReader::ReadingLogReader(const uint8_t *bytes, uint16_t length) : _bytes(bytes), _length(length){
+  uint64_t value, millis, interval;
+  uint8_t read = ReadVarint(_bytes, _length, value);
+  _valid = read != 0;
+  if (_valid) {
+    _position = read;
+    read = ReadVarint(&_bytes[_position], _length - _position, millis);
+    _valid = read != 0;
+    _position += read;
+  }
+  if (_valid) {
+    read = ReadVarint(&_bytes[_position], _length - _position, interval);
+    _valid = read != 0;
+    _position += read;
+  }
+  if (_valid) {
+    _state.scaledValue = static_cast<int32_t>(ZigzagDecode(value));
+    _state.millis = static_cast<uint32_t>(millis);
+    _state.interval = static_cast<uint32_t>(interval);
+  }
+}
+
+
+bool ReadingLogReader::Next(ReadingLogSample *sample){
+  if (!_valid || _position >= _length) return false;
+
+  uint64_t valueDelta, intervalDelta;
+  uint8_t valueLength = ReadVarint(&_bytes[_position], _length - _position, valueDelta);
+  if (valueLength == 0) return false;
+  uint8_t intervalLength = ReadVarint(&_bytes[_position + valueLength], _length - _position - valueLength, intervalDelta);
+  if (intervalLength == 0) return false;
+  _position += valueLength + intervalLength;
+
+  ApplyEntry(_state, valueDelta, intervalDelta);
+  sample->scaledValue = _state.scaledValue;
+  sample->millis = _state.millis;
+  return true;
+}
@@ -0,0 +1,42 @@
+#include "RegisterDecoding.h"
+
+// The back-to-back case is a separate loop with a constant stride,
+// which the compiler can unroll and vectorize
+
+void DecodeUInt32Array(const uint16_t* registers, size_t stride, uint32_t* output, size_t count){
+  if (stride == 2) {
+    for (size_t i = 0; i < count; i++) output[i] = DecodeABCD(&registers[2 * i]);
+  }
+  else {
+    for (size_t i = 0; i < count; i++) output[i] = DecodeABCD(&registers[stride * i]);
+  }
+}
+
+void DecodeInt32Array(const uint16_t* registers, size_t stride, int32_t* output, size_t count){
+  if (stride == 2) {
+    for (size_t i = 0; i < count; i++) output[i] = static_cast<int32_t>(DecodeABCD(&registers[2 * i]));
+  }
+  else {
+    for (size_t i = 0; i < count; i++) output[i] = static_cast<int32_t>(DecodeABCD(&registers[stride * i]));
+  }
+}
+
+void DecodeDoubleArray(const uint16_t* registers, size_t stride, double* output, size_t count){
+  if (stride == 4) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // In little-endian memory, 4 back-to-back registers hold the value in HG FE DC BA order
+    // Swapping the bytes of every register leaves them in host order, which vectorizes well
+    for (size_t i = 0; i < count; i++) {
+      uint64_t bits;
+      memcpy(&bits, &registers[4 * i], sizeof(bits));
+      bits = ((bits & 0x00FF00FF00FF00FFULL) << 8) | ((bits >> 8) & 0x00FF00FF00FF00FFULL);
+      memcpy(&output[i], &bits, sizeof(bits));
+    }
+#else
+    for (size_t i = 0; i < count; i++) output[i] = DecodeHGFEDCBA(&registers[4 * i]);
+#endif
+  }
+  else {
+    for (size_t i = 0; i < count; i++) output[i] = DecodeHGFEDCBA(&registers[stride * i]);
+  }
+}
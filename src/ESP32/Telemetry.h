@@ -0,0 +1,82 @@
+#ifndef __Telemetry_H__
+#define __Telemetry_H__
+
+#include "OctaveModbusWrapper.h"
+
+// Compact binary telemetry, the alternative to printing results with InterpretResult()
+// A stream is a sequence of records, each one a tag byte followed by its payload
+// The tag holds the record form in its 2 high bits and a field or header index in the 6 low bits
+// Multi-byte numbers are varints, see Varint.h, and signed numbers are zigzag encoded first
+#define TELEMETRY_FORM_VALUE 0      // Value of a field, in the compact form of its decode kind
+#define TELEMETRY_FORM_ERROR 1      // Error code of a field's request, 1 byte
+#define TELEMETRY_FORM_RAW 2        // Double field as its 8 IEEE-754 bytes, least significant first
+#define TELEMETRY_FORM_HEADER 3     // Header, see TELEMETRY_HEADER_*
+#define TELEMETRY_INDEX_MASK 0x3F
+
+// Start of the readings of a meter: slave address byte, then a varint timestamp in ms
+#define TELEMETRY_HEADER_METER 0
+// Summary of a ConsumptionAggregator window, on its own: slave address byte, then varints of the start and duration
+// in ms, zigzag forward and reverse volumes, flow and reverse flow samples, zigzag minimum, maximum and mean flows,
+// and the flow variance, see ConsumptionSummary
+#define TELEMETRY_HEADER_SUMMARY 1
+
+// Compact values of each decode kind:
+// Int16, alarms, unit, direction and resolution codes: zigzag varint
+// SerialNumber: 8 bytes, 2 digits per byte, high nibble first, 0xF for registers that aren't digits
+// Clock: 6 zigzag varints, weekday to minutes
+// UInt32: varint. Int32: zigzag varint
+// Double: varint of (zigzag(k) << 2) + d, for the value k / 10^d, d from 0 to TELEMETRY_MAX_DECIMALS
+// Doubles that aren't exactly such a decimal, i.e. the nearest double to it, are sent in TELEMETRY_FORM_RAW
+// Write: no payload, the record acknowledges the write
+#define TELEMETRY_MAX_DECIMALS 3
+
+// Largest records: a header, and the tag and payload of one reading, i.e. a clock of 6 3-byte varints
+#define TELEMETRY_MAX_HEADER_BYTES 7
+#define TELEMETRY_MAX_READING_BYTES 19
+// Largest snapshot: a header and one record per field of the snapshot
+#define TELEMETRY_MAX_SNAPSHOT_BYTES 142
+// Largest window summary
+#define TELEMETRY_MAX_SUMMARY_BYTES 67
+
+struct ConsumptionSummary;
+
+static_assert(static_cast<uint8_t>(OctaveField::Count) <= TELEMETRY_INDEX_MASK + 1, "Field indices must fit in a tag");
+
+// Writes telemetry records to a caller buffer, without allocating
+// A record that doesn't fit isn't written at all, so the buffer always holds whole records
+class TelemetryEncoder {
+    public:
+        // buffer must outlive the encoder
+        TelemetryEncoder(uint8_t *buffer, uint16_t capacity);
+
+        // Each one returns false, and writes nothing, if the record doesn't fit
+        bool Header(uint8_t slaveAddress, uint32_t millis);
+        // A decoded value of a field, as stored by the requests, or its error code if it isn't 0
+        bool Reading(OctaveField field, uint8_t errorCode, const void *value);
+        // A header and every field of the snapshot, the clock as a single ReadClock record
+        bool Snapshot(uint8_t slaveAddress, uint32_t millis, const OctaveSnapshot &snapshot);
+        // The summary of a ConsumptionAggregator window
+        bool Summary(const ConsumptionSummary &summary);
+
+        uint16_t Length() const { return _length; }
+        uint16_t Capacity() const { return _capacity; }
+        const uint8_t *Data() const { return _buffer; }
+        void Clear() { _length = 0; }
+
+    private:
+        uint8_t *_buffer;
+        uint16_t _capacity;
+        uint16_t _length = 0;
+
+        // Encode a record into output, which has room for TELEMETRY_MAX_READING_BYTES, returns its length
+        static uint8_t EncodeReading(uint8_t *output, OctaveField field, uint8_t errorCode, const void *value);
+        // Copy a record to the buffer if it fits
+        bool Append(const uint8_t *record, uint8_t length);
+};
+
+// Find k and d such that the double, given as its IEEE-754 bits, is the nearest double to k / 10^d,
+// with the smallest d up to TELEMETRY_MAX_DECIMALS. Returns false if there are none
+// Integer operations only, i.e. for the AVR's float64_t
+bool TelemetryDoubleToDecimal(uint64_t bits, int64_t &k, uint8_t &d);
+
+#endif
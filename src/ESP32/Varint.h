@@ -0,0 +1,49 @@
+#ifndef __Varint_H__
+#define __Varint_H__
+
+#include <stdint.h>
+
+// Variable-length integers, shared by the ReadingLog and telemetry encodings
+
+// Zigzag maps signed numbers to unsigned ones with small magnitudes first: 0, -1, 1, -2, 2...
+inline uint64_t ZigzagEncode(int64_t value){
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t ZigzagDecode(uint64_t value){
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// 7 bits per byte, least significant first, with the high bit set on every byte but the last
+// Returns the number of bytes written, at most 10
+inline uint8_t WriteVarint(uint8_t *output, uint64_t value){
+  uint8_t length = 0;
+  while (value >= 0x80) {
+    output[length++] = static_cast<uint8_t>(value) | 0x80;
+    value >>= 7;
+  }
+  output[length++] = static_cast<uint8_t>(value);
+  return length;
+}
+
+// Number of bytes WriteVarint() writes for a value
+inline uint8_t VarintLength(uint64_t value){
+  uint8_t length = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    length++;
+  }
+  return length;
+}
+
+// Returns the number of bytes read, 0 if the varint doesn't end within length
+inline uint8_t ReadVarint(const uint8_t *input, uint16_t length, uint64_t &value){
+  value = 0;
+  for (uint8_t i = 0; i < length && i < 10; i++) {
+    value |= static_cast<uint64_t>(input[i] & 0x7F) << (7 * i);
+    if ((input[i] & 0x80) == 0) return i + 1;
+  }
+  return 0;
+}
+
+#endif